@@ -0,0 +1,833 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "Brickmap.h"
+#include "ChunkWorld.h"
+#include "ColumnHeights.h"
+#include "Dag.h"
+#include "DistanceField.h"
+#include "Heightmap.h"
+#include "Noise.h"
+#include "Occupancy.h"
+#include "RaySort.h"
+#include "VoxelEdit.h"
+#include "VoxelGrid.h"
+#include "WorldGen.h"
+
+// Direct-mapped cache model, used to compare the memory behaviour of the voxel layouts and ray
+// orders independently of the machine the benchmark runs on. 32 KiB by default.
+struct CacheModel {
+	static const int LINE_BYTES = 64;
+	static const int LINES = 512;
+
+	std::vector<uint64_t> tags;
+	uint64_t accesses = 0;
+	uint64_t misses = 0;
+
+	explicit CacheModel(size_t lines = LINES) : tags(lines, ~uint64_t(0)) {}
+
+	size_t kibibytes() const {
+		return tags.size() * LINE_BYTES / 1024;
+	}
+
+	void access(uint64_t address) {
+		const uint64_t line = address / LINE_BYTES;
+		uint64_t& tag = tags[line % tags.size()];
+		accesses++;
+		if (tag != line) {
+			tag = line;
+			misses++;
+		}
+	}
+};
+
+struct Ray {
+	glm::vec3 origin;
+	glm::vec3 direction;
+};
+
+static double secondsSince(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Walks the ray through the whole grid one cell at a time, reading every voxel it crosses.
+// Returns the number of cells visited, and adds the ids read to checksum.
+template <bool WithCache>
+static uint64_t walkRay(const VoxelGrid& grid, const Ray& ray, uint64_t& checksum, CacheModel* cache) {
+	glm::ivec3 cell = glm::ivec3(glm::floor(ray.origin));
+	const glm::ivec3 step = glm::ivec3(glm::sign(ray.direction));
+	const glm::vec3 delta = glm::abs(1.0f / ray.direction);
+	glm::vec3 sideDist = (glm::vec3(cell) + glm::max(glm::vec3(step), glm::vec3(0)) - ray.origin) / ray.direction;
+
+	uint64_t steps = 0;
+	while (cell.x >= 0 && cell.y >= 0 && cell.z >= 0 && cell.x < grid.width && cell.y < grid.height && cell.z < grid.depth) {
+		checksum += getVoxel(grid, cell.x, cell.y, cell.z);
+		if (WithCache) cache->access(voxelIndex(grid, cell.x, cell.y, cell.z) * grid.bitsPerVoxel / 8);
+		steps++;
+
+		if (sideDist.x < sideDist.y && sideDist.x < sideDist.z) {
+			sideDist.x += delta.x;
+			cell.x += step.x;
+		} else if (sideDist.y < sideDist.z) {
+			sideDist.y += delta.y;
+			cell.y += step.y;
+		} else {
+			sideDist.z += delta.z;
+			cell.z += step.z;
+		}
+	}
+	return steps;
+}
+
+static void fillRandom(VoxelGrid& grid, unsigned seed) {
+	std::mt19937 rng(seed);
+	for (int z = 0; z < grid.depth; z++) {
+		for (int y = 0; y < grid.height; y++) {
+			for (int x = 0; x < grid.width; x++) {
+				if (rng() % 100 == 0) setVoxel(grid, x, y, z, 1 + rng() % 9);
+			}
+		}
+	}
+}
+
+// Rays of a 256x256 pinhole camera sitting in a corner of the grid, in pixel order, so that
+// consecutive rays walk neighbouring cells
+static std::vector<Ray> coherentRays() {
+	std::vector<Ray> rays;
+	const glm::vec3 origin = glm::vec3(0.5f);
+	const glm::vec3 forward = glm::normalize(glm::vec3(1.0f, 0.7f, 1.3f));
+	const glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0, 1, 0)));
+	const glm::vec3 up = glm::cross(right, forward);
+
+	for (int j = 0; j < 256; j++) {
+		for (int i = 0; i < 256; i++) {
+			const glm::vec2 uv = (glm::vec2(i, j) + 0.5f) / 256.0f * 2.0f - 1.0f;
+			rays.push_back({ origin, glm::normalize(forward + 0.5f * (uv.x * right + uv.y * up)) });
+		}
+	}
+	return rays;
+}
+
+static std::vector<Ray> randomRays(int size) {
+	std::vector<Ray> rays;
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> position(0.0f, (float)size);
+	std::normal_distribution<float> direction;
+
+	for (int i = 0; i < 256 * 256; i++) {
+		rays.push_back({ glm::vec3(position(rng), position(rng), position(rng)), glm::normalize(glm::vec3(direction(rng), direction(rng), direction(rng))) });
+	}
+	return rays;
+}
+
+static void benchmarkLayout(const char* name, const VoxelGrid& grid, const std::vector<Ray>& rays) {
+	uint64_t checksum = 0;
+	uint64_t steps = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	for (const Ray& ray : rays) steps += walkRay<false>(grid, ray, checksum, nullptr);
+	const double seconds = secondsSince(start);
+
+	CacheModel cache;
+	for (const Ray& ray : rays) walkRay<true>(grid, ray, checksum, &cache);
+
+	std::cout << std::left << std::setw(28) << name
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(1) << steps / seconds * 1e-6 << " Mcells/s"
+		<< std::setw(10) << std::setprecision(2) << 100.0 * cache.misses / cache.accesses << " % misses"
+		<< "   (checksum " << checksum << ")" << std::endl;
+}
+
+// Compares the linear and Morton layouts, on a power-of-two grid (shift indexing) and on a
+// grid one voxel smaller (multiply indexing), for coherent and random ray walks
+static int benchmarkLayouts(int size) {
+	std::cout << "Layout benchmark, " << 256 * 256 << " rays per walk, " << CacheModel::LINES * CacheModel::LINE_BYTES / 1024 << " KiB direct-mapped cache model" << std::endl;
+
+	for (int gridSize : { size, size - 1 }) {
+		VoxelGrid linear, morton;
+		initVoxelGrid(linear, gridSize, gridSize, gridSize, 8, VOXEL_LAYOUT_LINEAR);
+		initVoxelGrid(morton, gridSize, gridSize, gridSize, 8, VOXEL_LAYOUT_MORTON);
+		fillRandom(linear, 1);
+		fillRandom(morton, 1);
+
+		const std::vector<Ray> coherent = coherentRays();
+		const std::vector<Ray> random = randomRays(gridSize);
+		const std::string suffix = " " + std::to_string(gridSize) + (linear.strideShiftY >= 0 ? " (shifts)" : " (mul)");
+
+		benchmarkLayout(("linear coherent" + suffix).c_str(), linear, coherent);
+		benchmarkLayout(("morton coherent" + suffix).c_str(), morton, coherent);
+		benchmarkLayout(("linear random" + suffix).c_str(), linear, random);
+		benchmarkLayout(("morton random" + suffix).c_str(), morton, random);
+	}
+	return 0;
+}
+
+static uint64_t hashWords(const VoxelGrid& grid) {
+	uint64_t hash = 14695981039346656037ull;
+	for (uint32_t word : grid.words) hash = (hash ^ word) * 1099511628211ull;
+	return hash;
+}
+
+// Generates a size x size/4 x size world on one thread and on several, the bytes must match
+static int benchmarkWorldGen(int size) {
+	const int threads = std::max(4, (int)std::thread::hardware_concurrency());
+	WorldGenParams params;
+	uint64_t reference = 0;
+
+	std::cout << "World generation benchmark, " << size << "x" << size / 4 << "x" << size << ", seed " << params.seed << std::endl;
+
+	for (int threadCount : { 1, threads }) {
+		VoxelGrid grid;
+		if (!initVoxelGrid(grid, size, size / 4, size, 8, VOXEL_LAYOUT_MORTON)) return -1;
+
+		ThreadPool pool;
+		initThreadPool(pool, threadCount);
+
+		auto start = std::chrono::steady_clock::now();
+		generateWorld(grid, params, pool);
+		const double seconds = secondsSince(start);
+		destroyThreadPool(pool);
+
+		const uint64_t hash = hashWords(grid);
+		if (threadCount == 1) reference = hash;
+
+		std::cout << std::setw(3) << threadCount << " threads"
+			<< std::setw(10) << std::fixed << std::setprecision(2) << seconds << " s"
+			<< std::setw(10) << std::setprecision(1) << voxelCount(grid) / seconds * 1e-6 << " Mvoxels/s"
+			<< "   (hash " << std::hex << hash << std::dec << ")" << std::endl;
+
+		if (hash != reference) {
+			std::cerr << "World differs from the single threaded one" << std::endl;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+// Evaluates 3 octave fBm at every voxel of a size x size/4 x size grid with each noise
+// backend, then generates a world with each. The SIMD results must match the scalar ones.
+static int benchmarkNoise(int size) {
+	const int height = size / 4;
+	const size_t voxels = (size_t)size * height * size;
+	std::vector<float> x(voxels), y(voxels), z(voxels);
+	for (int k = 0, i = 0; k < size; k++) {
+		for (int j = 0; j < height; j++) {
+			for (int l = 0; l < size; l++, i++) {
+				x[i] = l / 48.0f;
+				y[i] = j / 32.0f;
+				z[i] = k / 48.0f;
+			}
+		}
+	}
+
+	const NoiseBackend best = bestNoiseBackend();
+	std::cout << "Noise benchmark, " << size << "x" << height << "x" << size << ", best backend " << noiseBackendName(best) << std::endl;
+
+	std::vector<float> reference(voxels), values(voxels);
+	const float tolerance = 1e-5f;
+	int result = 0;
+
+	for (int backend = NOISE_SCALAR; backend <= best; backend++) {
+		setNoiseBackend((NoiseBackend)backend);
+		std::vector<float>& out = backend == NOISE_SCALAR ? reference : values;
+
+		auto start = std::chrono::steady_clock::now();
+		fbm3Batch(1337, x.data(), y.data(), z.data(), out.data(), (int)voxels, 3);
+		const double seconds = secondsSince(start);
+
+		float maxError = 0.0f;
+		for (size_t i = 0; i < voxels; i++) maxError = std::max(maxError, std::abs(out[i] - reference[i]));
+
+		std::cout << std::left << std::setw(28) << (std::string("fbm3 ") + noiseBackendName((NoiseBackend)backend))
+			<< std::right << std::setw(10) << std::fixed << std::setprecision(1) << voxels / seconds * 1e-6 << " Mvoxels/s"
+			<< "   (max error " << std::scientific << std::setprecision(2) << maxError << std::defaultfloat << ")" << std::endl;
+
+		if (maxError > tolerance) {
+			std::cerr << noiseBackendName((NoiseBackend)backend) << " noise differs from the scalar noise" << std::endl;
+			result = -1;
+		}
+	}
+
+	ThreadPool pool;
+	initThreadPool(pool, 1);
+	uint64_t referenceHash = 0;
+
+	for (int backend = NOISE_SCALAR; backend <= best; backend++) {
+		setNoiseBackend((NoiseBackend)backend);
+
+		VoxelGrid grid;
+		initVoxelGrid(grid, size, height, size, 8, VOXEL_LAYOUT_MORTON);
+
+		auto start = std::chrono::steady_clock::now();
+		generateWorld(grid, WorldGenParams(), pool);
+		const double seconds = secondsSince(start);
+
+		const uint64_t hash = hashWords(grid);
+		if (backend == NOISE_SCALAR) referenceHash = hash;
+
+		std::cout << std::left << std::setw(28) << (std::string("worldgen ") + noiseBackendName((NoiseBackend)backend))
+			<< std::right << std::setw(10) << std::fixed << std::setprecision(1) << voxelCount(grid) / seconds * 1e-6 << " Mvoxels/s"
+			<< "   (hash " << std::hex << hash << std::dec << ")" << std::endl;
+
+		if (hash != referenceHash) {
+			std::cerr << "World generated with " << noiseBackendName((NoiseBackend)backend) << " noise differs from the scalar one" << std::endl;
+			result = -1;
+		}
+	}
+
+	destroyThreadPool(pool);
+	setNoiseBackend(best);
+	return result;
+}
+
+static void reportDag(const std::string& scene, glm::ivec3 dims, const SparseVoxelOctree& dag, double seconds) {
+	const double voxels = (double)dims.x * dims.y * dims.z;
+	const double bytes = (double)octreeBytes(dag);
+
+	const std::string size = std::to_string(dims.x) + "x" + std::to_string(dims.y) + "x" + std::to_string(dims.z);
+
+	std::cout << std::left << std::setw(14) << scene << std::setw(14) << size << std::right
+		<< std::setw(8) << std::fixed << std::setprecision(1) << voxels * 1e-6 << " Mvoxels"
+		<< std::setw(10) << bytes / 1024.0 << " KiB"
+		<< std::setw(8) << std::setprecision(2) << seconds << " s"
+		<< "   1:" << std::setprecision(0) << voxels * 4.0 / bytes << " vs int[]"
+		<< ", 1:" << voxels / bytes << " vs 8-bit grid"
+		<< ", 1:" << std::setprecision(1) << (double)dagTreeNodes(dag) * 4.0 / bytes << " vs SVO" << std::endl;
+}
+
+// Builds one of the DAG scenes: "terrain" (generated world, size x size/4 x size),
+// "architecture" (architectureVoxel(), size^3, never stored as a grid) or "random" (size^3)
+static bool buildDagScene(const std::string& scene, int size, SparseVoxelOctree& dag, glm::ivec3& dims) {
+	if (scene == "architecture") {
+		dims = glm::ivec3(size);
+		buildDag(dag, size, architectureVoxel);
+		return true;
+	}
+
+	VoxelGrid grid;
+	if (scene == "terrain") {
+		if (!initVoxelGrid(grid, size, size / 4, size, 8, VOXEL_LAYOUT_MORTON)) return false;
+
+		ThreadPool pool;
+		initThreadPool(pool);
+		generateWorld(grid, WorldGenParams(), pool);
+		destroyThreadPool(pool);
+	} else if (scene == "random") {
+		if (!initVoxelGrid(grid, size, size, size, 8, VOXEL_LAYOUT_MORTON)) return false;
+		fillRandom(grid, 1);
+	} else {
+		std::cerr << "Unknown DAG scene: " << scene << " (terrain, architecture, random)" << std::endl;
+		return false;
+	}
+
+	dims = glm::ivec3(grid.width, grid.height, grid.depth);
+	buildDag(dag, grid);
+	return true;
+}
+
+// Compression ratio and build time of the DAG for every scene. The time includes
+// generating the scene.
+static int benchmarkDag(int size) {
+	std::cout << "DAG benchmark, ratios are logical voxels against DAG bytes" << std::endl;
+
+	for (const char* scene : { "terrain", "architecture", "random" }) {
+		const int sceneSize = std::string(scene) == "random" ? std::min(size, 256) : size;
+
+		SparseVoxelOctree dag;
+		glm::ivec3 dims;
+		auto start = std::chrono::steady_clock::now();
+		if (!buildDagScene(scene, sceneSize, dag, dims)) return -1;
+		reportDag(scene, dims, dag, secondsSince(start));
+	}
+	return 0;
+}
+
+// Distance to the first solid cell along the ray, like voxel_traversal() in fragment.glsl: one
+// cell at a time, or with SkipColumns crossing the empty blocks of columns above the terrain at
+// once. Adds the cells visited and blocks skipped to steps. Returns -1 when the ray leaves the grid.
+// Distances are doubles, floats drift by a voxel over the thousands of steps of the plain DDA.
+template <bool SkipColumns>
+static float traceTerrainRay(const VoxelGrid& grid, const ColumnHeights& columns, const Ray& ray, uint64_t& steps) {
+	glm::ivec3 cell = glm::ivec3(glm::floor(ray.origin));
+	const glm::ivec3 step = glm::ivec3(glm::sign(ray.direction));
+	const glm::dvec3 origin = glm::dvec3(ray.origin);
+	const glm::dvec3 invDir = 1.0 / glm::dvec3(ray.direction);
+	const glm::dvec3 delta = glm::abs(invDir);
+	glm::dvec3 sideDist = (glm::dvec3(cell) + glm::max(glm::dvec3(step), glm::dvec3(0)) - origin) * invDir;
+	double t = 0.0;
+
+	while (cell.x >= 0 && cell.y >= 0 && cell.z >= 0 && cell.x < grid.width && cell.y < grid.height && cell.z < grid.depth) {
+		steps++;
+
+		int level = -1;
+		if (SkipColumns) {
+			while (level + 1 < columns.levels && (uint32_t)cell.y >= columnTop(columns, level + 1, cell.x, cell.z)) level++;
+		}
+
+		if (level >= 0) {
+			const int top = (int)columnTop(columns, level, cell.x, cell.z);
+			const glm::ivec3 boxMin((cell.x >> level) << level, top, (cell.z >> level) << level);
+			const glm::ivec3 boxSize(1 << level, grid.height - top, 1 << level);
+
+			const glm::dvec3 exitPlanes = glm::dvec3(boxMin) + glm::dvec3(glm::greaterThan(ray.direction, glm::vec3(0))) * glm::dvec3(boxSize);
+			const glm::dvec3 tPlanes = (exitPlanes - origin) * invDir;
+			const int side = tPlanes.x <= tPlanes.y && tPlanes.x <= tPlanes.z ? 0 : (tPlanes.y <= tPlanes.z ? 1 : 2);
+			t = tPlanes[side];
+
+			cell = glm::clamp(glm::ivec3(glm::floor(origin + glm::dvec3(ray.direction) * t)), boxMin, boxMin + boxSize - 1);
+			cell[side] = ray.direction[side] > 0 ? boxMin[side] + boxSize[side] : boxMin[side] - 1;
+			sideDist = (glm::dvec3(cell) + glm::max(glm::dvec3(step), glm::dvec3(0)) - origin) * invDir;
+			continue;
+		}
+
+		if (getVoxel(grid, cell.x, cell.y, cell.z) != 0) return (float)t;
+
+		if (sideDist.x < sideDist.y && sideDist.x < sideDist.z) {
+			t = sideDist.x;
+			sideDist.x += delta.x;
+			cell.x += step.x;
+		} else if (sideDist.y < sideDist.z) {
+			t = sideDist.y;
+			sideDist.y += delta.y;
+			cell.y += step.y;
+		} else {
+			t = sideDist.z;
+			sideDist.z += delta.z;
+			cell.z += step.z;
+		}
+	}
+	return -1.0f;
+}
+
+// Imports a size x size fBm heightmap into a size x size/32 x size grid and builds its column
+// heights, then traces a 256x256 camera looking over the terrain with and without them. Both
+// must hit at the same distance: where a ray grazes the edge of a voxel, either may hit a
+// neighbour at that distance.
+static int benchmarkHeightmap(int size) {
+	const int height = std::max(size / 32, 8);
+	std::cout << "Heightmap benchmark, " << size << "x" << size << " heightmap, " << size << "x" << height << "x" << size << " grid" << std::endl;
+
+	Heightmap heightmap;
+	heightmap.width = size;
+	heightmap.depth = size;
+	heightmap.heights.resize((size_t)size * size);
+	std::vector<float> x(size), z(size), noise(size);
+	for (int row = 0; row < size; row++) {
+		for (int i = 0; i < size; i++) {
+			x[i] = i * 8.0f / size;
+			z[i] = row * 8.0f / size;
+		}
+		fbm2Batch(1337, x.data(), z.data(), noise.data(), size, 8);
+		for (int i = 0; i < size; i++) {
+			heightmap.heights[i + (size_t)size * row] = (uint16_t)(glm::clamp(0.4f + 0.5f * noise[i], 0.0f, 1.0f) * 65535.0f);
+		}
+	}
+
+	VoxelGrid grid;
+	if (!initVoxelGrid(grid, size, height, size, 4, VOXEL_LAYOUT_MORTON)) return -1;
+
+	ThreadPool pool;
+	initThreadPool(pool);
+
+	auto start = std::chrono::steady_clock::now();
+	loadHeightmapTerrain(grid, heightmap, WorldGenParams(), pool);
+	const double importSeconds = secondsSince(start);
+
+	ColumnHeights columns;
+	start = std::chrono::steady_clock::now();
+	buildColumnHeights(columns, grid, pool);
+	const double columnSeconds = secondsSince(start);
+	const int threads = threadCount(pool);
+	destroyThreadPool(pool);
+
+	std::cout << "import" << std::setw(26) << std::fixed << std::setprecision(2) << importSeconds << " s on " << threads << " threads" << std::endl;
+	std::cout << "column heights" << std::setw(18) << columnSeconds << " s, " << columns.levels << " levels, " << columnHeightsBytes(columns) / 1024 << " KiB" << std::endl;
+
+	// Just above the highest peak in a corner, looking across the terrain and slightly down
+	std::vector<Ray> rays;
+	const glm::vec3 origin = glm::vec3(2.5f, height - 0.5f, 2.5f);
+	const glm::vec3 forward = glm::normalize(glm::vec3(1.0f, -0.15f, 1.0f));
+	const glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0, 1, 0)));
+	const glm::vec3 up = glm::cross(right, forward);
+	for (int j = 0; j < 256; j++) {
+		for (int i = 0; i < 256; i++) {
+			const glm::vec2 uv = (glm::vec2(i, j) + 0.5f) / 256.0f * 2.0f - 1.0f;
+			rays.push_back({ origin, glm::normalize(forward + 0.5f * (uv.x * right + 0.3f * uv.y * up)) });
+		}
+	}
+
+	std::vector<float> hits[2] = { std::vector<float>(rays.size()), std::vector<float>(rays.size()) };
+	for (int skip = 0; skip < 2; skip++) {
+		uint64_t steps = 0;
+		start = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < rays.size(); i++) {
+			hits[skip][i] = skip ? traceTerrainRay<true>(grid, columns, rays[i], steps) : traceTerrainRay<false>(grid, columns, rays[i], steps);
+		}
+		const double seconds = secondsSince(start);
+
+		std::cout << std::left << std::setw(20) << (skip ? "dda + columns" : "dda")
+			<< std::right << std::setw(12) << std::setprecision(1) << (double)steps / rays.size() << " steps/ray"
+			<< std::setw(10) << std::setprecision(2) << rays.size() / seconds * 1e-6 << " Mrays/s" << std::endl;
+	}
+
+	size_t differ = 0;
+	for (size_t i = 0; i < rays.size(); i++) differ += std::abs(hits[0][i] - hits[1][i]) > 1e-3f;
+	if (differ > 0) {
+		std::cerr << differ << " rays hit another voxel when skipping columns" << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+// First solid cell along the ray, one cell at a time like voxel_traversal() in fragment.glsl.
+// Returns its distance, -1 when the ray leaves the grid, and the normal of the face it entered by.
+// Adds the cells visited to steps.
+template <bool WithCache>
+static float traceFirstHit(const VoxelGrid& grid, const Ray& ray, glm::vec3& normal, uint64_t& steps, CacheModel* cache) {
+	glm::ivec3 cell = glm::ivec3(glm::floor(ray.origin));
+	const glm::ivec3 step = glm::ivec3(glm::sign(ray.direction));
+	const glm::vec3 delta = glm::abs(1.0f / ray.direction);
+	glm::vec3 sideDist = (glm::vec3(cell) + glm::max(glm::vec3(step), glm::vec3(0)) - ray.origin) / ray.direction;
+	float t = 0.0f;
+
+	while (cell.x >= 0 && cell.y >= 0 && cell.z >= 0 && cell.x < grid.width && cell.y < grid.height && cell.z < grid.depth) {
+		if (WithCache) cache->access(voxelIndex(grid, cell.x, cell.y, cell.z) * grid.bitsPerVoxel / 8);
+		steps++;
+		if (getVoxel(grid, cell.x, cell.y, cell.z) != 0) return t;
+
+		int side = sideDist.x < sideDist.y && sideDist.x < sideDist.z ? 0 : (sideDist.y < sideDist.z ? 1 : 2);
+		t = sideDist[side];
+		sideDist[side] += delta[side];
+		cell[side] += step[side];
+		normal = glm::vec3(0);
+		normal[side] = (float)-step[side];
+	}
+	return -1.0f;
+}
+
+// Traces the rays in the order given, timed, then through an L1 and an L2 sized cache model
+static void benchmarkRayOrder(const char* name, const VoxelGrid& grid, const std::vector<Ray>& rays, double sortSeconds) {
+	uint64_t steps = 0;
+	size_t hits = 0;
+	glm::vec3 normal;
+
+	auto start = std::chrono::steady_clock::now();
+	for (const Ray& ray : rays) hits += traceFirstHit<false>(grid, ray, normal, steps, nullptr) >= 0.0f;
+	const double seconds = secondsSince(start) + sortSeconds;
+
+	std::cout << std::left << std::setw(12) << name
+		<< std::right << std::setw(10) << std::fixed << std::setprecision(2) << rays.size() / seconds * 1e-6 << " Mrays/s"
+		<< "   (" << hits << " hits, " << steps << " steps)" << std::endl;
+
+	for (size_t lines : { (size_t)CacheModel::LINES, (size_t)65536 }) {
+		CacheModel cache(lines);
+		uint64_t cachedSteps = 0;
+		for (const Ray& ray : rays) traceFirstHit<true>(grid, ray, normal, cachedSteps, &cache);
+
+		std::cout << std::setw(10) << cache.kibibytes() << " KiB" << std::setw(12) << cache.misses << " misses"
+			<< std::setw(10) << std::setprecision(2) << (double)cache.misses / rays.size() << " /ray"
+			<< std::setw(10) << 100.0 * cache.misses / cache.accesses << " %" << std::endl;
+	}
+}
+
+// Secondary rays of a 512x512 camera looking over a generated size x size/4 x size world: from
+// every primary hit, one diffuse bounce, in pixel order as the shade stage of the wavefront queues
+// them. Traced as they are, then coherence sorted (RaySort.h), the sort counted in the time.
+static int benchmarkRays(int size) {
+	const int height = size / 4;
+	VoxelGrid grid;
+	if (!initVoxelGrid(grid, size, height, size, 8, VOXEL_LAYOUT_MORTON)) return -1;
+
+	ThreadPool pool;
+	initThreadPool(pool);
+	WorldGenParams params;
+	generateWorld(grid, params, pool);
+	destroyThreadPool(pool);
+
+	const glm::vec3 origin = glm::vec3(2.5f, height - 0.5f, 2.5f);
+	const glm::vec3 forward = glm::normalize(glm::vec3(1.0f, -0.3f, 1.0f));
+	const glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0, 1, 0)));
+	const glm::vec3 up = glm::cross(right, forward);
+
+	std::mt19937 rng(7);
+	std::normal_distribution<float> gaussian;
+	std::vector<Ray> secondary;
+	uint64_t steps = 0;
+	for (int j = 0; j < 512; j++) {
+		for (int i = 0; i < 512; i++) {
+			const glm::vec2 uv = (glm::vec2(i, j) + 0.5f) / 512.0f * 2.0f - 1.0f;
+			const Ray ray = { origin, glm::normalize(forward + 0.7f * (uv.x * right + uv.y * up)) };
+
+			glm::vec3 normal;
+			const float t = traceFirstHit<false>(grid, ray, normal, steps, nullptr);
+			if (t < 0.0f) continue;
+
+			// Lambertian bounce like scatter() in tracing.glsl, from just outside the face hit
+			const glm::vec3 bounce = glm::normalize(normal + glm::normalize(glm::vec3(gaussian(rng), gaussian(rng), gaussian(rng))));
+			secondary.push_back({ ray.origin + ray.direction * t + normal * 1e-3f, bounce });
+		}
+	}
+
+	std::cout << "Ray sort benchmark, " << size << "x" << height << "x" << size << " world, " << secondary.size() << " secondary rays, direct-mapped cache models" << std::endl;
+
+	benchmarkRayOrder("unsorted", grid, secondary, 0.0);
+
+	auto start = std::chrono::steady_clock::now();
+	const glm::ivec3 gridSize(grid.width, grid.height, grid.depth);
+	const int cellShift = raySortCellShift(gridSize);
+	std::vector<uint32_t> keys(secondary.size()), order;
+	for (size_t i = 0; i < secondary.size(); i++) keys[i] = raySortKey(secondary[i].origin, secondary[i].direction, gridSize, cellShift);
+	sortRayKeys(keys, order);
+
+	std::vector<Ray> sorted(secondary.size());
+	for (size_t i = 0; i < order.size(); i++) sorted[i] = secondary[order[i]];
+	const double sortSeconds = secondsSince(start);
+
+	for (size_t i = 1; i < order.size(); i++) {
+		if (keys[order[i - 1]] > keys[order[i]] || (keys[order[i - 1]] == keys[order[i]] && order[i - 1] > order[i])) {
+			std::cerr << "Rays out of order after the sort" << std::endl;
+			return -1;
+		}
+	}
+
+	benchmarkRayOrder("sorted", grid, sorted, sortSeconds);
+	std::cout << "sort" << std::setw(14) << std::setprecision(2) << sortSeconds * 1e3 << " ms, cells of " << (1 << cellShift) << " voxels" << std::endl;
+	return 0;
+}
+
+// Per-structure times of one edit, in seconds
+struct EditTimes {
+	double commit = 0, occupancy = 0, columns = 0, distance = 0, brickmap = 0;
+};
+
+static void printEditTimes(const std::string& name, const EditTimes& times, int count) {
+	const double total = times.commit + times.occupancy + times.columns + times.distance + times.brickmap;
+	std::cout << std::left << std::setw(14) << name << std::right << std::fixed << std::setprecision(3);
+	for (double seconds : { times.commit, times.occupancy, times.columns, times.distance, times.brickmap, total }) {
+		std::cout << std::setw(12) << seconds * 1000.0 / count;
+	}
+	std::cout << std::endl;
+}
+
+// Edit latency on a generated size^3 world: the commit of a cube of voxels and the incremental
+// update of every structure derived from the grid, against rebuilding them. The updated
+// structures must match rebuilt ones.
+static int benchmarkEdits(int size) {
+	std::cout << "Edit benchmark, " << size << "x" << size << "x" << size << " world" << std::endl;
+
+	VoxelGrid grid;
+	if (!initVoxelGrid(grid, size, size, size, 8, VOXEL_LAYOUT_MORTON)) return -1;
+
+	ThreadPool pool;
+	initThreadPool(pool);
+	generateWorld(grid, WorldGenParams(), pool);
+	clearDirtyVoxels(grid);
+
+	OccupancyPyramid occupancy;
+	ColumnHeights columns;
+	DistanceField distanceField;
+	Brickmap brickmap;
+
+	EditTimes rebuild;
+	auto start = std::chrono::steady_clock::now();
+	buildOccupancy(occupancy, grid);
+	rebuild.occupancy = secondsSince(start);
+	start = std::chrono::steady_clock::now();
+	buildColumnHeights(columns, grid, pool);
+	rebuild.columns = secondsSince(start);
+	start = std::chrono::steady_clock::now();
+	buildDistanceField(distanceField, grid);
+	rebuild.distance = secondsSince(start);
+	start = std::chrono::steady_clock::now();
+	buildBrickmap(brickmap, grid);
+	rebuild.brickmap = secondsSince(start);
+
+	std::cout << std::left << std::setw(14) << "ms per edit" << std::right;
+	for (const char* column : { "commit", "occupancy", "columns", "distance", "brickmap", "total" }) std::cout << std::setw(12) << column;
+	std::cout << std::endl;
+	printEditTimes("full rebuild", rebuild, 1);
+
+	std::mt19937 rng(42);
+	for (int edge : { 1, 16, 128 }) {
+		if (edge > size) continue;
+		const int count = edge == 1 ? 200 : (edge == 16 ? 20 : 4);
+
+		EditTimes times;
+		for (int i = 0; i < count; i++) {
+			// Cubes alternately of stone and air, around the middle height where the terrain is
+			const glm::ivec3 min(rng() % (size - edge + 1), size / 4 + rng() % (size / 2 - edge / 2 + 1), rng() % (size - edge + 1));
+			EditQueue queue;
+			queueFillBox(queue, min, min + edge - 1, i % 2 == 0 ? BLOCK_STONE : BLOCK_AIR);
+
+			start = std::chrono::steady_clock::now();
+			const std::vector<VoxelBox> boxes = commitEdits(queue, grid);
+			times.commit += secondsSince(start);
+
+			for (const VoxelBox& box : boxes) {
+				start = std::chrono::steady_clock::now();
+				updateOccupancy(occupancy, grid, box.min, box.max);
+				times.occupancy += secondsSince(start);
+				start = std::chrono::steady_clock::now();
+				updateColumnHeights(columns, grid, box.min, box.max);
+				times.columns += secondsSince(start);
+				start = std::chrono::steady_clock::now();
+				updateDistanceField(distanceField, grid, box.min, box.max);
+				times.distance += secondsSince(start);
+				start = std::chrono::steady_clock::now();
+				updateBrickmap(brickmap, grid, box.min, box.max);
+				times.brickmap += secondsSince(start);
+			}
+			clearDirtyVoxels(grid);
+		}
+		printEditTimes(std::to_string(edge) + "^3", times, count);
+	}
+
+	OccupancyPyramid rebuiltOccupancy;
+	buildOccupancy(rebuiltOccupancy, grid);
+	ColumnHeights rebuiltColumns;
+	buildColumnHeights(rebuiltColumns, grid, pool);
+	DistanceField rebuiltDistance;
+	buildDistanceField(rebuiltDistance, grid);
+	destroyThreadPool(pool);
+
+	bool brickmapMatches = true;
+	for (int z = 0; z < size && brickmapMatches; z++) {
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) brickmapMatches = brickmapMatches && getBrickmapVoxel(brickmap, x, y, z) == getVoxel(grid, x, y, z);
+		}
+	}
+
+	if (occupancy.words != rebuiltOccupancy.words || columns.tops != rebuiltColumns.tops || distanceField.distances != rebuiltDistance.distances || !brickmapMatches) {
+		std::cerr << "Incrementally updated structures differ from rebuilt ones" << std::endl;
+		return -1;
+	}
+	std::cout << "brickmap pool : " << brickmap.pool.size() / brickmap.wordsPerBrick << " bricks, " << brickmap.freeBricks.size() << " free" << std::endl;
+	return 0;
+}
+
+// Voxels of the chunk window that differ from the reference, x-fastest over the window
+static size_t chunkWorldMismatches(const ChunkWorld& world, const std::vector<uint8_t>& reference) {
+	const glm::ivec3 size = world.dims * CHUNK_SIZE, min = world.origin * CHUNK_SIZE;
+	size_t mismatches = 0;
+	for (int z = 0; z < size.z; z++) {
+		for (int y = 0; y < size.y; y++) {
+			for (int x = 0; x < size.x; x++) {
+				mismatches += getChunkWorldVoxel(world, min.x + x, min.y + y, min.z + z) != reference[x + size.x * (y + size.y * (size_t)z)];
+			}
+		}
+	}
+	return mismatches;
+}
+
+// Edits of the chunked world: spheres of more and more different ids are written into a window
+// of radius chunks, which repacks chunks from uniform up to 8 bits per index. The pool has room
+// for every chunk at 8 bits, so nothing is evicted, and every voxel of the window must read back
+// as a reference copy of it says after each round.
+static int benchmarkChunkEdits(int radius) {
+	ChunkWorld world;
+	const glm::ivec3 windowRadius(radius, 2, radius);
+	const glm::ivec3 dims = 2 * windowRadius + 1;
+	if (!initChunkWorld(world, WorldGenParams(), 128.0f, windowRadius, CHUNK_MAX_BITS * dims.x * dims.y * dims.z)) return -1;
+	std::cout << "Chunk edit benchmark, " << dims.x << "x" << dims.y << "x" << dims.z << " window, " << world.pageCount << " pages" << std::endl;
+
+	ThreadPool pool;
+	initThreadPool(pool);
+	const glm::vec3 camera(16.0f, 64.0f, 16.0f);
+	world.chunksPerUpdate = (int)world.table.size();
+	while (updateChunkWorld(world, camera, 0.0f, pool) > 0) {}
+	destroyThreadPool(pool);
+
+	const glm::ivec3 size = world.dims * CHUNK_SIZE, min = world.origin * CHUNK_SIZE;
+	std::vector<uint8_t> reference((size_t)size.x * size.y * size.z);
+	for (int z = 0; z < size.z; z++) {
+		for (int y = 0; y < size.y; y++) {
+			for (int x = 0; x < size.x; x++) reference[x + size.x * (y + size.y * (size_t)z)] = (uint8_t)getChunkWorldVoxel(world, min.x + x, min.y + y, min.z + z);
+		}
+	}
+
+	std::cout << std::left << std::setw(8) << "ids" << std::right << std::setw(12) << "ms/sphere" << std::setw(10) << "repacked" << std::setw(8) << "pages";
+	for (int bits = 0; bits <= CHUNK_MAX_BITS; bits = bits == 0 ? 1 : bits * 2) std::cout << std::setw(7) << (std::to_string(bits) + "-bit");
+	std::cout << std::endl;
+
+	std::mt19937 rng(42);
+	const int spheres = 200;
+	const float sphereRadius = 4.0f;
+	for (int ids : { 2, 4, 16, 256 }) {
+		double seconds = 0;
+		for (int i = 0; i < spheres; i++) {
+			const glm::vec3 centre = glm::vec3(min) + glm::vec3(rng() % size.x, rng() % size.y, rng() % size.z) + 0.5f;
+			const uint32_t id = rng() % ids;
+
+			const auto start = std::chrono::steady_clock::now();
+			fillChunkWorldSphere(world, centre, sphereRadius, id);
+			seconds += secondsSince(start);
+
+			const glm::ivec3 lo = glm::max(glm::ivec3(glm::floor(centre - sphereRadius)) - min, glm::ivec3(0));
+			const glm::ivec3 hi = glm::min(glm::ivec3(glm::floor(centre + sphereRadius)) - min, size - 1);
+			for (int z = lo.z; z <= hi.z; z++) {
+				for (int y = lo.y; y <= hi.y; y++) {
+					for (int x = lo.x; x <= hi.x; x++) {
+						const glm::vec3 d = glm::vec3(min + glm::ivec3(x, y, z)) + 0.5f - centre;
+						if (glm::dot(d, d) <= sphereRadius * sphereRadius) reference[x + size.x * (y + size.y * (size_t)z)] = (uint8_t)id;
+					}
+				}
+			}
+		}
+
+		int chunksAt[CHUNK_MAX_BITS + 1] = {};
+		int pages = 0;
+		for (int i = 0; i < (int)world.table.size(); i++) {
+			const glm::ivec3 chunk = world.origin + glm::ivec3(i % world.dims.x, (i / world.dims.x) % world.dims.y, i / (world.dims.x * world.dims.y));
+			const int bits = chunkWorldBits(world, chunk);
+			chunksAt[bits]++;
+			pages += bits;
+		}
+
+		std::cout << std::left << std::setw(8) << ids << std::right << std::setw(12) << std::fixed << std::setprecision(3) << seconds * 1000.0 / spheres
+			<< std::setw(10) << world.chunksRepacked << std::setw(8) << chunkPagesUsed(world);
+		for (int bits = 0; bits <= CHUNK_MAX_BITS; bits = bits == 0 ? 1 : bits * 2) std::cout << std::setw(7) << chunksAt[bits];
+		std::cout << std::endl;
+
+		const size_t mismatches = chunkWorldMismatches(world, reference);
+		if (mismatches > 0 || pages != chunkPagesUsed(world) || world.chunksEvicted > 0) {
+			std::cerr << "Repacked chunks lost voxels: " << mismatches << " differ, " << pages << " pages in records, " << chunkPagesUsed(world) << " taken" << std::endl;
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int buildDagFile(const std::string& path, const std::string& scene, int size) {
+	SparseVoxelOctree dag;
+	glm::ivec3 dims;
+
+	auto start = std::chrono::steady_clock::now();
+	if (!buildDagScene(scene, size, dag, dims)) return -1;
+	reportDag(scene, dims, dag, secondsSince(start));
+
+	return saveDag(dag, path) ? 0 : -1;
+}
+
+int runBenchmark(const std::string& name, int size) {
+	if (name == "layout") return benchmarkLayouts(size > 0 ? size : 256);
+	if (name == "worldgen") return benchmarkWorldGen(size > 0 ? size : 1024);
+	if (name == "noise") return benchmarkNoise(size > 0 ? size : 256);
+	if (name == "dag") return benchmarkDag(size > 0 ? size : 512);
+	if (name == "heightmap") return benchmarkHeightmap(size > 0 ? size : 4096);
+	if (name == "edits") return benchmarkEdits(size > 0 ? size : 512);
+	if (name == "rays") return benchmarkRays(size > 0 ? size : 512);
+	if (name == "chunks") return benchmarkChunkEdits(size > 0 ? size : 1);
+
+	std::cerr << "Unknown benchmark: " << name << std::endl;
+	std::cerr << "Available benchmarks: layout, worldgen, noise, dag, heightmap, edits, rays, chunks" << std::endl;
+	return -1;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string>
+
+// CPU micro-benchmarks, run with `VoxelRendering --bench <name> [size]`. No OpenGL context is
+// created. Returns the process exit code.
+int runBenchmark(const std::string& name, int size);
+
+// Offline DAG builder, run with `VoxelRendering --build-dag <file> <scene> <size>`. Writes a
+// file for `--dag <file>` and reports the compression ratio and build time.
+int buildDagFile(const std::string& path, const std::string& scene, int size);
@@ -0,0 +1,128 @@
+#include "Brickmap.h"
+
+#include <algorithm>
+
+// Packs the voxels of a brick, returns true with its only id in uniformId when they are all the same
+static bool packBrick(const VoxelGrid& grid, int bx, int by, int bz, std::vector<uint32_t>& brick, uint32_t& uniformId) {
+	std::fill(brick.begin(), brick.end(), 0u);
+
+	const int voxelsPerWord = 32 / grid.bitsPerVoxel;
+	const uint32_t first = getVoxel(grid, bx * BRICK_SIZE, by * BRICK_SIZE, bz * BRICK_SIZE);
+	bool uniform = true;
+
+	for (int i = 0; i < BRICK_SIZE * BRICK_SIZE * BRICK_SIZE; i++) {
+		const uint32_t id = getVoxel(grid, bx * BRICK_SIZE + i % BRICK_SIZE, by * BRICK_SIZE + (i / BRICK_SIZE) % BRICK_SIZE, bz * BRICK_SIZE + i / (BRICK_SIZE * BRICK_SIZE));
+		uniform = uniform && id == first;
+		brick[i / voxelsPerWord] |= id << ((i % voxelsPerWord) * grid.bitsPerVoxel);
+	}
+
+	uniformId = first;
+	return uniform;
+}
+
+void buildBrickmap(Brickmap& brickmap, const VoxelGrid& grid) {
+	brickmap.width = (grid.width + BRICK_SIZE - 1) / BRICK_SIZE;
+	brickmap.height = (grid.height + BRICK_SIZE - 1) / BRICK_SIZE;
+	brickmap.depth = (grid.depth + BRICK_SIZE - 1) / BRICK_SIZE;
+	brickmap.bitsPerVoxel = grid.bitsPerVoxel;
+	brickmap.wordsPerBrick = BRICK_SIZE * BRICK_SIZE * BRICK_SIZE * grid.bitsPerVoxel / 32;
+
+	brickmap.cells.assign((size_t)brickmap.width * brickmap.height * brickmap.depth, 0u);
+	brickmap.pool.clear();
+	brickmap.freeBricks.clear();
+
+	std::vector<uint32_t> brick(brickmap.wordsPerBrick);
+
+	for (int bz = 0; bz < brickmap.depth; bz++) {
+		for (int by = 0; by < brickmap.height; by++) {
+			for (int bx = 0; bx < brickmap.width; bx++) {
+				uint32_t id;
+				uint32_t& cell = brickmap.cells[bx + (size_t)brickmap.width * (by + (size_t)brickmap.height * bz)];
+				if (packBrick(grid, bx, by, bz, brick, id)) {
+					cell = id == 0 ? 0u : (BRICK_UNIFORM | id);
+				}
+				else {
+					cell = 1 + (uint32_t)(brickmap.pool.size() / brickmap.wordsPerBrick);
+					brickmap.pool.insert(brickmap.pool.end(), brick.begin(), brick.end());
+				}
+			}
+		}
+	}
+
+	brickmap.cellsDirty.spans.clear();
+	brickmap.poolDirty.spans.clear();
+}
+
+void updateBrickmap(Brickmap& brickmap, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max) {
+	min = glm::max(min, glm::ivec3(0));
+	max = glm::min(max, glm::ivec3(grid.width, grid.height, grid.depth) - 1);
+	if (min.x > max.x || min.y > max.y || min.z > max.z) return;
+
+	min /= BRICK_SIZE;
+	max /= BRICK_SIZE;
+
+	const size_t wordsPerBrick = brickmap.wordsPerBrick;
+	std::vector<uint32_t> brick(wordsPerBrick);
+
+	for (int bz = min.z; bz <= max.z; bz++) {
+		for (int by = min.y; by <= max.y; by++) {
+			for (int bx = min.x; bx <= max.x; bx++) {
+				const size_t index = bx + (size_t)brickmap.width * (by + (size_t)brickmap.height * bz);
+				const uint32_t old = brickmap.cells[index];
+				const bool wasMixed = old != 0u && (old & BRICK_UNIFORM) == 0u;
+
+				uint32_t id, cell;
+				if (packBrick(grid, bx, by, bz, brick, id)) {
+					cell = id == 0 ? 0u : (BRICK_UNIFORM | id);
+					if (wasMixed) brickmap.freeBricks.push_back(old - 1);
+				}
+				else {
+					uint32_t slot;
+					if (wasMixed) {
+						slot = old - 1;
+					}
+					else if (!brickmap.freeBricks.empty()) {
+						slot = brickmap.freeBricks.back();
+						brickmap.freeBricks.pop_back();
+					}
+					else {
+						slot = (uint32_t)(brickmap.pool.size() / wordsPerBrick);
+						brickmap.pool.resize(brickmap.pool.size() + wordsPerBrick);
+					}
+					cell = 1 + slot;
+
+					uint32_t* stored = brickmap.pool.data() + slot * wordsPerBrick;
+					if (!std::equal(brick.begin(), brick.end(), stored)) {
+						std::copy(brick.begin(), brick.end(), stored);
+						markDirty(brickmap.poolDirty, slot * wordsPerBrick * sizeof(uint32_t), wordsPerBrick * sizeof(uint32_t));
+					}
+				}
+
+				if (cell == old) continue;
+				brickmap.cells[index] = cell;
+				markDirty(brickmap.cellsDirty, index * sizeof(uint32_t), sizeof(uint32_t));
+			}
+		}
+	}
+}
+
+uint32_t getBrickmapVoxel(const Brickmap& brickmap, int x, int y, int z) {
+	if (x < 0 || y < 0 || z < 0) return 0;
+
+	const int bx = x / BRICK_SIZE, by = y / BRICK_SIZE, bz = z / BRICK_SIZE;
+	if (bx >= brickmap.width || by >= brickmap.height || bz >= brickmap.depth) return 0;
+
+	const uint32_t cell = brickmap.cells[bx + (size_t)brickmap.width * (by + (size_t)brickmap.height * bz)];
+	if (cell == 0u) return 0;
+	if (cell & BRICK_UNIFORM) return cell & ~BRICK_UNIFORM;
+
+	const int i = x % BRICK_SIZE + BRICK_SIZE * (y % BRICK_SIZE + BRICK_SIZE * (z % BRICK_SIZE));
+	const int voxelsPerWord = 32 / brickmap.bitsPerVoxel;
+	const uint32_t mask = brickmap.bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << brickmap.bitsPerVoxel) - 1u;
+
+	return (brickmap.pool[(cell - 1) * (size_t)brickmap.wordsPerBrick + i / voxelsPerWord] >> ((i % voxelsPerWord) * brickmap.bitsPerVoxel)) & mask;
+}
+
+size_t brickmapBytes(const Brickmap& brickmap) {
+	return (brickmap.cells.size() + brickmap.pool.size()) * sizeof(uint32_t);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VoxelGrid.h"
+#include "DirtySpans.h"
+
+// Two-level voxel storage: a coarse grid of cells covering BRICK_SIZE^3 voxels each,
+// pointing into a pool that only holds the bricks that are neither empty nor uniform.
+// A cell is one of:
+//   0                      empty brick
+//   BRICK_UNIFORM | id     brick completely filled with voxel id, not stored in the pool
+//   anything else          1 + index of the brick in the pool
+const int BRICK_SIZE = 8;
+const uint32_t BRICK_UNIFORM = 0x80000000u;
+
+struct Brickmap {
+	// Size of the coarse grid, in bricks
+	int width = 0;
+	int height = 0;
+	int depth = 0;
+
+	// Bricks are packed like the VoxelGrid they were built from, x fastest
+	int bitsPerVoxel = 8;
+	int wordsPerBrick = 0;
+
+	std::vector<uint32_t> cells;
+	std::vector<uint32_t> pool;
+
+	// Bricks of the pool no cell points to anymore, reused before the pool grows
+	std::vector<uint32_t> freeBricks;
+
+	// Byte ranges of cells and pool changed by updateBrickmap() since the last upload
+	DirtySpans cellsDirty;
+	DirtySpans poolDirty;
+};
+
+void buildBrickmap(Brickmap& brickmap, const VoxelGrid& grid);
+
+// Rebuilds the bricks covering the voxels in [min, max], to be called after edits. A brick that
+// stays mixed is rewritten in place, one that becomes mixed takes a free brick or grows the pool.
+void updateBrickmap(Brickmap& brickmap, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max);
+
+uint32_t getBrickmapVoxel(const Brickmap& brickmap, int x, int y, int z);
+
+size_t brickmapBytes(const Brickmap& brickmap);
@@ -0,0 +1,460 @@
+#include "ChunkWorld.h"
+#include "WorldFile.h"
+
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+static int floorDiv(int a, int b) {
+	return (a >= 0 ? a : a - b + 1) / b;
+}
+
+static glm::ivec3 chunkOf(glm::vec3 position) {
+	return glm::ivec3(glm::floor(position / (float)CHUNK_SIZE));
+}
+
+// Index of the chunk in the table, -1 outside the window
+static int tableIndex(const ChunkWorld& world, glm::ivec3 chunk) {
+	const glm::ivec3 local = chunk - world.origin;
+	if (glm::any(glm::lessThan(local, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(local, world.dims))) return -1;
+	return local.x + world.dims.x * (local.y + world.dims.y * local.z);
+}
+
+static glm::ivec3 tableChunk(const ChunkWorld& world, int index) {
+	return world.origin + glm::ivec3(index % world.dims.x, (index / world.dims.x) % world.dims.y, index / (world.dims.x * world.dims.y));
+}
+
+static float chunkDistance(glm::ivec3 chunk, glm::vec3 position) {
+	return glm::length((glm::vec3(chunk) + 0.5f) * (float)CHUNK_SIZE - position);
+}
+
+static bool usesSlot(uint32_t entry) {
+	return entry != CHUNK_MISSING && (entry & CHUNK_UNIFORM) == 0u;
+}
+
+size_t chunkVoxelIndex(int x, int y, int z) {
+	static const VoxelGrid layout = [] {
+		VoxelGrid grid;
+		initVoxelGrid(grid, CHUNK_SIZE, CHUNK_SIZE, CHUNK_SIZE, 8, VOXEL_LAYOUT_MORTON);
+		grid.words = std::vector<uint32_t>();
+		return grid;
+	}();
+	return voxelIndex(layout, x, y, z);
+}
+
+void packChunk(const std::vector<uint8_t>& ids, PackedChunk& packed) {
+	bool used[256] = {};
+	for (uint8_t id : ids) used[id] = true;
+
+	uint8_t paletteIndex[256];
+	std::vector<uint8_t> palette;
+	for (int id = 0; id < 256; id++) {
+		if (!used[id]) continue;
+		paletteIndex[id] = (uint8_t)palette.size();
+		palette.push_back((uint8_t)id);
+	}
+
+	std::fill(packed.palette, packed.palette + CHUNK_MAX_PALETTE / 4, 0u);
+	if (palette.size() == 1) {
+		packed.header = CHUNK_UNIFORM | palette[0];
+		packed.words.clear();
+		return;
+	}
+
+	int bits = 1;
+	while ((1u << bits) < palette.size()) bits *= 2;
+
+	packed.header = (uint32_t)bits;
+	if (bits < CHUNK_MAX_BITS) {
+		packed.header |= (uint32_t)palette.size() << 8;
+		for (int i = 0; i < (int)palette.size(); i++) packed.palette[i / 4] |= (uint32_t)palette[i] << (i % 4 * 8);
+	}
+
+	packed.words.assign((size_t)bits * CHUNK_PAGE_WORDS, 0u);
+	for (int z = 0; z < CHUNK_SIZE; z++) {
+		for (int y = 0; y < CHUNK_SIZE; y++) {
+			for (int x = 0; x < CHUNK_SIZE; x++) {
+				const uint8_t id = ids[x + CHUNK_SIZE * (y + CHUNK_SIZE * z)];
+				const uint32_t value = bits == CHUNK_MAX_BITS ? id : paletteIndex[id];
+				const size_t bit = chunkVoxelIndex(x, y, z) * bits;
+				packed.words[bit / 32] |= value << (bit % 32);
+			}
+		}
+	}
+}
+
+static uint32_t* chunkRecord(ChunkWorld& world, int slot) {
+	return world.records.data() + (size_t)slot * CHUNK_RECORD_WORDS;
+}
+
+static const uint32_t* chunkRecord(const ChunkWorld& world, int slot) {
+	return world.records.data() + (size_t)slot * CHUNK_RECORD_WORDS;
+}
+
+// Pool word holding the index of a voxel, and the position of the index in it
+static size_t indexWord(const uint32_t* record, size_t voxel, int& shift) {
+	const int bits = record[0] & 0xFFu;
+	const size_t word = voxel * bits / 32;
+	shift = (int)(voxel * bits % 32);
+	return (size_t)record[CHUNK_RECORD_PAGES + word / CHUNK_PAGE_WORDS] * CHUNK_PAGE_WORDS + word % CHUNK_PAGE_WORDS;
+}
+
+static uint32_t chunkVoxel(const ChunkWorld& world, uint32_t entry, size_t voxel) {
+	if ((entry & CHUNK_UNIFORM) != 0u) return entry & ~CHUNK_UNIFORM;
+
+	const uint32_t* record = chunkRecord(world, (int)entry - 1);
+	const int bits = record[0] & 0xFFu;
+	int shift;
+	const uint32_t index = (world.pool[indexWord(record, voxel, shift)] >> shift) & ((1u << bits) - 1u);
+	if (bits == CHUNK_MAX_BITS) return index;
+	return (record[CHUNK_RECORD_PALETTE + index / 4] >> (index % 4 * 8)) & 0xFFu;
+}
+
+bool initChunkWorld(ChunkWorld& world, const WorldGenParams& params, float worldHeight, glm::ivec3 radius, int pageCount) {
+	if (glm::any(glm::lessThan(radius, glm::ivec3(0)))) {
+		std::cerr << "Invalid chunk radius: " << radius.x << "x" << radius.y << "x" << radius.z << std::endl;
+		return false;
+	}
+
+	world.params = params;
+	world.worldHeight = worldHeight;
+	world.radius = radius;
+	world.dims = 2 * radius + 1;
+	world.origin = glm::ivec3(0);
+
+	// Pages are what runs out, there is always a slot for every chunk of the window
+	const int chunks = world.dims.x * world.dims.y * world.dims.z;
+	world.slotCount = chunks;
+	world.pageCount = pageCount > 0 ? pageCount : 3 * chunks;
+
+	world.table.assign(chunks, CHUNK_MISSING);
+	world.records.assign((size_t)world.slotCount * CHUNK_RECORD_WORDS, 0u);
+	world.pool.assign((size_t)world.pageCount * CHUNK_PAGE_WORDS, 0u);
+	world.slotChunks.assign(world.slotCount, glm::ivec3(0));
+	world.freeSlots.clear();
+	for (int i = world.slotCount - 1; i >= 0; i--) world.freeSlots.push_back(i);
+	world.freePages.clear();
+	for (int i = world.pageCount - 1; i >= 0; i--) world.freePages.push_back(i);
+
+	world.hasLastCamera = false;
+	world.tableDirty.spans.clear();
+	world.recordsDirty.spans.clear();
+	world.poolDirty.spans.clear();
+	markDirty(world.tableDirty, 0, chunkTableBytes(world));
+	return true;
+}
+
+// Gives back the slot and pages of a chunk
+static void releaseChunk(ChunkWorld& world, uint32_t entry) {
+	if (!usesSlot(entry)) return;
+
+	const int slot = (int)entry - 1;
+	const uint32_t* record = chunkRecord(world, slot);
+	for (int i = (int)(record[0] & 0xFFu) - 1; i >= 0; i--) world.freePages.push_back((int)record[CHUNK_RECORD_PAGES + i]);
+	world.freeSlots.push_back(slot);
+}
+
+static void evictEntry(ChunkWorld& world, uint32_t entry) {
+	if (entry == CHUNK_MISSING) return;
+	releaseChunk(world, entry);
+	world.chunksEvicted++;
+}
+// Re-centres the table on newOrigin, keeping the chunks that are in both windows
+static void moveWindow(ChunkWorld& world, glm::ivec3 newOrigin) {
+	std::vector<uint32_t> table(world.table.size(), CHUNK_MISSING);
+	const glm::ivec3 shift = world.origin - newOrigin;
+
+	for (int i = 0; i < (int)world.table.size(); i++) {
+		const glm::ivec3 local = tableChunk(world, i) - world.origin + shift;
+		if (glm::all(glm::greaterThanEqual(local, glm::ivec3(0))) && glm::all(glm::lessThan(local, world.dims))) {
+			table[local.x + world.dims.x * (local.y + world.dims.y * local.z)] = world.table[i];
+		} else {
+			evictEntry(world, world.table[i]);
+		}
+	}
+
+	world.origin = newOrigin;
+	world.table.swap(table);
+	markDirty(world.tableDirty, 0, chunkTableBytes(world));
+}
+
+// Table index of the resident chunk with a slot farthest from position, -1 if there is none
+static int farthestSlotChunk(const ChunkWorld& world, glm::vec3 position, float& distance) {
+	int farthest = -1;
+	distance = 0.0f;
+
+	for (int slot = 0; slot < world.slotCount; slot++) {
+		const int index = tableIndex(world, world.slotChunks[slot]);
+		if (index < 0 || world.table[index] != (uint32_t)slot + 1) continue;
+
+		const float d = chunkDistance(world.slotChunks[slot], position);
+		if (farthest < 0 || d > distance) {
+			farthest = index;
+			distance = d;
+		}
+	}
+	return farthest;
+}
+
+// Frees the pages of the resident chunk farthest from position, if it is farther than maxDistance
+static bool evictFarthest(ChunkWorld& world, glm::vec3 position, float maxDistance) {
+	float distance;
+	const int farthest = farthestSlotChunk(world, position, distance);
+	if (farthest < 0 || distance <= maxDistance) return false;
+
+	evictEntry(world, world.table[farthest]);
+	world.table[farthest] = CHUNK_MISSING;
+	markDirty(world.tableDirty, farthest * sizeof(uint32_t), sizeof(uint32_t));
+	return true;
+}
+
+// Stores a packed chunk in the table entry, its pages of indices being words, evicting chunks
+// farther from focus when pages run out. Returns false if there is no room for it.
+static bool storeChunk(ChunkWorld& world, int index, uint32_t header, const uint32_t* palette, const uint32_t* words, glm::vec3 focus) {
+	const glm::ivec3 chunk = tableChunk(world, index);
+
+	if ((header & CHUNK_UNIFORM) != 0u) {
+		world.table[index] = header;
+	} else {
+		const int bits = header & 0xFFu;
+		while ((int)world.freePages.size() < bits) {
+			if (!evictFarthest(world, focus, chunkDistance(chunk, focus))) return false;
+		}
+
+		const int slot = world.freeSlots.back();
+		world.freeSlots.pop_back();
+		world.slotChunks[slot] = chunk;
+
+		uint32_t* record = chunkRecord(world, slot);
+		std::fill(record, record + CHUNK_RECORD_WORDS, 0u);
+		record[0] = header;
+		std::copy(palette, palette + CHUNK_MAX_PALETTE / 4, record + CHUNK_RECORD_PALETTE);
+
+		for (int i = 0; i < bits; i++) {
+			const int page = world.freePages.back();
+			world.freePages.pop_back();
+			record[CHUNK_RECORD_PAGES + i] = (uint32_t)page;
+
+			std::copy(words + (size_t)i * CHUNK_PAGE_WORDS, words + (size_t)(i + 1) * CHUNK_PAGE_WORDS, world.pool.begin() + (size_t)page * CHUNK_PAGE_WORDS);
+			markDirty(world.poolDirty, (size_t)page * CHUNK_PAGE_WORDS * sizeof(uint32_t), CHUNK_PAGE_WORDS * sizeof(uint32_t));
+		}
+
+		world.table[index] = (uint32_t)slot + 1;
+		markDirty(world.recordsDirty, (size_t)slot * CHUNK_RECORD_WORDS * sizeof(uint32_t), CHUNK_RECORD_WORDS * sizeof(uint32_t));
+	}
+
+	markDirty(world.tableDirty, index * sizeof(uint32_t), sizeof(uint32_t));
+	return true;
+}
+
+static bool storeChunk(ChunkWorld& world, int index, const PackedChunk& packed, glm::vec3 focus) {
+	return storeChunk(world, index, packed.header, packed.palette, packed.words.data(), focus);
+}
+
+int updateChunkWorld(ChunkWorld& world, glm::vec3 camera, float deltaTime, ThreadPool& pool) {
+	const glm::ivec3 origin = chunkOf(camera) - world.radius;
+	if (!world.hasLastCamera) {
+		world.origin = origin;
+		world.lastCamera = camera;
+		world.hasLastCamera = true;
+		markDirty(world.tableDirty, 0, chunkTableBytes(world));
+	} else if (origin != world.origin) {
+		moveWindow(world, origin);
+	}
+
+	// Load what is closest to where the camera will be, staying inside the window
+	const glm::vec3 velocity = deltaTime > 0.0f ? (camera - world.lastCamera) / deltaTime : glm::vec3(0.0f);
+	world.lastCamera = camera;
+	const glm::vec3 windowMin = glm::vec3(world.origin * CHUNK_SIZE);
+	const glm::vec3 focus = glm::clamp(camera + velocity * world.lookAhead, windowMin, windowMin + glm::vec3(world.dims * CHUNK_SIZE));
+
+	// Once the pool runs low, only chunks closer than the farthest resident one can get pages
+	float maxDistance = std::numeric_limits<float>::max();
+	float farthest;
+	if ((int)world.freePages.size() < CHUNK_MAX_BITS && farthestSlotChunk(world, focus, farthest) >= 0) maxDistance = farthest;
+
+	std::vector<std::pair<float, int>> missing;
+	for (int i = 0; i < (int)world.table.size(); i++) {
+		const float distance = chunkDistance(tableChunk(world, i), focus);
+		if (world.table[i] == CHUNK_MISSING && distance < maxDistance) missing.push_back({ distance, i });
+	}
+	const int count = std::min((int)missing.size(), world.chunksPerUpdate);
+	if (count == 0) return 0;
+	std::partial_sort(missing.begin(), missing.begin() + count, missing.end());
+
+	int loaded = 0;
+	if (world.file != nullptr) {
+		// File chunks are stored the way the pool holds them, so they are copied straight from
+		// the mapping and only the pages of the chunks touched are ever read
+		for (int i = 0; i < count; i++) {
+			const int index = missing[i].second;
+			const glm::ivec3 coords = tableChunk(world, index);
+			const WorldFileChunk* chunk = worldFileChunk(*world.file, coords);
+			if (chunk != nullptr && !worldFileChunkValid(*world.file, *chunk)) {
+				// Still stored as air so that it is not read again every update
+				std::cerr << "Corrupt world file entry for chunk " << coords.x << " " << coords.y << " " << coords.z << ", left empty" << std::endl;
+				world.chunksCorrupt++;
+				chunk = nullptr;
+			}
+			const bool stored = chunk != nullptr
+				? storeChunk(world, index, chunk->header, chunk->palette, worldFileWords(*world.file, *chunk), focus)
+				: storeChunk(world, index, CHUNK_UNIFORM | BLOCK_AIR, nullptr, nullptr, focus);
+			if (!stored) break;
+			world.chunksLoaded++;
+			loaded++;
+		}
+		return loaded;
+	}
+
+	std::vector<PackedChunk> packed(count);
+	parallelFor(pool, count, [&](int i) {
+		std::vector<uint8_t> ids;
+		generateChunkIds(world.params, world.worldHeight, tableChunk(world, missing[i].second), ids);
+		packChunk(ids, packed[i]);
+	});
+
+	for (int i = 0; i < count; i++) {
+		if (!storeChunk(world, missing[i].second, packed[i], focus)) break;
+		world.chunksLoaded++;
+		loaded++;
+	}
+	return loaded;
+}
+
+uint32_t getChunkWorldVoxel(const ChunkWorld& world, int x, int y, int z) {
+	const glm::ivec3 chunk(floorDiv(x, CHUNK_SIZE), floorDiv(y, CHUNK_SIZE), floorDiv(z, CHUNK_SIZE));
+	const int index = tableIndex(world, chunk);
+	if (index < 0 || world.table[index] == CHUNK_MISSING) return 0;
+
+	const glm::ivec3 local = glm::ivec3(x, y, z) - chunk * CHUNK_SIZE;
+	return chunkVoxel(world, world.table[index], chunkVoxelIndex(local.x, local.y, local.z));
+}
+
+bool setChunkWorldVoxel(ChunkWorld& world, int x, int y, int z, uint32_t id) {
+	if (id > 0xFFu) {
+		std::cerr << "Chunk voxel ids are 8-bit, got " << id << std::endl;
+		return false;
+	}
+
+	const glm::ivec3 chunk(floorDiv(x, CHUNK_SIZE), floorDiv(y, CHUNK_SIZE), floorDiv(z, CHUNK_SIZE));
+	const int index = tableIndex(world, chunk);
+	if (index < 0 || world.table[index] == CHUNK_MISSING) return false;
+
+	const uint32_t entry = world.table[index];
+	const glm::ivec3 local = glm::ivec3(x, y, z) - chunk * CHUNK_SIZE;
+	const size_t voxel = chunkVoxelIndex(local.x, local.y, local.z);
+	if (chunkVoxel(world, entry, voxel) == id) return true;
+
+	// Write the index in place when the id is in the palette or there is room left for it
+	if (usesSlot(entry)) {
+		const int slot = (int)entry - 1;
+		uint32_t* record = chunkRecord(world, slot);
+		const int bits = record[0] & 0xFFu;
+		const uint32_t paletteSize = record[0] >> 8;
+
+		uint32_t value = id;
+		if (bits < CHUNK_MAX_BITS) {
+			value = 0;
+			while (value < paletteSize && ((record[CHUNK_RECORD_PALETTE + value / 4] >> (value % 4 * 8)) & 0xFFu) != id) value++;
+
+			if (value == paletteSize && paletteSize < (1u << bits)) {
+				record[CHUNK_RECORD_PALETTE + value / 4] |= id << (value % 4 * 8);
+				record[0] += 1u << 8;
+				markDirty(world.recordsDirty, (size_t)slot * CHUNK_RECORD_WORDS * sizeof(uint32_t), CHUNK_RECORD_WORDS * sizeof(uint32_t));
+			}
+		}
+
+		if (value < (1u << bits)) {
+			int shift;
+			const size_t word = indexWord(record, voxel, shift);
+			world.pool[word] = (world.pool[word] & ~(((1u << bits) - 1u) << shift)) | (value << shift);
+			markDirty(world.poolDirty, word * sizeof(uint32_t), sizeof(uint32_t));
+			return true;
+		}
+	}
+
+	// Otherwise the chunk is repacked with more bits, or gets its first pages if it was uniform
+	std::vector<uint8_t> ids(CHUNK_VOXELS);
+	for (int lz = 0; lz < CHUNK_SIZE; lz++) {
+		for (int ly = 0; ly < CHUNK_SIZE; ly++) {
+			for (int lx = 0; lx < CHUNK_SIZE; lx++) {
+				ids[lx + CHUNK_SIZE * (ly + CHUNK_SIZE * lz)] = (uint8_t)chunkVoxel(world, entry, chunkVoxelIndex(lx, ly, lz));
+			}
+		}
+	}
+	ids[local.x + CHUNK_SIZE * (local.y + CHUNK_SIZE * local.z)] = (uint8_t)id;
+
+	PackedChunk packed;
+	packChunk(ids, packed);
+
+	releaseChunk(world, entry);
+	world.table[index] = CHUNK_MISSING;
+	if (!storeChunk(world, index, packed, world.lastCamera)) {
+		markDirty(world.tableDirty, index * sizeof(uint32_t), sizeof(uint32_t));
+		return false;
+	}
+	world.chunksRepacked++;
+	return true;
+}
+
+int fillChunkWorldSphere(ChunkWorld& world, glm::vec3 centre, float radius, uint32_t id) {
+	const glm::ivec3 min = glm::ivec3(glm::floor(centre - radius));
+	const glm::ivec3 max = glm::ivec3(glm::floor(centre + radius));
+
+	int changed = 0;
+	for (int z = min.z; z <= max.z; z++) {
+		for (int y = min.y; y <= max.y; y++) {
+			for (int x = min.x; x <= max.x; x++) {
+				const glm::vec3 d = glm::vec3(x, y, z) + 0.5f - centre;
+				if (glm::dot(d, d) > radius * radius || getChunkWorldVoxel(world, x, y, z) == id) continue;
+				if (setChunkWorldVoxel(world, x, y, z, id)) changed++;
+			}
+		}
+	}
+	return changed;
+}
+
+bool raycastChunkWorld(const ChunkWorld& world, glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3& hit, glm::ivec3& before) {
+	glm::ivec3 cell = glm::ivec3(glm::floor(origin));
+	const glm::ivec3 step = glm::ivec3(glm::sign(direction));
+	const glm::vec3 delta = glm::abs(1.0f / direction);
+	glm::vec3 sideDist = (glm::vec3(cell) + glm::max(glm::vec3(step), glm::vec3(0)) - origin) / direction;
+
+	float t = 0.0f;
+	before = cell;
+	while (t <= maxDistance) {
+		if (getChunkWorldVoxel(world, cell.x, cell.y, cell.z) != 0u) {
+			hit = cell;
+			return true;
+		}
+
+		before = cell;
+		const int axis = sideDist.x < sideDist.y && sideDist.x < sideDist.z ? 0 : (sideDist.y < sideDist.z ? 1 : 2);
+		t = sideDist[axis];
+		sideDist[axis] += delta[axis];
+		cell[axis] += step[axis];
+	}
+	return false;
+}
+
+int chunkWorldBits(const ChunkWorld& world, glm::ivec3 chunk) {
+	const int index = tableIndex(world, chunk);
+	if (index < 0 || !usesSlot(world.table[index])) return 0;
+	return chunkRecord(world, (int)world.table[index] - 1)[0] & 0xFFu;
+}
+
+int chunkPagesUsed(const ChunkWorld& world) {
+	return world.pageCount - (int)world.freePages.size();
+}
+
+size_t chunkTableBytes(const ChunkWorld& world) {
+	return world.table.size() * sizeof(uint32_t);
+}
+
+size_t chunkRecordBytes(const ChunkWorld& world) {
+	return world.records.size() * sizeof(uint32_t);
+}
+
+size_t chunkPoolBytes(const ChunkWorld& world) {
+	return world.pool.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "DirtySpans.h"
+#include "ThreadPool.h"
+#include "VoxelGrid.h"
+#include "WorldGen.h"
+
+// Unbounded world made of CHUNK_SIZE^3 chunks. Only a window of chunks around the camera is
+// resident: the indirection table covers the window, and the chunks it points to live in a
+// fixed pool of pages. Moving the camera slides the window and evicts the chunks that fall
+// out of it, so memory use stays the same however far the camera goes.
+const int CHUNK_SIZE = WORLDGEN_CHUNK_SIZE;
+const int CHUNK_VOXELS = CHUNK_SIZE * CHUNK_SIZE * CHUNK_SIZE;
+
+// Table entries: CHUNK_MISSING while the chunk is not loaded (traversed as empty),
+// CHUNK_UNIFORM | id for a chunk made of a single id, which takes no slot, otherwise slot + 1
+const uint32_t CHUNK_MISSING = 0;
+const uint32_t CHUNK_UNIFORM = 0x80000000u;
+
+// Every chunk has its own palette of the ids it holds, and stores CHUNK_VOXELS indices into it
+// at 1, 2, 4 or 8 bits, the fewest that fit the palette. With 8 bits the indices are the ids
+// themselves. The indices are spread over CHUNK_PAGE_WORDS word pages, one page per bit, which
+// need not be contiguous so that repacking a chunk never has to move the others.
+const int CHUNK_PAGE_WORDS = CHUNK_VOXELS / 32;
+const int CHUNK_MAX_BITS = 8;
+const int CHUNK_MAX_PALETTE = 16;
+
+// Per slot record: bits | palette size << 8, the page of every CHUNK_PAGE_WORDS words of
+// indices, then the palette, four 8-bit ids per word
+const int CHUNK_RECORD_PAGES = 1;
+const int CHUNK_RECORD_PALETTE = CHUNK_RECORD_PAGES + CHUNK_MAX_BITS;
+const int CHUNK_RECORD_WORDS = CHUNK_RECORD_PALETTE + CHUNK_MAX_PALETTE / 4;
+
+// A chunk ready for the pool: header is the first record word, or CHUNK_UNIFORM | id for a
+// uniform chunk which has no words, and words holds bits pages of indices one after the other
+struct PackedChunk {
+	uint32_t header;
+	uint32_t palette[CHUNK_MAX_PALETTE / 4];
+	std::vector<uint32_t> words;
+};
+
+// ids are x-fastest, like generateChunkIds() makes them
+void packChunk(const std::vector<uint8_t>& ids, PackedChunk& packed);
+
+// Position of a voxel among the indices of a chunk, chunks are indexed like a CHUNK_SIZE^3
+// VoxelGrid in VOXEL_LAYOUT_MORTON
+size_t chunkVoxelIndex(int x, int y, int z);
+
+// Chunks can come from a world file instead of the generator, see WorldFile.h
+struct WorldFile;
+
+struct ChunkWorld {
+	WorldGenParams params;
+	// Terrain levels are fractions of this height, see WorldGenParams
+	float worldHeight = 128.0f;
+
+	// Chunks kept on each side of the camera chunk, the window is 2 * radius + 1 chunks wide
+	glm::ivec3 radius;
+	glm::ivec3 dims;
+	// Chunk coordinates of the first table entry
+	glm::ivec3 origin;
+
+	// When set, chunks are read from this file and those outside of it are air
+	const WorldFile* file = nullptr;
+
+	int slotCount;
+	int pageCount;
+
+	std::vector<uint32_t> table;
+	// slotCount records of CHUNK_RECORD_WORDS words
+	std::vector<uint32_t> records;
+	// pageCount pages of CHUNK_PAGE_WORDS words
+	std::vector<uint32_t> pool;
+	std::vector<int> freeSlots;
+	std::vector<int> freePages;
+	// Chunk coordinates of what every slot holds
+	std::vector<glm::ivec3> slotChunks;
+
+	// At most this many chunks are generated per update
+	int chunksPerUpdate = 8;
+	// Loading favours where the camera will be this many seconds from now
+	float lookAhead = 2.0f;
+	glm::vec3 lastCamera = glm::vec3(0.0f);
+	bool hasLastCamera = false;
+
+	// Byte ranges of table, records and pool to upload
+	DirtySpans tableDirty;
+	DirtySpans recordsDirty;
+	DirtySpans poolDirty;
+
+	size_t chunksLoaded = 0;
+	size_t chunksEvicted = 0;
+	size_t chunksRepacked = 0;
+	// File chunks whose directory entry was corrupt, loaded as air
+	size_t chunksCorrupt = 0;
+};
+
+// pageCount <= 0 gives 3 pages per chunk of the window, plenty for terrain where most chunks
+// are uniform or hold at most four ids. Once the pages run out, the chunks farthest from
+// the camera are evicted to make room for closer ones.
+bool initChunkWorld(ChunkWorld& world, const WorldGenParams& params, float worldHeight, glm::ivec3 radius, int pageCount = 0);
+
+// Slides the window to the camera and generates up to chunksPerUpdate missing chunks, the ones
+// closest to where the camera is heading first. Returns the number of chunks loaded.
+int updateChunkWorld(ChunkWorld& world, glm::vec3 camera, float deltaTime, ThreadPool& pool);
+
+// 0 for voxels outside the window or in chunks not loaded yet
+uint32_t getChunkWorldVoxel(const ChunkWorld& world, int x, int y, int z);
+
+// Writes an id below 256 into a loaded chunk. A new id goes into the chunk palette, and the
+// chunk is repacked with more bits per index when the palette outgrows them. Returns false
+// when the chunk is not loaded, or when the pages for the repacked chunk could not be found,
+// in which case the chunk is unloaded and generated again later. Edits only last as long as
+// their chunk stays loaded.
+bool setChunkWorldVoxel(ChunkWorld& world, int x, int y, int z, uint32_t id);
+
+// Writes id into every voxel whose centre is within radius of centre, like queueFillSphere()
+// does for the grid. Returns the number of voxels changed, those of chunks that are not loaded
+// are left as they are.
+int fillChunkWorldSphere(ChunkWorld& world, glm::vec3 centre, float radius, uint32_t id);
+
+// First solid voxel of the loaded chunks along the ray within maxDistance, and the cell the ray
+// came from, like raycastGrid()
+bool raycastChunkWorld(const ChunkWorld& world, glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3& hit, glm::ivec3& before);
+
+// Bits per index of a loaded chunk, 0 for uniform and missing chunks
+int chunkWorldBits(const ChunkWorld& world, glm::ivec3 chunk);
+
+// Pages held by the loaded chunks
+int chunkPagesUsed(const ChunkWorld& world);
+
+// Size of the table, the records and the pool, which is what the chunk SSBO holds after its
+// header, in that order
+size_t chunkTableBytes(const ChunkWorld& world);
+size_t chunkRecordBytes(const ChunkWorld& world);
+size_t chunkPoolBytes(const ChunkWorld& world);
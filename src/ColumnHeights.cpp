@@ -0,0 +1,87 @@
+#include "ColumnHeights.h"
+
+#include <algorithm>
+
+static size_t entryIndex(const ColumnHeights& columns, int level, int x, int z) {
+	return columns.offsets[level] + x + (size_t)columns.dims[level].x * z;
+}
+
+static uint32_t scanColumn(const VoxelGrid& grid, int x, int z) {
+	for (int y = grid.height - 1; y >= 0; y--) {
+		if (getVoxel(grid, x, y, z) != 0) return (uint32_t)y + 1;
+	}
+	return 0;
+}
+
+static uint32_t computeParentTop(const ColumnHeights& columns, int level, int x, int z) {
+	const glm::ivec2 childDims = columns.dims[level - 1];
+
+	uint32_t top = 0;
+	for (int i = 0; i < 4; i++) {
+		const int cx = 2 * x + (i & 1);
+		const int cz = 2 * z + (i >> 1);
+		if (cx >= childDims.x || cz >= childDims.y) continue;
+		top = std::max(top, columns.tops[entryIndex(columns, level - 1, cx, cz)]);
+	}
+	return top;
+}
+
+void buildColumnHeights(ColumnHeights& columns, const VoxelGrid& grid, ThreadPool& pool) {
+	glm::ivec2 dims = glm::ivec2(grid.width, grid.depth);
+	size_t total = 0;
+
+	columns.levels = 0;
+	while (columns.levels < COLUMN_MAX_LEVELS) {
+		columns.dims[columns.levels] = dims;
+		columns.offsets[columns.levels] = total;
+		total += (size_t)dims.x * dims.y;
+		columns.levels++;
+		if (dims.x == 1 && dims.y == 1) break;
+		dims = (dims + 1) / 2;
+	}
+
+	columns.tops.assign(total, 0);
+
+	parallelFor(pool, grid.depth, [&](int z) {
+		for (int x = 0; x < grid.width; x++) {
+			columns.tops[entryIndex(columns, 0, x, z)] = scanColumn(grid, x, z);
+		}
+	});
+	for (int level = 1; level < columns.levels; level++) {
+		for (int z = 0; z < columns.dims[level].y; z++) {
+			for (int x = 0; x < columns.dims[level].x; x++) {
+				columns.tops[entryIndex(columns, level, x, z)] = computeParentTop(columns, level, x, z);
+			}
+		}
+	}
+	columns.dirty.spans.clear();
+}
+
+void updateColumnHeights(ColumnHeights& columns, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max) {
+	glm::ivec2 lo = glm::max(glm::ivec2(min.x, min.z), glm::ivec2(0));
+	glm::ivec2 hi = glm::min(glm::ivec2(max.x, max.z), glm::ivec2(grid.width, grid.depth) - 1);
+	if (lo.x > hi.x || lo.y > hi.y) return;
+
+	for (int level = 0; level < columns.levels; level++) {
+		for (int z = lo.y; z <= hi.y; z++) {
+			for (int x = lo.x; x <= hi.x; x++) {
+				const size_t index = entryIndex(columns, level, x, z);
+				const uint32_t top = level == 0 ? scanColumn(grid, x, z) : computeParentTop(columns, level, x, z);
+				if (top == columns.tops[index]) continue;
+
+				columns.tops[index] = top;
+				markDirty(columns.dirty, index * sizeof(uint32_t), sizeof(uint32_t));
+			}
+		}
+		lo /= 2;
+		hi /= 2;
+	}
+}
+
+uint32_t columnTop(const ColumnHeights& columns, int level, int x, int z) {
+	return columns.tops[entryIndex(columns, level, x >> level, z >> level)];
+}
+
+size_t columnHeightsBytes(const ColumnHeights& columns) {
+	return columns.tops.size() * sizeof(uint32_t);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "DirtySpans.h"
+#include "ThreadPool.h"
+#include "VoxelGrid.h"
+
+// Max-height quadtree over the columns of the grid. Level 0 holds, for every (x, z) column,
+// one more than the y of its highest solid voxel (0 for an empty column), and every level
+// above holds the largest value of the 2x2 entries below it, until a single entry covers
+// the grid. Everything at or above the value of an entry is empty over its whole footprint.
+const int COLUMN_MAX_LEVELS = 16;
+
+struct ColumnHeights {
+	int levels = 0;
+
+	// Size of each level in entries, and where it starts in entries
+	glm::ivec2 dims[COLUMN_MAX_LEVELS];
+	size_t offsets[COLUMN_MAX_LEVELS];
+
+	std::vector<uint32_t> tops;
+
+	// Byte ranges of tops changed by updateColumnHeights() since the last upload
+	DirtySpans dirty;
+};
+
+// Scans the columns down from the top of the grid on the pool
+void buildColumnHeights(ColumnHeights& columns, const VoxelGrid& grid, ThreadPool& pool);
+
+// Rescans the columns of [min, max] and updates their parents, to be called after edits
+void updateColumnHeights(ColumnHeights& columns, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max);
+
+// Entry of the level covering column (x, z)
+uint32_t columnTop(const ColumnHeights& columns, int level, int x, int z);
+
+size_t columnHeightsBytes(const ColumnHeights& columns);
@@ -0,0 +1,178 @@
+#include "Dag.h"
+
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+typedef std::array<uint32_t, 8> ChildBlock;
+
+struct ChildBlockHash {
+	size_t operator()(const ChildBlock& block) const {
+		uint64_t h = 14695981039346656037ull;
+		for (uint32_t child : block) h = (h ^ child) * 1099511628211ull;
+		return (size_t)(h ^ (h >> 32));
+	}
+};
+
+struct DagBuilder {
+	SparseVoxelOctree& dag;
+	const std::function<uint32_t(int, int, int)>& voxel;
+	glm::ivec3 bounds;
+	std::unordered_map<ChildBlock, uint32_t, ChildBlockHash> blocks;
+};
+
+static uint32_t buildNode(DagBuilder& builder, int x, int y, int z, int size) {
+	if (size == 1) {
+		const uint32_t id = builder.voxel(x, y, z);
+		return id == 0 ? 0u : (SVO_LEAF | id);
+	}
+
+	// Nodes entirely outside the scene are empty
+	if (x >= builder.bounds.x || y >= builder.bounds.y || z >= builder.bounds.z) return 0u;
+
+	const int half = size / 2;
+	ChildBlock block;
+	for (int i = 0; i < 8; i++) {
+		block[i] = buildNode(builder, x + (i & 1) * half, y + ((i >> 1) & 1) * half, z + ((i >> 2) & 1) * half, half);
+	}
+
+	// Uniform nodes collapse exactly like in the octree
+	const uint32_t first = block[0];
+	if (first == 0u || (first & SVO_LEAF)) {
+		bool uniform = true;
+		for (int i = 1; i < 8 && uniform; i++) uniform = block[i] == first;
+		if (uniform) return first;
+	}
+
+	// The children are built before their parent, so a block is only ever compared with
+	// blocks whose own children are already shared
+	auto found = builder.blocks.find(block);
+	if (found != builder.blocks.end()) return found->second;
+
+	const uint32_t index = (uint32_t)builder.dag.nodes.size();
+	builder.dag.nodes.insert(builder.dag.nodes.end(), block.begin(), block.end());
+	builder.blocks.emplace(block, index);
+	return index;
+}
+
+static void buildDag(SparseVoxelOctree& dag, glm::ivec3 bounds, const std::function<uint32_t(int, int, int)>& voxel) {
+	const int size = std::max(bounds.x, std::max(bounds.y, bounds.z));
+	dag.size = 1;
+	dag.depth = 0;
+	while (dag.size < size) {
+		dag.size *= 2;
+		dag.depth++;
+	}
+
+	dag.nodes.clear();
+	dag.nodes.push_back(0u);
+
+	DagBuilder builder = { dag, voxel, bounds, {} };
+	dag.nodes[0] = buildNode(builder, 0, 0, 0, dag.size);
+}
+
+void buildDag(SparseVoxelOctree& dag, int size, const std::function<uint32_t(int x, int y, int z)>& voxel) {
+	buildDag(dag, glm::ivec3(size), voxel);
+}
+
+void buildDag(SparseVoxelOctree& dag, const VoxelGrid& grid) {
+	buildDag(dag, glm::ivec3(grid.width, grid.height, grid.depth), [&](int x, int y, int z) { return getVoxel(grid, x, y, z); });
+}
+
+// Nodes below a child block once expanded, memoized per block
+static uint64_t expandedNodes(const SparseVoxelOctree& dag, uint32_t index, std::vector<uint64_t>& memo) {
+	if (memo[index] != 0) return memo[index];
+
+	uint64_t count = 8;
+	for (int i = 0; i < 8; i++) {
+		const uint32_t child = dag.nodes[index + i];
+		if (child != 0u && (child & SVO_LEAF) == 0u) count += expandedNodes(dag, child, memo);
+	}
+	return memo[index] = count;
+}
+
+uint64_t dagTreeNodes(const SparseVoxelOctree& dag) {
+	const uint32_t root = dag.nodes[0];
+	if (root == 0u || (root & SVO_LEAF) != 0u) return 1;
+
+	std::vector<uint64_t> memo(dag.nodes.size(), 0);
+	return 1 + expandedNodes(dag, root, memo);
+}
+
+bool saveDag(const SparseVoxelOctree& dag, const std::string& path) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+
+	const uint32_t header[4] = { 0x47445653u, (uint32_t)dag.size, (uint32_t)dag.depth, (uint32_t)dag.nodes.size() };
+	file.write((const char*)header, sizeof(header));
+	file.write((const char*)dag.nodes.data(), octreeBytes(dag));
+	return (bool)file;
+}
+
+// What the builder guarantees and the traversals rely on: a root of size 2^depth, then blocks
+// of eight children, every inner child pointing to a block written before its parent's, so
+// there are no cycles, and no path from the root deeper than depth
+static bool validDag(const SparseVoxelOctree& dag) {
+	if (dag.depth < 0 || dag.depth > 30 || dag.size != 1 << dag.depth) return false;
+	if (dag.nodes.empty() || (dag.nodes.size() - 1) % 8 != 0) return false;
+
+	// Levels of blocks from every block down, blocks in the order they were written
+	std::vector<int> levels((dag.nodes.size() - 1) / 8, 0);
+	auto childLevels = [&](uint32_t child, size_t limit, int& level) {
+		if (child == 0u || (child & SVO_LEAF) != 0u) return true;
+		if ((child - 1) % 8 != 0 || child >= limit) return false;
+		level = std::max(level, levels[(child - 1) / 8]);
+		return true;
+	};
+
+	for (size_t block = 0; block < levels.size(); block++) {
+		const size_t first = 1 + block * 8;
+		int below = 0;
+		for (size_t i = first; i < first + 8; i++) {
+			if (!childLevels(dag.nodes[i], first, below)) return false;
+		}
+		levels[block] = below + 1;
+	}
+
+	int rootLevels = 0;
+	return childLevels(dag.nodes[0], dag.nodes.size(), rootLevels) && rootLevels <= dag.depth;
+}
+
+bool loadDag(SparseVoxelOctree& dag, const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	uint32_t header[4];
+	if (!file || !file.read((char*)header, sizeof(header)) || header[0] != 0x47445653u) {
+		std::cerr << "Not a voxel DAG file: " << path << std::endl;
+		return false;
+	}
+
+	// The node count is checked against the file length before anything is allocated for it
+	const std::streamoff start = file.tellg();
+	file.seekg(0, std::ios::end);
+	const uint64_t available = (uint64_t)(file.tellg() - start) / sizeof(uint32_t);
+	file.seekg(start);
+	if (header[3] > available) {
+		std::cerr << "Truncated voxel DAG file: " << path << std::endl;
+		return false;
+	}
+
+	dag.size = (int)header[1];
+	dag.depth = (int)header[2];
+	dag.nodes.resize(header[3]);
+	if (!file.read((char*)dag.nodes.data(), octreeBytes(dag))) {
+		std::cerr << "Truncated voxel DAG file: " << path << std::endl;
+		return false;
+	}
+
+	if (!validDag(dag)) {
+		std::cerr << "Corrupt voxel DAG file: " << path << std::endl;
+		dag.nodes.clear();
+		return false;
+	}
+	return true;
+}
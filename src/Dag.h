@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "Octree.h"
+
+// Sparse voxel DAG: an octree in the SparseVoxelOctree node format where identical child
+// blocks are stored once and shared, found by hashing every block as the tree is built
+// bottom-up. Scenes that repeat themselves collapse to a small fraction of the octree,
+// and the octree traversal walks the DAG unchanged.
+
+// Online build from a grid, like buildOctree()
+void buildDag(SparseVoxelOctree& dag, const VoxelGrid& grid);
+
+// Offline build from any voxel source covering [0, size)^3, size a power of two. The scene
+// never needs to exist as a grid, so it can be far larger than memory.
+void buildDag(SparseVoxelOctree& dag, int size, const std::function<uint32_t(int x, int y, int z)>& voxel);
+
+// Nodes the same octree takes without any sharing, i.e. the size of buildOctree()'s result
+uint64_t dagTreeNodes(const SparseVoxelOctree& dag);
+
+// Binary file: "SVDG", size, depth, node count, nodes
+bool saveDag(const SparseVoxelOctree& dag, const std::string& path);
+bool loadDag(SparseVoxelOctree& dag, const std::string& path);
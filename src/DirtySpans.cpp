@@ -0,0 +1,43 @@
+#include "DirtySpans.h"
+
+#include <algorithm>
+
+void markDirty(DirtySpans& dirty, size_t offset, size_t size) {
+	if (!dirty.spans.empty()) {
+		DirtySpan& last = dirty.spans.back();
+		if (offset >= last.offset && offset <= last.offset + last.size) {
+			last.size = std::max(last.size, offset + size - last.offset);
+			return;
+		}
+	}
+	dirty.spans.push_back({ offset, size });
+}
+
+void mergeDirtySpans(DirtySpans& dirty, size_t maxGap) {
+	std::sort(dirty.spans.begin(), dirty.spans.end(), [](const DirtySpan& a, const DirtySpan& b) { return a.offset < b.offset; });
+
+	std::vector<DirtySpan> merged;
+	for (const DirtySpan& span : dirty.spans) {
+		if (!merged.empty() && span.offset <= merged.back().offset + merged.back().size + maxGap) {
+			DirtySpan& last = merged.back();
+			last.size = std::max(last.size, span.offset + span.size - last.offset);
+		}
+		else {
+			merged.push_back(span);
+		}
+	}
+	dirty.spans.swap(merged);
+}
+
+std::vector<DirtySpan> takeDirtySpans(DirtySpans& dirty, size_t maxGap) {
+	mergeDirtySpans(dirty, maxGap);
+	std::vector<DirtySpan> spans;
+	spans.swap(dirty.spans);
+	return spans;
+}
+
+size_t dirtyBytes(const std::vector<DirtySpan>& spans) {
+	size_t total = 0;
+	for (const DirtySpan& span : spans) total += span.size;
+	return total;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Byte ranges of a CPU-side buffer that changed since its last upload
+struct DirtySpan {
+	size_t offset;
+	size_t size;
+};
+
+struct DirtySpans {
+	std::vector<DirtySpan> spans;
+};
+
+// Records a changed range, extending the last one when the writes are contiguous
+void markDirty(DirtySpans& dirty, size_t offset, size_t size);
+
+// Sorts and merges the recorded ranges, joining ranges less than maxGap bytes apart
+// so that many small edits become a few uploads
+void mergeDirtySpans(DirtySpans& dirty, size_t maxGap);
+
+// Same, then forgets them
+std::vector<DirtySpan> takeDirtySpans(DirtySpans& dirty, size_t maxGap);
+
+size_t dirtyBytes(const std::vector<DirtySpan>& spans);
@@ -0,0 +1,117 @@
+#include "DistanceField.h"
+
+#include <algorithm>
+
+// Exact chessboard distance transform of the grid inside [min, max], written back for the cells of
+// [writeMin, writeMax]. Those are seeded from the voxels, the cells of the window around them keep
+// the distance already in the field, which is still right when the edit is too far to change it.
+// Two raster passes over the 26-neighbourhood are enough for the chessboard metric.
+static void distanceTransform(DistanceField& field, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max, glm::ivec3 writeMin, glm::ivec3 writeMax) {
+	const glm::ivec3 size = max - min + 1;
+	std::vector<uint8_t> window((size_t)size.x * size.y * size.z);
+
+	auto at = [&](int x, int y, int z) -> uint8_t& {
+		return window[x + (size_t)size.x * (y + (size_t)size.y * z)];
+	};
+
+	for (int z = 0; z < size.z; z++) {
+		for (int y = 0; y < size.y; y++) {
+			for (int x = 0; x < size.x; x++) {
+				const glm::ivec3 p = min + glm::ivec3(x, y, z);
+				if (glm::any(glm::lessThan(p, writeMin)) || glm::any(glm::greaterThan(p, writeMax))) {
+					at(x, y, z) = field.distances[p.x + (size_t)field.width * (p.y + (size_t)field.height * p.z)];
+				} else {
+					at(x, y, z) = getVoxel(grid, p.x, p.y, p.z) != 0 ? 0 : DISTANCE_FIELD_MAX;
+				}
+			}
+		}
+	}
+
+	// Forward pass looks at the 13 neighbours already visited, backward pass at the other 13
+	for (int pass = 0; pass < 2; pass++) {
+		const int dir = pass == 0 ? -1 : 1;
+
+		for (int i = 0; i < size.z; i++) {
+			const int z = pass == 0 ? i : size.z - 1 - i;
+			for (int j = 0; j < size.y; j++) {
+				const int y = pass == 0 ? j : size.y - 1 - j;
+				for (int k = 0; k < size.x; k++) {
+					const int x = pass == 0 ? k : size.x - 1 - k;
+
+					uint8_t& d = at(x, y, z);
+					if (d == 0) continue;
+
+					for (int n = 0; n < 13; n++) {
+						// Neighbour offsets whose first non-zero component is -1 (forward) or +1 (backward)
+						const int dz = n < 9 ? dir : 0;
+						const int dy = n < 9 ? n / 3 - 1 : (n < 12 ? dir : 0);
+						const int dx = n < 9 ? n % 3 - 1 : (n < 12 ? n - 10 : dir);
+
+						const int nx = x + dx, ny = y + dy, nz = z + dz;
+						if (nx < 0 || ny < 0 || nz < 0 || nx >= size.x || ny >= size.y || nz >= size.z) continue;
+
+						d = std::min<uint8_t>(d, at(nx, ny, nz) + 1);
+					}
+				}
+			}
+		}
+	}
+
+	for (int z = writeMin.z; z <= writeMax.z; z++) {
+		for (int y = writeMin.y; y <= writeMax.y; y++) {
+			for (int x = writeMin.x; x <= writeMax.x; x++) {
+				const size_t index = x + (size_t)field.width * (y + (size_t)field.height * z);
+				const uint8_t d = at(x - min.x, y - min.y, z - min.z);
+				if (field.distances[index] == d) continue;
+
+				field.distances[index] = d;
+				markDirty(field.dirty, index, 1);
+			}
+		}
+	}
+}
+
+void buildDistanceField(DistanceField& field, const VoxelGrid& grid) {
+	field.width = grid.width;
+	field.height = grid.height;
+	field.depth = grid.depth;
+	field.distances.assign((voxelCount(grid) + 3) / 4 * 4, 0);
+
+	const glm::ivec3 max = glm::ivec3(grid.width, grid.height, grid.depth) - 1;
+	distanceTransform(field, grid, glm::ivec3(0), max, glm::ivec3(0), max);
+	field.dirty.spans.clear();
+}
+
+// An edit only changes distances up to DISTANCE_FIELD_MAX cells away. False when none of them is
+// in the field.
+static bool editReach(const DistanceField& field, glm::ivec3 min, glm::ivec3 max, glm::ivec3& reachMin, glm::ivec3& reachMax) {
+	reachMin = glm::max(min - DISTANCE_FIELD_MAX, glm::ivec3(0));
+	reachMax = glm::min(max + DISTANCE_FIELD_MAX, glm::ivec3(field.width, field.height, field.depth) - 1);
+	return reachMin.x <= reachMax.x && reachMin.y <= reachMax.y && reachMin.z <= reachMax.z;
+}
+
+void updateDistanceField(DistanceField& field, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max) {
+	const glm::ivec3 gridMax = glm::ivec3(grid.width, grid.height, grid.depth) - 1;
+
+	// Cells further out than the reach keep their distance, so a border of one cell of them
+	// around is enough for the transform to see past them
+	glm::ivec3 writeMin, writeMax;
+	if (!editReach(field, min, max, writeMin, writeMax)) return;
+
+	distanceTransform(field, grid, glm::max(writeMin - 1, glm::ivec3(0)), glm::min(writeMax + 1, gridMax), writeMin, writeMax);
+}
+
+void markDistanceFieldReach(DistanceField& field, glm::ivec3 min, glm::ivec3 max) {
+	glm::ivec3 reachMin, reachMax;
+	if (!editReach(field, min, max, reachMin, reachMax)) return;
+
+	for (int z = reachMin.z; z <= reachMax.z; z++) {
+		for (int y = reachMin.y; y <= reachMax.y; y++) {
+			markDirty(field.dirty, reachMin.x + (size_t)field.width * (y + (size_t)field.height * z), reachMax.x - reachMin.x + 1);
+		}
+	}
+}
+
+size_t distanceFieldBytes(const DistanceField& field) {
+	return field.distances.size();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VoxelGrid.h"
+#include "DirtySpans.h"
+
+// Chebyshev (chessboard) distance from every cell to the nearest solid voxel, one byte
+// per cell with the same x + width * (y + height * z) order as the grid: 0 for solid
+// voxels, d for an empty cell whose (2d - 1)^3 neighbourhood is empty.
+// Distances are clamped to DISTANCE_FIELD_MAX, which bounds how far an edit can reach.
+const int DISTANCE_FIELD_MAX = 16;
+
+struct DistanceField {
+	int width = 0;
+	int height = 0;
+	int depth = 0;
+
+	// Padded to a multiple of 4 bytes for the upload
+	std::vector<uint8_t> distances;
+
+	// Byte ranges changed by updateDistanceField() since the last upload
+	DirtySpans dirty;
+};
+
+void buildDistanceField(DistanceField& field, const VoxelGrid& grid);
+
+// Recomputes the cells whose distance can have changed after editing the voxels in [min, max]
+void updateDistanceField(DistanceField& field, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max);
+
+// Marks every cell whose distance an edit of [min, max] can change for upload, whatever the CPU
+// copy holds. For edits that lowered the field on the GPU too, which the CPU copy cannot see.
+void markDistanceFieldReach(DistanceField& field, glm::ivec3 min, glm::ivec3 max);
+
+size_t distanceFieldBytes(const DistanceField& field);
@@ -0,0 +1,118 @@
+#include "GpuBrush.h"
+
+#include <algorithm>
+
+#include "DistanceField.h"
+#include "utils.h"
+
+GpuBrush sphereGpuBrush(glm::vec3 centre, float radius, uint32_t id) {
+	GpuBrush brush;
+	brush.shape = GPU_BRUSH_SPHERE;
+	brush.bounds = { glm::ivec3(glm::floor(centre - radius)), glm::ivec3(glm::ceil(centre + radius)) };
+	brush.id = id;
+	brush.centre = centre;
+	brush.radius = radius;
+	return brush;
+}
+
+GpuBrush boxGpuBrush(glm::ivec3 min, glm::ivec3 max, uint32_t id) {
+	GpuBrush brush;
+	brush.shape = GPU_BRUSH_BOX;
+	brush.bounds = { min, max };
+	brush.id = id;
+	return brush;
+}
+
+GpuBrush noiseGpuBrush(glm::vec3 centre, float radius, uint32_t id, float scale, float threshold, uint32_t seed) {
+	GpuBrush brush = sphereGpuBrush(centre, radius, id);
+	brush.shape = GPU_BRUSH_NOISE;
+	brush.noiseScale = scale;
+	brush.noiseThreshold = threshold;
+	brush.seed = seed;
+	return brush;
+}
+
+GLuint createGpuBrushProgram(const std::string& source) {
+	return createComputeProgram(source, "brush");
+}
+
+// One invocation per cell of [min, max], in groups of 4^3 like brush_comp.glsl
+static void dispatchPass(GLuint program, GpuBrushPass pass, int level, glm::ivec3 min, glm::ivec3 max) {
+	const glm::ivec3 size = max - min + 1;
+	setUniformInt(program, "u_Pass", pass);
+	setUniformInt(program, "u_Level", level);
+	glUniform3i(glGetUniformLocation(program, "u_Min"), min.x, min.y, min.z);
+	glUniform3i(glGetUniformLocation(program, "u_Size"), size.x, size.y, size.z);
+	glDispatchCompute((size.x + 3) / 4, (size.y + 3) / 4, (size.z + 3) / 4);
+
+	// Every pass reads what the one before wrote
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+bool dispatchGpuBrush(GLuint program, const GpuBrush& brush, const VoxelGrid& grid, const OccupancyPyramid& occupancy, const ColumnHeights& columns, VoxelBox& edited) {
+	const glm::ivec3 gridMax = glm::ivec3(grid.width, grid.height, grid.depth) - 1;
+	edited.min = glm::max(brush.bounds.min, glm::ivec3(0));
+	edited.max = glm::min(brush.bounds.max, gridMax);
+	if (glm::any(glm::greaterThan(edited.min, edited.max))) return false;
+
+	glUseProgram(program);
+	setUniformInt(program, "u_Shape", brush.shape);
+	setUniformV3(program, "u_Centre", brush.centre);
+	setUniformF(program, "u_Radius", brush.radius);
+	glUniform1ui(glGetUniformLocation(program, "u_Id"), brush.id);
+	setUniformInt(program, "u_From", brush.from);
+	setUniformF(program, "u_NoiseScale", brush.noiseScale);
+	setUniformF(program, "u_NoiseThreshold", brush.noiseThreshold);
+	glUniform1ui(glGetUniformLocation(program, "u_Seed"), brush.seed);
+	glUniform3i(glGetUniformLocation(program, "u_EditMin"), edited.min.x, edited.min.y, edited.min.z);
+	glUniform3i(glGetUniformLocation(program, "u_EditMax"), edited.max.x, edited.max.y, edited.max.z);
+
+	dispatchPass(program, GPU_BRUSH_PASS_VOXELS, 0, edited.min, edited.max);
+
+	// Same words as updateOccupancy(), level by level since every level reads the one below
+	glm::ivec3 wordMin = edited.min, wordMax = edited.max;
+	for (int level = 0; level < occupancy.levels; level++) {
+		wordMin /= 4;
+		wordMax /= 4;
+		dispatchPass(program, GPU_BRUSH_PASS_OCCUPANCY, level, wordMin, wordMax);
+	}
+
+	glm::ivec3 entryMin(edited.min.x, 0, edited.min.z), entryMax(edited.max.x, 0, edited.max.z);
+	for (int level = 0; level < columns.levels; level++) {
+		dispatchPass(program, GPU_BRUSH_PASS_COLUMNS, level, entryMin, entryMax);
+		entryMin /= 2;
+		entryMax /= 2;
+	}
+
+	// Removing voxels only makes distances larger, so the field stays valid as it is when the
+	// brush digs. Otherwise the cells it can have come closer to are those within the distance cap.
+	if (brush.id != 0) {
+		const glm::ivec3 reachMin = glm::max(edited.min - DISTANCE_FIELD_MAX, glm::ivec3(0));
+		const glm::ivec3 reachMax = glm::min(edited.max + DISTANCE_FIELD_MAX, gridMax);
+		dispatchPass(program, GPU_BRUSH_PASS_DISTANCE, 0, reachMin, reachMax);
+	}
+
+	glUseProgram(0);
+	return true;
+}
+
+void readBackVoxels(GLuint ssbo, size_t baseOffset, VoxelGrid& grid, const VoxelBox& box) {
+	// In both layouts indices only grow with x, y and z, tile by tile in the Morton one, so the
+	// voxels of the box lie between the indices of its corners rounded out to whole tiles
+	size_t first = voxelIndex(grid, box.min.x, box.min.y, box.min.z);
+	size_t last = voxelIndex(grid, box.max.x, box.max.y, box.max.z);
+	if (grid.layout == VOXEL_LAYOUT_MORTON) {
+		const size_t tileVoxels = VOXEL_TILE_SIZE * VOXEL_TILE_SIZE * VOXEL_TILE_SIZE;
+		first -= first % tileVoxels;
+		last += tileVoxels - 1 - last % tileVoxels;
+	}
+
+	const size_t voxelsPerWord = 32 / grid.bitsPerVoxel;
+	const size_t firstWord = first / voxelsPerWord;
+	const size_t lastWord = std::min(last / voxelsPerWord, grid.words.size() - 1);
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, baseOffset + firstWord * sizeof(uint32_t), (lastWord - firstWord + 1) * sizeof(uint32_t), grid.words.data() + firstWord);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include "ColumnHeights.h"
+#include "Occupancy.h"
+#include "VoxelEdit.h"
+#include "VoxelGrid.h"
+
+// Brushes too large to go through the edit queue run in a compute shader (brush_comp.glsl)
+// on the voxel SSBO itself, so nothing is uploaded. Further passes then recompute the occupancy
+// words and column heights over the edited box on the GPU, and lower the distance field around
+// it so that it never skips a new voxel.
+//
+// The grid on the CPU is then behind the SSBO until readBackVoxels() copies the box back, which
+// is only needed before something reads the grid: the edit queue, a raycast, or a rebuild of
+// the octree, DAG or brickmap. Those three are built from the grid, so they lag a frame behind.
+enum GpuBrushShape {
+	GPU_BRUSH_SPHERE = 0,
+	GPU_BRUSH_BOX,
+	// Voxels of the sphere where 3 octaves of value noise are above the threshold
+	GPU_BRUSH_NOISE
+};
+
+// Passes of brush_comp.glsl, values match the PASS_* constants there
+enum GpuBrushPass {
+	GPU_BRUSH_PASS_VOXELS = 0,
+	GPU_BRUSH_PASS_OCCUPANCY,
+	GPU_BRUSH_PASS_COLUMNS,
+	GPU_BRUSH_PASS_DISTANCE
+};
+
+struct GpuBrush {
+	GpuBrushShape shape = GPU_BRUSH_SPHERE;
+
+	// Every voxel the brush can touch. The box brush fills all of it.
+	VoxelBox bounds;
+	uint32_t id = 0;
+
+	// Only voxels holding this id are written, any voxel when negative: -1 fills, 0 floods the air
+	int from = -1;
+
+	glm::vec3 centre = glm::vec3(0.0f);
+	float radius = 0.0f;
+
+	// Noise frequency in 1 / voxels
+	float noiseScale = 0.1f;
+	float noiseThreshold = 0.5f;
+	uint32_t seed = 0;
+};
+
+GpuBrush sphereGpuBrush(glm::vec3 centre, float radius, uint32_t id);
+GpuBrush boxGpuBrush(glm::ivec3 min, glm::ivec3 max, uint32_t id);
+GpuBrush noiseGpuBrush(glm::vec3 centre, float radius, uint32_t id, float scale, float threshold, uint32_t seed);
+
+// Compiles and links brush_comp.glsl, 0 on failure
+GLuint createGpuBrushProgram(const std::string& source);
+
+// Runs the brush and then its passes. The voxel, occupancy, distance and column SSBOs must be bound
+// at their bindings of fragment.glsl. Returns false when the brush misses the grid, otherwise
+// edited is its bounds clipped to the grid.
+bool dispatchGpuBrush(GLuint program, const GpuBrush& brush, const VoxelGrid& grid, const OccupancyPyramid& occupancy, const ColumnHeights& columns, VoxelBox& edited);
+
+// Copies the words holding the voxels of box from the SSBO, where they start at baseOffset, into
+// the grid without marking them dirty
+void readBackVoxels(GLuint ssbo, size_t baseOffset, VoxelGrid& grid, const VoxelBox& box);
@@ -0,0 +1,124 @@
+#include "Heightmap.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <fstream>
+#include <iostream>
+
+// Skips whitespace and # comments, then reads a decimal number of the PGM header. False when there
+// is none or it does not fit an int.
+static bool readPgmNumber(std::istream& file, int& value) {
+	int c = file.get();
+	while (c == '#' || std::isspace(c)) {
+		if (c == '#') {
+			while (c != '\n' && c != EOF) c = file.get();
+		}
+		c = file.get();
+	}
+	if (!std::isdigit(c)) return false;
+
+	value = 0;
+	while (std::isdigit(c)) {
+		if (value > (INT_MAX - (c - '0')) / 10) return false;
+		value = value * 10 + (c - '0');
+		c = file.get();
+	}
+	// The single whitespace after the number is part of the header
+	return true;
+}
+
+bool loadHeightmap(Heightmap& heightmap, const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "Failed to open " << path << std::endl;
+		return false;
+	}
+
+	char magic[2] = {};
+	file.read(magic, 2);
+	if (magic[0] == 'P' && magic[1] == '5') {
+		int maxValue;
+		if (!readPgmNumber(file, heightmap.width) || !readPgmNumber(file, heightmap.depth) || !readPgmNumber(file, maxValue)
+			|| heightmap.width <= 0 || heightmap.depth <= 0 || maxValue <= 0 || maxValue > 65535) {
+			std::cerr << "Invalid PGM header: " << path << std::endl;
+			return false;
+		}
+
+		// Samples are big-endian when they take two bytes, and rescaled to the full 16 bits
+		const size_t count = (size_t)heightmap.width * heightmap.depth;
+		const int bytes = maxValue < 256 ? 1 : 2;
+
+		// Checked against the file before anything the size of the header's claim is allocated
+		const std::streamoff start = file.tellg();
+		file.seekg(0, std::ios::end);
+		const std::streamoff available = file.tellg() - start;
+		file.seekg(start);
+		if (available < 0 || (uint64_t)available / bytes < count) {
+			std::cerr << "Truncated PGM: " << path << std::endl;
+			return false;
+		}
+
+		std::vector<uint8_t> samples(count * bytes);
+		if (!file.read((char*)samples.data(), samples.size())) {
+			std::cerr << "Truncated PGM: " << path << std::endl;
+			return false;
+		}
+
+		heightmap.heights.resize(count);
+		for (size_t i = 0; i < count; i++) {
+			const uint32_t sample = bytes == 1 ? samples[i] : (uint32_t)samples[2 * i] << 8 | samples[2 * i + 1];
+			heightmap.heights[i] = (uint16_t)(std::min(sample, (uint32_t)maxValue) * 65535u / maxValue);
+		}
+		return true;
+	}
+
+	// Raw heightmaps carry no size, they are square
+	file.seekg(0, std::ios::end);
+	const size_t bytes = (size_t)file.tellg();
+	int side = 0;
+	while ((size_t)(side + 1) * (side + 1) * 2 <= bytes) side++;
+	if (side == 0 || (size_t)side * side * 2 != bytes) {
+		std::cerr << path << " is neither a PGM nor a square 16-bit raw heightmap" << std::endl;
+		return false;
+	}
+
+	heightmap.width = side;
+	heightmap.depth = side;
+	heightmap.heights.resize((size_t)side * side);
+	std::vector<uint8_t> samples(bytes);
+	file.seekg(0);
+	file.read((char*)samples.data(), bytes);
+	for (size_t i = 0; i < heightmap.heights.size(); i++) {
+		heightmap.heights[i] = (uint16_t)(samples[2 * i] | samples[2 * i + 1] << 8);
+	}
+	return true;
+}
+
+int heightmapTop(const Heightmap& heightmap, const VoxelGrid& grid, int x, int z) {
+	const int hx = (int)((int64_t)x * heightmap.width / grid.width);
+	const int hz = (int)((int64_t)z * heightmap.depth / grid.depth);
+	return (int)((int64_t)heightmap.heights[hx + (size_t)heightmap.width * hz] * grid.height / 65536);
+}
+
+void loadHeightmapTerrain(VoxelGrid& grid, const Heightmap& heightmap, const WorldGenParams& params, ThreadPool& pool) {
+	const int sandTop = (int)(params.sandLevel * grid.height);
+	const int snowTop = (int)(params.snowLevel * grid.height);
+
+	// Slabs of whole tiles, or of rows starting on a word boundary, never share a word
+	const bool slabsOwnWords = grid.layout == VOXEL_LAYOUT_MORTON || grid.width % (32 / grid.bitsPerVoxel) == 0;
+	const int slabs = slabsOwnWords ? (grid.depth + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE : 1;
+
+	parallelFor(pool, slabs, [&](int slab) {
+		const int zEnd = slabsOwnWords ? std::min((slab + 1) * VOXEL_TILE_SIZE, grid.depth) : grid.depth;
+		for (int z = slab * VOXEL_TILE_SIZE; z < zEnd; z++) {
+			for (int x = 0; x < grid.width; x++) {
+				const int top = heightmapTop(heightmap, grid, x, z);
+				const uint32_t surface = top <= sandTop ? BLOCK_SAND : (top >= snowTop ? BLOCK_SNOW : BLOCK_GRASS);
+				for (int y = 0; y <= top; y++) {
+					writeVoxel(grid, x, y, z, y == top ? surface : (y >= top - 3 ? (uint32_t)BLOCK_DIRT : (uint32_t)BLOCK_STONE));
+				}
+			}
+		}
+	});
+}
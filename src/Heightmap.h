@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.h"
+#include "VoxelGrid.h"
+#include "WorldGen.h"
+
+// 16-bit heightmaps as terrain tools export them: binary PGM (P5, 8 or 16 bits per sample) or
+// headerless square little-endian .r16/.raw files. Heights are in [0, 65535], x-fastest.
+struct Heightmap {
+	int width = 0;
+	int depth = 0;
+	std::vector<uint16_t> heights;
+};
+
+bool loadHeightmap(Heightmap& heightmap, const std::string& path);
+
+// Top voxel of the column the heightmap has at grid column (x, z), the heightmap is stretched
+// over the whole grid and spans its height
+int heightmapTop(const Heightmap& heightmap, const VoxelGrid& grid, int x, int z);
+
+// Fills every column of the grid up to heightmapTop() with the worldgen blocks: sand, grass or
+// snow on top depending on the levels of params, a few voxels of dirt, then stone. Slabs of
+// columns are filled on the pool. Bypasses the dirty tracking.
+void loadHeightmapTerrain(VoxelGrid& grid, const Heightmap& heightmap, const WorldGenParams& params, ThreadPool& pool);
@@ -0,0 +1,70 @@
+#include "MappedFile.h"
+
+#include <iostream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool mapFile(MappedFile& file, const std::string& path, MappedFileAccess access) {
+	unmapFile(file);
+
+#ifdef _WIN32
+	const DWORD flags = access == MAPPED_FILE_RANDOM ? FILE_FLAG_RANDOM_ACCESS : FILE_FLAG_SEQUENTIAL_SCAN;
+	HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags, nullptr);
+	LARGE_INTEGER size;
+	if (handle == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle, &size)) {
+		if (handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+		std::cerr << "Failed to open " << path << std::endl;
+		return false;
+	}
+	HANDLE mapping = size.QuadPart > 0 ? CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	void* data = mapping != nullptr ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	// The view keeps the file mapped once the handles are closed
+	if (mapping != nullptr) CloseHandle(mapping);
+	CloseHandle(handle);
+	if (data == nullptr) {
+		std::cerr << "Failed to map " << path << std::endl;
+		return false;
+	}
+	file.size = (size_t)size.QuadPart;
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+	struct stat info;
+	if (fd < 0 || fstat(fd, &info) != 0) {
+		if (fd >= 0) close(fd);
+		std::cerr << "Failed to open " << path << std::endl;
+		return false;
+	}
+	void* data = info.st_size > 0 ? mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	// The mapping stays valid once the descriptor is closed
+	close(fd);
+	if (data == MAP_FAILED) {
+		std::cerr << "Failed to map " << path << std::endl;
+		return false;
+	}
+	madvise(data, (size_t)info.st_size, access == MAPPED_FILE_RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+	file.size = (size_t)info.st_size;
+#endif
+
+	file.data = (const uint8_t*)data;
+	return true;
+}
+
+void unmapFile(MappedFile& file) {
+	if (file.data != nullptr) {
+#ifdef _WIN32
+		UnmapViewOfFile(file.data);
+#else
+		munmap((void*)file.data, file.size);
+#endif
+	}
+	file = MappedFile();
+}
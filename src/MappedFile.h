@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file. Nothing is read until the pages are touched, and
+// the pages can be dropped again by the system at any time, so files far larger than memory
+// can be mapped.
+struct MappedFile {
+	const uint8_t* data = nullptr;
+	size_t size = 0;
+};
+
+// Access hints for the system's read-ahead
+enum MappedFileAccess {
+	MAPPED_FILE_RANDOM,
+	MAPPED_FILE_SEQUENTIAL
+};
+
+bool mapFile(MappedFile& file, const std::string& path, MappedFileAccess access);
+void unmapFile(MappedFile& file);
@@ -0,0 +1,119 @@
+#include "Noise.h"
+
+#include <cmath>
+
+uint32_t hashCoords(uint32_t seed, int x, int y, int z) {
+	uint32_t h = seed ^ 0x9E3779B9u;
+	h ^= (uint32_t)x * 0x85EBCA6Bu;
+	h = (h << 13) | (h >> 19);
+	h ^= (uint32_t)y * 0xC2B2AE35u;
+	h = (h << 13) | (h >> 19);
+	h ^= (uint32_t)z * 0x27D4EB2Fu;
+
+	// Final avalanche, from MurmurHash3
+	h ^= h >> 16;
+	h *= 0x85EBCA6Bu;
+	h ^= h >> 13;
+	h *= 0xC2B2AE35u;
+	h ^= h >> 16;
+	return h;
+}
+
+static float fade(float t) {
+	return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+}
+
+static float lerp(float a, float b, float t) {
+	return a + (b - a) * t;
+}
+
+static float gradient2(uint32_t hash, float x, float y) {
+	// 8 directions: the axes and the diagonals
+	switch (hash & 7u) {
+	case 0: return x + y;
+	case 1: return -x + y;
+	case 2: return x - y;
+	case 3: return -x - y;
+	case 4: return x;
+	case 5: return -x;
+	case 6: return y;
+	default: return -y;
+	}
+}
+
+static float gradient3(uint32_t hash, float x, float y, float z) {
+	// The 12 edge directions of a cube, with 4 of them repeated to get 16 cases
+	switch (hash & 15u) {
+	case 0: return x + y;
+	case 1: return -x + y;
+	case 2: return x - y;
+	case 3: return -x - y;
+	case 4: return x + z;
+	case 5: return -x + z;
+	case 6: return x - z;
+	case 7: return -x - z;
+	case 8: return y + z;
+	case 9: return -y + z;
+	case 10: return y - z;
+	case 11: return -y - z;
+	case 12: return x + y;
+	case 13: return -y + z;
+	case 14: return -x + y;
+	default: return -y - z;
+	}
+}
+
+float gradientNoise2(uint32_t seed, float x, float y) {
+	const float fx = std::floor(x), fy = std::floor(y);
+	const int ix = (int)fx, iy = (int)fy;
+	const float dx = x - fx, dy = y - fy;
+
+	const float n00 = gradient2(hashCoords(seed, ix, iy, 0), dx, dy);
+	const float n10 = gradient2(hashCoords(seed, ix + 1, iy, 0), dx - 1, dy);
+	const float n01 = gradient2(hashCoords(seed, ix, iy + 1, 0), dx, dy - 1);
+	const float n11 = gradient2(hashCoords(seed, ix + 1, iy + 1, 0), dx - 1, dy - 1);
+
+	const float u = fade(dx), v = fade(dy);
+	return lerp(lerp(n00, n10, u), lerp(n01, n11, u), v) * 0.7071f;
+}
+
+float gradientNoise3(uint32_t seed, float x, float y, float z) {
+	const float fx = std::floor(x), fy = std::floor(y), fz = std::floor(z);
+	const int ix = (int)fx, iy = (int)fy, iz = (int)fz;
+	const float dx = x - fx, dy = y - fy, dz = z - fz;
+
+	const float n000 = gradient3(hashCoords(seed, ix, iy, iz), dx, dy, dz);
+	const float n100 = gradient3(hashCoords(seed, ix + 1, iy, iz), dx - 1, dy, dz);
+	const float n010 = gradient3(hashCoords(seed, ix, iy + 1, iz), dx, dy - 1, dz);
+	const float n110 = gradient3(hashCoords(seed, ix + 1, iy + 1, iz), dx - 1, dy - 1, dz);
+	const float n001 = gradient3(hashCoords(seed, ix, iy, iz + 1), dx, dy, dz - 1);
+	const float n101 = gradient3(hashCoords(seed, ix + 1, iy, iz + 1), dx - 1, dy, dz - 1);
+	const float n011 = gradient3(hashCoords(seed, ix, iy + 1, iz + 1), dx, dy - 1, dz - 1);
+	const float n111 = gradient3(hashCoords(seed, ix + 1, iy + 1, iz + 1), dx - 1, dy - 1, dz - 1);
+
+	const float u = fade(dx), v = fade(dy), w = fade(dz);
+	return lerp(lerp(lerp(n000, n100, u), lerp(n010, n110, u), v), lerp(lerp(n001, n101, u), lerp(n011, n111, u), v), w);
+}
+
+float fbm2(uint32_t seed, float x, float y, int octaves) {
+	float sum = 0.0f, amplitude = 0.5f;
+	for (int i = 0; i < octaves; i++) {
+		sum += amplitude * gradientNoise2(seed + i, x, y);
+		x *= 2.0f;
+		y *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return sum;
+}
+
+float fbm3(uint32_t seed, float x, float y, float z, int octaves) {
+	float sum = 0.0f, amplitude = 0.5f;
+	for (int i = 0; i < octaves; i++) {
+		sum += amplitude * gradientNoise3(seed + i, x, y, z);
+		x *= 2.0f;
+		y *= 2.0f;
+		z *= 2.0f;
+		amplitude *= 0.5f;
+	}
+	return sum;
+}
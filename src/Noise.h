@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstdint>
+
+// Seeded gradient noise. Every function is a pure function of the seed and the position,
+// so the world generator gives the same values whatever the thread count or chunk order.
+// Results are roughly in [-1, 1].
+
+uint32_t hashCoords(uint32_t seed, int x, int y, int z);
+
+float gradientNoise2(uint32_t seed, float x, float y);
+float gradientNoise3(uint32_t seed, float x, float y, float z);
+
+// Fractal Brownian motion: octaves of noise, each at twice the frequency and half the amplitude
+float fbm2(uint32_t seed, float x, float y, int octaves);
+float fbm3(uint32_t seed, float x, float y, float z, int octaves);
+
+// Batched fBm over arrays of points. The SIMD backends evaluate 8 points at a time (AVX2,
+// or two SSE2 halves) and perform the same float operations in the same order as the
+// scalar functions, so every backend gives the same values.
+enum NoiseBackend {
+	NOISE_SCALAR = 0,
+	NOISE_SSE2,
+	NOISE_AVX2,
+	NOISE_BACKEND_COUNT
+};
+
+const int NOISE_LANES = 8;
+
+// Best backend the CPU supports, used unless setNoiseBackend() asks for another one
+NoiseBackend bestNoiseBackend();
+NoiseBackend noiseBackend();
+// Returns false if the CPU does not support the backend
+bool setNoiseBackend(NoiseBackend backend);
+const char* noiseBackendName(NoiseBackend backend);
+
+void fbm2Batch(uint32_t seed, const float* x, const float* y, float* out, int count, int octaves);
+void fbm3Batch(uint32_t seed, const float* x, const float* y, const float* z, float* out, int count, int octaves);
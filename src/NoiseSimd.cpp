@@ -0,0 +1,378 @@
+#include "Noise.h"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NOISE_X86
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC accepts AVX2 intrinsics in any function
+#define AVX2_TARGET
+#else
+#define AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+// Gradient tables matching the switches of gradient2() and gradient3() in Noise.cpp. A zero
+// component adds a signed zero, which leaves the sum unchanged.
+alignas(32) static const float GRAD2_X[8] = { 1, -1, 1, -1, 1, -1, 0, 0 };
+alignas(32) static const float GRAD2_Y[8] = { 1, 1, -1, -1, 0, 0, 1, -1 };
+alignas(32) static const float GRAD3_X[16] = { 1, -1, 1, -1, 1, -1, 1, -1, 0, 0, 0, 0, 1, 0, -1, 0 };
+alignas(32) static const float GRAD3_Y[16] = { 1, 1, -1, -1, 0, 0, 0, 0, 1, -1, 1, -1, 1, -1, 1, -1 };
+alignas(32) static const float GRAD3_Z[16] = { 0, 0, 0, 0, 1, 1, -1, -1, 1, 1, -1, -1, 0, 1, 0, -1 };
+
+#ifdef NOISE_X86
+
+// SSE2, part of every x86-64 CPU. Works on 4 lanes, the batch functions run it twice.
+
+static inline __m128i mullo4(__m128i a, __m128i b) {
+	// SSE2 only has a 32x32->64 multiply on the even lanes
+	const __m128i even = _mm_mul_epu32(a, b);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static inline __m128i rotl13x4(__m128i h) {
+	return _mm_or_si128(_mm_slli_epi32(h, 13), _mm_srli_epi32(h, 19));
+}
+
+static inline __m128i hash4(uint32_t seed, __m128i x, __m128i y, __m128i z) {
+	__m128i h = _mm_set1_epi32((int)(seed ^ 0x9E3779B9u));
+	h = _mm_xor_si128(h, mullo4(x, _mm_set1_epi32((int)0x85EBCA6Bu)));
+	h = rotl13x4(h);
+	h = _mm_xor_si128(h, mullo4(y, _mm_set1_epi32((int)0xC2B2AE35u)));
+	h = rotl13x4(h);
+	h = _mm_xor_si128(h, mullo4(z, _mm_set1_epi32((int)0x27D4EB2Fu)));
+
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+	h = mullo4(h, _mm_set1_epi32((int)0x85EBCA6Bu));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 13));
+	h = mullo4(h, _mm_set1_epi32((int)0xC2B2AE35u));
+	h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+	return h;
+}
+
+static inline __m128 floor4(__m128 x) {
+	// Truncation rounds towards zero, step back by one where that went up
+	const __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+static inline __m128 lookup4(const float* table, __m128i index) {
+	alignas(16) int i[4];
+	_mm_store_si128((__m128i*)i, index);
+	return _mm_setr_ps(table[i[0]], table[i[1]], table[i[2]], table[i[3]]);
+}
+
+static inline __m128 fade4(__m128 t) {
+	const __m128 t3 = _mm_mul_ps(_mm_mul_ps(t, t), t);
+	const __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+	return _mm_mul_ps(t3, inner);
+}
+
+static inline __m128 lerp4(__m128 a, __m128 b, __m128 t) {
+	return _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), t));
+}
+
+static inline __m128 gradient2x4(__m128i hash, __m128 x, __m128 y) {
+	const __m128i index = _mm_and_si128(hash, _mm_set1_epi32(7));
+	return _mm_add_ps(_mm_mul_ps(lookup4(GRAD2_X, index), x), _mm_mul_ps(lookup4(GRAD2_Y, index), y));
+}
+
+static inline __m128 gradient3x4(__m128i hash, __m128 x, __m128 y, __m128 z) {
+	const __m128i index = _mm_and_si128(hash, _mm_set1_epi32(15));
+	const __m128 xy = _mm_add_ps(_mm_mul_ps(lookup4(GRAD3_X, index), x), _mm_mul_ps(lookup4(GRAD3_Y, index), y));
+	return _mm_add_ps(xy, _mm_mul_ps(lookup4(GRAD3_Z, index), z));
+}
+
+static __m128 gradientNoise2x4(uint32_t seed, __m128 x, __m128 y) {
+	const __m128 fx = floor4(x), fy = floor4(y);
+	const __m128i ix = _mm_cvttps_epi32(fx), iy = _mm_cvttps_epi32(fy);
+	const __m128i ix1 = _mm_add_epi32(ix, _mm_set1_epi32(1)), iy1 = _mm_add_epi32(iy, _mm_set1_epi32(1));
+	const __m128i zero = _mm_setzero_si128();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 dx = _mm_sub_ps(x, fx), dy = _mm_sub_ps(y, fy);
+	const __m128 dx1 = _mm_sub_ps(dx, one), dy1 = _mm_sub_ps(dy, one);
+
+	const __m128 n00 = gradient2x4(hash4(seed, ix, iy, zero), dx, dy);
+	const __m128 n10 = gradient2x4(hash4(seed, ix1, iy, zero), dx1, dy);
+	const __m128 n01 = gradient2x4(hash4(seed, ix, iy1, zero), dx, dy1);
+	const __m128 n11 = gradient2x4(hash4(seed, ix1, iy1, zero), dx1, dy1);
+
+	const __m128 u = fade4(dx), v = fade4(dy);
+	return _mm_mul_ps(lerp4(lerp4(n00, n10, u), lerp4(n01, n11, u), v), _mm_set1_ps(0.7071f));
+}
+
+static __m128 gradientNoise3x4(uint32_t seed, __m128 x, __m128 y, __m128 z) {
+	const __m128 fx = floor4(x), fy = floor4(y), fz = floor4(z);
+	const __m128i ix = _mm_cvttps_epi32(fx), iy = _mm_cvttps_epi32(fy), iz = _mm_cvttps_epi32(fz);
+	const __m128i ix1 = _mm_add_epi32(ix, _mm_set1_epi32(1)), iy1 = _mm_add_epi32(iy, _mm_set1_epi32(1)), iz1 = _mm_add_epi32(iz, _mm_set1_epi32(1));
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 dx = _mm_sub_ps(x, fx), dy = _mm_sub_ps(y, fy), dz = _mm_sub_ps(z, fz);
+	const __m128 dx1 = _mm_sub_ps(dx, one), dy1 = _mm_sub_ps(dy, one), dz1 = _mm_sub_ps(dz, one);
+
+	const __m128 n000 = gradient3x4(hash4(seed, ix, iy, iz), dx, dy, dz);
+	const __m128 n100 = gradient3x4(hash4(seed, ix1, iy, iz), dx1, dy, dz);
+	const __m128 n010 = gradient3x4(hash4(seed, ix, iy1, iz), dx, dy1, dz);
+	const __m128 n110 = gradient3x4(hash4(seed, ix1, iy1, iz), dx1, dy1, dz);
+	const __m128 n001 = gradient3x4(hash4(seed, ix, iy, iz1), dx, dy, dz1);
+	const __m128 n101 = gradient3x4(hash4(seed, ix1, iy, iz1), dx1, dy, dz1);
+	const __m128 n011 = gradient3x4(hash4(seed, ix, iy1, iz1), dx, dy1, dz1);
+	const __m128 n111 = gradient3x4(hash4(seed, ix1, iy1, iz1), dx1, dy1, dz1);
+
+	const __m128 u = fade4(dx), v = fade4(dy), w = fade4(dz);
+	return lerp4(lerp4(lerp4(n000, n100, u), lerp4(n010, n110, u), v), lerp4(lerp4(n001, n101, u), lerp4(n011, n111, u), v), w);
+}
+
+static void fbm2Sse2(uint32_t seed, const float* px, const float* py, float* out, int octaves) {
+	for (int half = 0; half < NOISE_LANES; half += 4) {
+		__m128 x = _mm_loadu_ps(px + half), y = _mm_loadu_ps(py + half);
+		__m128 sum = _mm_setzero_ps();
+		float amplitude = 0.5f;
+		for (int i = 0; i < octaves; i++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), gradientNoise2x4(seed + i, x, y)));
+			x = _mm_mul_ps(x, _mm_set1_ps(2.0f));
+			y = _mm_mul_ps(y, _mm_set1_ps(2.0f));
+			amplitude *= 0.5f;
+		}
+		_mm_storeu_ps(out + half, sum);
+	}
+}
+
+static void fbm3Sse2(uint32_t seed, const float* px, const float* py, const float* pz, float* out, int octaves) {
+	for (int half = 0; half < NOISE_LANES; half += 4) {
+		__m128 x = _mm_loadu_ps(px + half), y = _mm_loadu_ps(py + half), z = _mm_loadu_ps(pz + half);
+		__m128 sum = _mm_setzero_ps();
+		float amplitude = 0.5f;
+		for (int i = 0; i < octaves; i++) {
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(amplitude), gradientNoise3x4(seed + i, x, y, z)));
+			x = _mm_mul_ps(x, _mm_set1_ps(2.0f));
+			y = _mm_mul_ps(y, _mm_set1_ps(2.0f));
+			z = _mm_mul_ps(z, _mm_set1_ps(2.0f));
+			amplitude *= 0.5f;
+		}
+		_mm_storeu_ps(out + half, sum);
+	}
+}
+
+// AVX2: the same kernels on 8 lanes, with native 32-bit multiplies and table gathers.
+// Only called after checking the CPU supports it.
+
+AVX2_TARGET static inline __m256i rotl13x8(__m256i h) {
+	return _mm256_or_si256(_mm256_slli_epi32(h, 13), _mm256_srli_epi32(h, 19));
+}
+
+AVX2_TARGET static inline __m256i hash8(uint32_t seed, __m256i x, __m256i y, __m256i z) {
+	__m256i h = _mm256_set1_epi32((int)(seed ^ 0x9E3779B9u));
+	h = _mm256_xor_si256(h, _mm256_mullo_epi32(x, _mm256_set1_epi32((int)0x85EBCA6Bu)));
+	h = rotl13x8(h);
+	h = _mm256_xor_si256(h, _mm256_mullo_epi32(y, _mm256_set1_epi32((int)0xC2B2AE35u)));
+	h = rotl13x8(h);
+	h = _mm256_xor_si256(h, _mm256_mullo_epi32(z, _mm256_set1_epi32((int)0x27D4EB2Fu)));
+
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x85EBCA6Bu));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 13));
+	h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0xC2B2AE35u));
+	h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+	return h;
+}
+
+AVX2_TARGET static inline __m256 fade8(__m256 t) {
+	const __m256 t3 = _mm256_mul_ps(_mm256_mul_ps(t, t), t);
+	const __m256 inner = _mm256_add_ps(_mm256_mul_ps(t, _mm256_sub_ps(_mm256_mul_ps(t, _mm256_set1_ps(6.0f)), _mm256_set1_ps(15.0f))), _mm256_set1_ps(10.0f));
+	return _mm256_mul_ps(t3, inner);
+}
+
+AVX2_TARGET static inline __m256 lerp8(__m256 a, __m256 b, __m256 t) {
+	return _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), t));
+}
+
+AVX2_TARGET static inline __m256 gradient2x8(__m256i hash, __m256 x, __m256 y) {
+	const __m256i index = _mm256_and_si256(hash, _mm256_set1_epi32(7));
+	return _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(GRAD2_X, index, 4), x), _mm256_mul_ps(_mm256_i32gather_ps(GRAD2_Y, index, 4), y));
+}
+
+AVX2_TARGET static inline __m256 gradient3x8(__m256i hash, __m256 x, __m256 y, __m256 z) {
+	const __m256i index = _mm256_and_si256(hash, _mm256_set1_epi32(15));
+	const __m256 xy = _mm256_add_ps(_mm256_mul_ps(_mm256_i32gather_ps(GRAD3_X, index, 4), x), _mm256_mul_ps(_mm256_i32gather_ps(GRAD3_Y, index, 4), y));
+	return _mm256_add_ps(xy, _mm256_mul_ps(_mm256_i32gather_ps(GRAD3_Z, index, 4), z));
+}
+
+AVX2_TARGET static __m256 gradientNoise2x8(uint32_t seed, __m256 x, __m256 y) {
+	const __m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y);
+	const __m256i ix = _mm256_cvttps_epi32(fx), iy = _mm256_cvttps_epi32(fy);
+	const __m256i ix1 = _mm256_add_epi32(ix, _mm256_set1_epi32(1)), iy1 = _mm256_add_epi32(iy, _mm256_set1_epi32(1));
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 dx = _mm256_sub_ps(x, fx), dy = _mm256_sub_ps(y, fy);
+	const __m256 dx1 = _mm256_sub_ps(dx, one), dy1 = _mm256_sub_ps(dy, one);
+
+	const __m256 n00 = gradient2x8(hash8(seed, ix, iy, zero), dx, dy);
+	const __m256 n10 = gradient2x8(hash8(seed, ix1, iy, zero), dx1, dy);
+	const __m256 n01 = gradient2x8(hash8(seed, ix, iy1, zero), dx, dy1);
+	const __m256 n11 = gradient2x8(hash8(seed, ix1, iy1, zero), dx1, dy1);
+
+	const __m256 u = fade8(dx), v = fade8(dy);
+	return _mm256_mul_ps(lerp8(lerp8(n00, n10, u), lerp8(n01, n11, u), v), _mm256_set1_ps(0.7071f));
+}
+
+AVX2_TARGET static __m256 gradientNoise3x8(uint32_t seed, __m256 x, __m256 y, __m256 z) {
+	const __m256 fx = _mm256_floor_ps(x), fy = _mm256_floor_ps(y), fz = _mm256_floor_ps(z);
+	const __m256i ix = _mm256_cvttps_epi32(fx), iy = _mm256_cvttps_epi32(fy), iz = _mm256_cvttps_epi32(fz);
+	const __m256i ix1 = _mm256_add_epi32(ix, _mm256_set1_epi32(1)), iy1 = _mm256_add_epi32(iy, _mm256_set1_epi32(1)), iz1 = _mm256_add_epi32(iz, _mm256_set1_epi32(1));
+	const __m256 one = _mm256_set1_ps(1.0f);
+	const __m256 dx = _mm256_sub_ps(x, fx), dy = _mm256_sub_ps(y, fy), dz = _mm256_sub_ps(z, fz);
+	const __m256 dx1 = _mm256_sub_ps(dx, one), dy1 = _mm256_sub_ps(dy, one), dz1 = _mm256_sub_ps(dz, one);
+
+	const __m256 n000 = gradient3x8(hash8(seed, ix, iy, iz), dx, dy, dz);
+	const __m256 n100 = gradient3x8(hash8(seed, ix1, iy, iz), dx1, dy, dz);
+	const __m256 n010 = gradient3x8(hash8(seed, ix, iy1, iz), dx, dy1, dz);
+	const __m256 n110 = gradient3x8(hash8(seed, ix1, iy1, iz), dx1, dy1, dz);
+	const __m256 n001 = gradient3x8(hash8(seed, ix, iy, iz1), dx, dy, dz1);
+	const __m256 n101 = gradient3x8(hash8(seed, ix1, iy, iz1), dx1, dy, dz1);
+	const __m256 n011 = gradient3x8(hash8(seed, ix, iy1, iz1), dx, dy1, dz1);
+	const __m256 n111 = gradient3x8(hash8(seed, ix1, iy1, iz1), dx1, dy1, dz1);
+
+	const __m256 u = fade8(dx), v = fade8(dy), w = fade8(dz);
+	return lerp8(lerp8(lerp8(n000, n100, u), lerp8(n010, n110, u), v), lerp8(lerp8(n001, n101, u), lerp8(n011, n111, u), v), w);
+}
+
+AVX2_TARGET static void fbm2Avx2(uint32_t seed, const float* px, const float* py, float* out, int octaves) {
+	__m256 x = _mm256_loadu_ps(px), y = _mm256_loadu_ps(py);
+	__m256 sum = _mm256_setzero_ps();
+	float amplitude = 0.5f;
+	for (int i = 0; i < octaves; i++) {
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(amplitude), gradientNoise2x8(seed + i, x, y)));
+		x = _mm256_mul_ps(x, _mm256_set1_ps(2.0f));
+		y = _mm256_mul_ps(y, _mm256_set1_ps(2.0f));
+		amplitude *= 0.5f;
+	}
+	_mm256_storeu_ps(out, sum);
+}
+
+AVX2_TARGET static void fbm3Avx2(uint32_t seed, const float* px, const float* py, const float* pz, float* out, int octaves) {
+	__m256 x = _mm256_loadu_ps(px), y = _mm256_loadu_ps(py), z = _mm256_loadu_ps(pz);
+	__m256 sum = _mm256_setzero_ps();
+	float amplitude = 0.5f;
+	for (int i = 0; i < octaves; i++) {
+		sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(amplitude), gradientNoise3x8(seed + i, x, y, z)));
+		x = _mm256_mul_ps(x, _mm256_set1_ps(2.0f));
+		y = _mm256_mul_ps(y, _mm256_set1_ps(2.0f));
+		z = _mm256_mul_ps(z, _mm256_set1_ps(2.0f));
+		amplitude *= 0.5f;
+	}
+	_mm256_storeu_ps(out, sum);
+}
+
+static bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) return false;
+
+	// The OS must also save the YMM registers
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	// May run from a static initializer, before the runtime has filled in the CPU model
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+static void fbm2Scalar(uint32_t seed, const float* x, const float* y, float* out, int octaves) {
+	for (int i = 0; i < NOISE_LANES; i++) out[i] = fbm2(seed, x[i], y[i], octaves);
+}
+
+static void fbm3Scalar(uint32_t seed, const float* x, const float* y, const float* z, float* out, int octaves) {
+	for (int i = 0; i < NOISE_LANES; i++) out[i] = fbm3(seed, x[i], y[i], z[i], octaves);
+}
+
+typedef void (*Fbm2Kernel)(uint32_t, const float*, const float*, float*, int);
+typedef void (*Fbm3Kernel)(uint32_t, const float*, const float*, const float*, float*, int);
+
+static NoiseBackend s_backend = bestNoiseBackend();
+
+NoiseBackend bestNoiseBackend() {
+#ifdef NOISE_X86
+	static const NoiseBackend best = cpuHasAvx2() ? NOISE_AVX2 : NOISE_SSE2;
+	return best;
+#else
+	return NOISE_SCALAR;
+#endif
+}
+
+NoiseBackend noiseBackend() {
+	return s_backend;
+}
+
+bool setNoiseBackend(NoiseBackend backend) {
+	if (backend < NOISE_SCALAR || backend > bestNoiseBackend()) return false;
+	s_backend = backend;
+	return true;
+}
+
+const char* noiseBackendName(NoiseBackend backend) {
+	switch (backend) {
+	case NOISE_SCALAR: return "scalar";
+	case NOISE_SSE2: return "SSE2";
+	case NOISE_AVX2: return "AVX2";
+	default: return "unknown";
+	}
+}
+
+static Fbm2Kernel fbm2Kernel() {
+#ifdef NOISE_X86
+	if (s_backend == NOISE_AVX2) return fbm2Avx2;
+	if (s_backend == NOISE_SSE2) return fbm2Sse2;
+#endif
+	return fbm2Scalar;
+}
+
+static Fbm3Kernel fbm3Kernel() {
+#ifdef NOISE_X86
+	if (s_backend == NOISE_AVX2) return fbm3Avx2;
+	if (s_backend == NOISE_SSE2) return fbm3Sse2;
+#endif
+	return fbm3Scalar;
+}
+
+void fbm2Batch(uint32_t seed, const float* x, const float* y, float* out, int count, int octaves) {
+	const Fbm2Kernel kernel = fbm2Kernel();
+
+	int i = 0;
+	for (; i + NOISE_LANES <= count; i += NOISE_LANES) kernel(seed, x + i, y + i, out + i, octaves);
+
+	// The last partial batch goes through padded copies
+	if (i < count) {
+		float tx[NOISE_LANES] = {}, ty[NOISE_LANES] = {}, result[NOISE_LANES];
+		std::copy(x + i, x + count, tx);
+		std::copy(y + i, y + count, ty);
+		kernel(seed, tx, ty, result, octaves);
+		std::copy(result, result + (count - i), out + i);
+	}
+}
+
+void fbm3Batch(uint32_t seed, const float* x, const float* y, const float* z, float* out, int count, int octaves) {
+	const Fbm3Kernel kernel = fbm3Kernel();
+
+	int i = 0;
+	for (; i + NOISE_LANES <= count; i += NOISE_LANES) kernel(seed, x + i, y + i, z + i, out + i, octaves);
+
+	if (i < count) {
+		float tx[NOISE_LANES] = {}, ty[NOISE_LANES] = {}, tz[NOISE_LANES] = {}, result[NOISE_LANES];
+		std::copy(x + i, x + count, tx);
+		std::copy(y + i, y + count, ty);
+		std::copy(z + i, z + count, tz);
+		kernel(seed, tx, ty, tz, result, octaves);
+		std::copy(result, result + (count - i), out + i);
+	}
+}
@@ -0,0 +1,92 @@
+#include "Occupancy.h"
+
+#include <algorithm>
+
+static size_t wordIndex(const OccupancyPyramid& occupancy, int level, glm::ivec3 word) {
+	const glm::ivec3 dims = occupancy.dims[level];
+	return occupancy.offsets[level] + word.x + (size_t)dims.x * (word.y + (size_t)dims.y * word.z);
+}
+
+// Rebuilds the level 0 word covering the given 4^3 block of voxels
+static uint64_t computeLeafWord(const VoxelGrid& grid, glm::ivec3 word) {
+	uint64_t bits = 0;
+	for (int i = 0; i < 64; i++) {
+		const int x = word.x * 4 + (i & 3);
+		const int y = word.y * 4 + ((i >> 2) & 3);
+		const int z = word.z * 4 + (i >> 4);
+		if (getVoxel(grid, x, y, z) != 0) bits |= uint64_t(1) << i;
+	}
+	return bits;
+}
+
+// Rebuilds a word of an upper level from the 4^3 words below it
+static uint64_t computeParentWord(const OccupancyPyramid& occupancy, int level, glm::ivec3 word) {
+	const glm::ivec3 childDims = occupancy.dims[level - 1];
+
+	uint64_t bits = 0;
+	for (int i = 0; i < 64; i++) {
+		const glm::ivec3 child = word * 4 + glm::ivec3(i & 3, (i >> 2) & 3, i >> 4);
+		if (child.x >= childDims.x || child.y >= childDims.y || child.z >= childDims.z) continue;
+		if (occupancy.words[wordIndex(occupancy, level - 1, child)] != 0) bits |= uint64_t(1) << i;
+	}
+	return bits;
+}
+
+void buildOccupancy(OccupancyPyramid& occupancy, const VoxelGrid& grid) {
+	glm::ivec3 dims = glm::ivec3(grid.width, grid.height, grid.depth);
+	size_t total = 0;
+
+	occupancy.levels = 0;
+	do {
+		dims = (dims + 3) / 4;
+		occupancy.dims[occupancy.levels] = dims;
+		occupancy.offsets[occupancy.levels] = total;
+		total += (size_t)dims.x * dims.y * dims.z;
+		occupancy.levels++;
+	} while ((dims.x > 1 || dims.y > 1 || dims.z > 1) && occupancy.levels < OCCUPANCY_MAX_LEVELS);
+
+	occupancy.words.assign(total, 0);
+
+	updateOccupancy(occupancy, grid, glm::ivec3(0), glm::ivec3(grid.width, grid.height, grid.depth) - 1);
+	occupancy.dirty.spans.clear();
+}
+
+void updateOccupancy(OccupancyPyramid& occupancy, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max) {
+	min = glm::max(min, glm::ivec3(0));
+	max = glm::min(max, glm::ivec3(grid.width, grid.height, grid.depth) - 1);
+	if (min.x > max.x || min.y > max.y || min.z > max.z) return;
+
+	for (int level = 0; level < occupancy.levels; level++) {
+		min /= 4;
+		max /= 4;
+
+		for (int z = min.z; z <= max.z; z++) {
+			for (int y = min.y; y <= max.y; y++) {
+				for (int x = min.x; x <= max.x; x++) {
+					const glm::ivec3 word(x, y, z);
+					const size_t index = wordIndex(occupancy, level, word);
+					const uint64_t bits = level == 0 ? computeLeafWord(grid, word) : computeParentWord(occupancy, level, word);
+					if (bits == occupancy.words[index]) continue;
+
+					occupancy.words[index] = bits;
+					markDirty(occupancy.dirty, index * sizeof(uint64_t), sizeof(uint64_t));
+				}
+			}
+		}
+	}
+}
+
+bool isOccupied(const OccupancyPyramid& occupancy, int level, int x, int y, int z) {
+	const int shift = 2 * level;
+	const glm::ivec3 cell = glm::ivec3(x, y, z) >> shift;
+	const glm::ivec3 word = cell >> 2;
+	const glm::ivec3 dims = occupancy.dims[level];
+	if (x < 0 || y < 0 || z < 0 || word.x >= dims.x || word.y >= dims.y || word.z >= dims.z) return false;
+
+	const int bit = (cell.x & 3) + 4 * (cell.y & 3) + 16 * (cell.z & 3);
+	return (occupancy.words[wordIndex(occupancy, level, word)] >> bit) & 1;
+}
+
+size_t occupancyBytes(const OccupancyPyramid& occupancy) {
+	return occupancy.words.size() * sizeof(uint64_t);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VoxelGrid.h"
+#include "DirtySpans.h"
+
+// Hierarchical 1 bit per voxel occupancy. Every 64-bit word covers a 4x4x4 block of the
+// level below, bit (x & 3) + 4 * (y & 3) + 16 * (z & 3): at level 0 a bit is one voxel,
+// at level 1 a bit is a whole level 0 word (4^3 voxels), and so on until a single word
+// covers the grid.
+const int OCCUPANCY_MAX_LEVELS = 8;
+
+struct OccupancyPyramid {
+	int levels = 0;
+
+	// Size of each level in words, and where it starts in words
+	glm::ivec3 dims[OCCUPANCY_MAX_LEVELS];
+	size_t offsets[OCCUPANCY_MAX_LEVELS];
+
+	std::vector<uint64_t> words;
+
+	// Byte ranges of words changed by updateOccupancy() since the last upload
+	DirtySpans dirty;
+};
+
+void buildOccupancy(OccupancyPyramid& occupancy, const VoxelGrid& grid);
+
+// Recomputes the words covering the voxels in [min, max] and their parents, to be called after edits
+void updateOccupancy(OccupancyPyramid& occupancy, const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max);
+
+bool isOccupied(const OccupancyPyramid& occupancy, int level, int x, int y, int z);
+
+size_t occupancyBytes(const OccupancyPyramid& occupancy);
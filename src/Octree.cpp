@@ -0,0 +1,55 @@
+#include "Octree.h"
+
+#include <algorithm>
+
+static uint32_t buildNode(SparseVoxelOctree& svo, const VoxelGrid& grid, int x, int y, int z, int size) {
+	if (size == 1) {
+		const uint32_t id = getVoxel(grid, x, y, z);
+		return id == 0 ? 0u : (SVO_LEAF | id);
+	}
+
+	// Nodes entirely outside the grid are empty
+	if (x >= grid.width || y >= grid.height || z >= grid.depth) return 0u;
+
+	const uint32_t children = (uint32_t)svo.nodes.size();
+	svo.nodes.resize(children + 8);
+
+	const int half = size / 2;
+	for (int i = 0; i < 8; i++) {
+		svo.nodes[children + i] = buildNode(svo, grid, x + (i & 1) * half, y + ((i >> 1) & 1) * half, z + ((i >> 2) & 1) * half, half);
+	}
+
+	// Collapse uniform nodes. A child that is empty or a leaf never leaves nodes behind it,
+	// so the 8 slots are still at the end of the array and can simply be dropped.
+	const uint32_t first = svo.nodes[children];
+	bool uniform = first == 0u || (first & SVO_LEAF);
+	for (int i = 1; i < 8 && uniform; i++) {
+		uniform = svo.nodes[children + i] == first;
+	}
+
+	if (uniform) {
+		svo.nodes.resize(children);
+		return first;
+	}
+
+	return children;
+}
+
+void buildOctree(SparseVoxelOctree& svo, const VoxelGrid& grid) {
+	const int maxDim = std::max(grid.width, std::max(grid.height, grid.depth));
+
+	svo.size = 1;
+	svo.depth = 0;
+	while (svo.size < maxDim) {
+		svo.size *= 2;
+		svo.depth++;
+	}
+
+	svo.nodes.clear();
+	svo.nodes.push_back(0u);
+	svo.nodes[0] = buildNode(svo, grid, 0, 0, 0, svo.size);
+}
+
+size_t octreeBytes(const SparseVoxelOctree& svo) {
+	return svo.nodes.size() * sizeof(uint32_t);
+}
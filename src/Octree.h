@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "VoxelGrid.h"
+
+// Sparse voxel octree, stored as a flat array of 32-bit nodes:
+//   0                  empty node
+//   SVO_LEAF | id      node completely filled with voxel id
+//   anything else      index of the node's 8 children, ordered x | y << 1 | z << 2
+// The root is nodes[0]. Subtrees made of a single id are collapsed into one leaf.
+const uint32_t SVO_LEAF = 0x80000000u;
+
+struct SparseVoxelOctree {
+	// Edge length of the root node, the smallest power of two covering the grid
+	int size = 0;
+	int depth = 0;
+
+	std::vector<uint32_t> nodes;
+};
+
+void buildOctree(SparseVoxelOctree& svo, const VoxelGrid& grid);
+
+size_t octreeBytes(const SparseVoxelOctree& svo);
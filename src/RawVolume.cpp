@@ -0,0 +1,79 @@
+#include "RawVolume.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include "WorldFile.h"
+
+bool openRawVolume(RawVolume& volume, const std::string& path, glm::ivec3 dims, int bytesPerSample, bool bigEndian) {
+	closeRawVolume(volume);
+
+	if (glm::any(glm::lessThanEqual(dims, glm::ivec3(0))) || (bytesPerSample != 1 && bytesPerSample != 2)) {
+		std::cerr << "Invalid raw volume: " << dims.x << "x" << dims.y << "x" << dims.z << ", " << bytesPerSample << " bytes per sample" << std::endl;
+		return false;
+	}
+
+	// The whole file is swept once, slab after slab of chunks
+	if (!mapFile(volume.mapping, path, MAPPED_FILE_SEQUENTIAL))
+		return false;
+
+	const uint64_t expected = (uint64_t)dims.x * dims.y * dims.z * bytesPerSample;
+	if (volume.mapping.size != expected) {
+		std::cerr << path << " holds " << volume.mapping.size << " bytes, expected " << expected << std::endl;
+		closeRawVolume(volume);
+		return false;
+	}
+
+	volume.dims = dims;
+	volume.bytesPerSample = bytesPerSample;
+	volume.bigEndian = bigEndian;
+	return true;
+}
+
+void closeRawVolume(RawVolume& volume) {
+	unmapFile(volume.mapping);
+	volume = RawVolume();
+}
+
+bool ingestRawVolume(const std::string& path, const RawVolume& volume, const std::vector<uint32_t>& thresholds, ThreadPool& pool) {
+	if (thresholds.empty() || thresholds.size() >= PALETTE_SIZE || !std::is_sorted(thresholds.begin(), thresholds.end())) {
+		std::cerr << "Expected 1 to " << PALETTE_SIZE - 1 << " ascending thresholds" << std::endl;
+		return false;
+	}
+
+	// Every possible sample value maps to its id, so classifying is a lookup per voxel
+	const uint32_t values = 1u << (8 * volume.bytesPerSample);
+	std::vector<uint8_t> classes(values);
+	for (uint32_t value = 0; value < values; value++) {
+		classes[value] = (uint8_t)(std::upper_bound(thresholds.begin(), thresholds.end(), value) - thresholds.begin());
+	}
+
+	// Dark red for the faintest class up to near white for the densest, like a bone window
+	glm::vec4 palette[PALETTE_SIZE] = {};
+	for (size_t i = 0; i < thresholds.size(); i++) {
+		const float t = thresholds.size() > 1 ? (float)i / (float)(thresholds.size() - 1) : 1.0f;
+		palette[i + 1] = glm::vec4(glm::mix(glm::vec3(0.55f, 0.2f, 0.15f), glm::vec3(0.95f, 0.92f, 0.85f), t), 0.0f);
+	}
+
+	const glm::ivec3 dims = (volume.dims + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	return writeWorldFile(path, glm::ivec3(0), dims, 0, [&](glm::ivec3 chunk, std::vector<uint8_t>& ids) {
+		ids.assign(CHUNK_VOXELS, 0);
+
+		const glm::ivec3 start = chunk * CHUNK_SIZE;
+		const glm::ivec3 end = glm::min(start + CHUNK_SIZE, volume.dims);
+		for (int z = start.z; z < end.z; z++) {
+			for (int y = start.y; y < end.y; y++) {
+				const size_t sample = (size_t)start.x + (size_t)volume.dims.x * (y + (size_t)volume.dims.y * z);
+				uint8_t* row = ids.data() + CHUNK_SIZE * ((y - start.y) + CHUNK_SIZE * (z - start.z));
+				if (volume.bytesPerSample == 1) {
+					const uint8_t* samples = volume.mapping.data + sample;
+					for (int x = 0; x < end.x - start.x; x++) row[x] = classes[samples[x]];
+				} else {
+					const uint8_t* samples = volume.mapping.data + 2 * sample;
+					const int high = volume.bigEndian ? 0 : 1;
+					for (int x = 0; x < end.x - start.x; x++) row[x] = classes[samples[2 * x + high] << 8 | samples[2 * x + 1 - high]];
+				}
+			}
+		}
+	}, pool, palette);
+}
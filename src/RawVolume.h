@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "MappedFile.h"
+#include "ThreadPool.h"
+
+// Headerless scalar volumes as CT scanners and simulations dump them: width * height * depth
+// samples of 8 or 16 bits, x-fastest, then y, then z. The file is mapped rather than read, so
+// an ingest only ever holds the few chunks the threads are working on.
+struct RawVolume {
+	MappedFile mapping;
+	glm::ivec3 dims;
+	int bytesPerSample;
+	bool bigEndian;
+};
+
+// Fails unless the file holds exactly the samples of dims
+bool openRawVolume(RawVolume& volume, const std::string& path, glm::ivec3 dims, int bytesPerSample, bool bigEndian = false);
+void closeRawVolume(RawVolume& volume);
+
+// Classifies the volume into a world file, thresholds are ascending sample values and a sample
+// of at least thresholds[i] becomes voxel id i + 1, below the first it is air. The chunks are
+// classified and their mips built on the pool threads, and every class gets a colour of a ramp.
+bool ingestRawVolume(const std::string& path, const RawVolume& volume, const std::vector<uint32_t>& thresholds, ThreadPool& pool);
@@ -0,0 +1,38 @@
+#include "RaySort.h"
+
+static uint32_t spreadCellBits(uint32_t v) {
+	uint32_t spread = 0;
+	for (int bit = 0; bit < RAY_SORT_CELL_BITS; bit++) spread |= ((v >> bit) & 1u) << (3 * bit);
+	return spread;
+}
+
+int raySortCellShift(glm::ivec3 gridSize) {
+	const int largest = glm::max(gridSize.x, glm::max(gridSize.y, gridSize.z));
+	int shift = 0;
+	while (((largest - 1) >> shift) >= RAY_SORT_CELLS) shift++;
+	return shift;
+}
+
+uint32_t raySortKey(glm::vec3 origin, glm::vec3 direction, glm::ivec3 gridSize, int cellShift) {
+	const glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(origin)), glm::ivec3(0), gridSize - 1) >> cellShift;
+	const uint32_t morton = spreadCellBits(cell.x) | (spreadCellBits(cell.y) << 1) | (spreadCellBits(cell.z) << 2);
+	const uint32_t octant = (direction.x < 0 ? 1u : 0u) | (direction.y < 0 ? 2u : 0u) | (direction.z < 0 ? 4u : 0u);
+	return (octant << (3 * RAY_SORT_CELL_BITS)) | morton;
+}
+
+void sortRayKeys(const std::vector<uint32_t>& keys, std::vector<uint32_t>& order) {
+	// Same three passes as the GPU: count the rays of every bin, turn the counts into the first
+	// slot of each bin, then move every ray to the next slot of its bin
+	std::vector<uint32_t> binStart(RAY_SORT_BINS, 0);
+	for (uint32_t key : keys) binStart[key]++;
+
+	uint32_t start = 0;
+	for (uint32_t& bin : binStart) {
+		const uint32_t count = bin;
+		bin = start;
+		start += count;
+	}
+
+	order.resize(keys.size());
+	for (size_t i = 0; i < keys.size(); i++) order[binStart[keys[i]]++] = (uint32_t)i;
+}
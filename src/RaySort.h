@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+// Coherence sort of secondary rays, the CPU reference of the sort stages of wavefront_comp.glsl.
+// Diffuse bounces leave in random directions, so the queue the shade stage fills walks the grid
+// in no particular order. Binning the rays by direction octant, then by the cell of the grid they
+// start in along a Z-order curve, gives consecutive invocations rays that cross the same voxels.
+//
+// A key is the octant (3 sign bits) above the Morton code of the origin cell. Cells are a power
+// of two wide, the smallest that cuts the grid into at most RAY_SORT_CELLS cells per axis.
+const int RAY_SORT_CELL_BITS = 4;
+const int RAY_SORT_CELLS = 1 << RAY_SORT_CELL_BITS;
+const int RAY_SORT_BINS = 8 << (3 * RAY_SORT_CELL_BITS);
+
+// log2 of the width of the cells of a grid of this size
+int raySortCellShift(glm::ivec3 gridSize);
+
+// Origins outside the grid go to the nearest cell
+uint32_t raySortKey(glm::vec3 origin, glm::vec3 direction, glm::ivec3 gridSize, int cellShift);
+
+// Stable counting sort of the keys: order[i] is the index of the i-th ray once sorted
+void sortRayKeys(const std::vector<uint32_t>& keys, std::vector<uint32_t>& order);
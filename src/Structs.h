@@ -4,6 +4,17 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "VoxelGrid.h"
+#include "Dag.h"
+#include "Octree.h"
+#include "Brickmap.h"
+#include "Occupancy.h"
+#include "ColumnHeights.h"
+#include "DistanceField.h"
+#include "UploadRing.h"
+#include "ChunkWorld.h"
+#include "Wavefront.h"
+
 struct keys {
 	bool w = false;
 	bool a = false;
@@ -34,15 +45,109 @@ struct Camera {
 	keys keys;
 };
 
+// Header of the voxel SSBO, matching the std430 block in fragment.glsl.
+// The packed voxel words of the VoxelGrid follow directly after it.
 struct shader_data {
 	int mapw;
 	int maph;
 	int mapd;
+	int bitsPerVoxel;
+
+	// VoxelGrid::layout, strideShiftY and strideShiftZ
+	int layout;
+	int strideShiftY;
+	int strideShiftZ;
+	int pad;
+
+	// rgb: colour, w: emission strength
+	glm::vec4 palette[PALETTE_SIZE];
+};
+
+static_assert(sizeof(shader_data) == 32 + PALETTE_SIZE * 16, "shader_data must match the std430 layout");
+
+// Header of the occupancy SSBO, followed by the pyramid words
+struct occupancy_header {
+	int levels;
+	int pad[3];
+
+	// xyz: size of the level in words, w: first word of the level
+	glm::ivec4 level[OCCUPANCY_MAX_LEVELS];
+};
+
+// Header of the column heights SSBO, followed by the quadtree entries
+struct column_header {
+	int levels;
+	int pad[3];
+
+	// xy: size of the level in entries, w: first entry of the level
+	glm::ivec4 level[COLUMN_MAX_LEVELS];
+};
+
+// Header of the chunk SSBO, followed by the indirection table, the chunk records and the pool
+// of pages (see ChunkWorld.h)
+struct chunk_header {
+	// xyz: chunk coordinates of the first table entry, w: number of records
+	glm::ivec4 origin;
+	// xyz: size of the table in chunks, w: number of pages
+	glm::ivec4 dims;
+};
+
+// Selects the voxel traversal used by fragment.glsl, values match the TRAVERSAL_* constants there
+enum TraversalMode {
+	TRAVERSAL_DDA = 0,
+	TRAVERSAL_SVO,
+	TRAVERSAL_BRICKMAP,
+	TRAVERSAL_OCCUPANCY,
+	TRAVERSAL_DISTANCE,
+	TRAVERSAL_CHUNKS,
+	TRAVERSAL_DAG,
+	TRAVERSAL_COLUMNS,
+	TRAVERSAL_COUNT
+};
 
-	glm::vec3 palette[10];
-	
-	int data[15*15*15];
+// Step and distance budget of the voxel traversals of tracing.glsl. Primary rays get maxSteps
+// and no distance limit. Bounce b gets both budgets scaled by bounceFalloff^(b - 1), but never
+// less than minSteps and minDistance.
+struct RayBudget {
+	int maxSteps;
+	float maxDistance;
+	float bounceFalloff = 0.5f;
+	int minSteps;
+	float minDistance;
+};
+
+// Budget of a traversal over a structure of extent voxels: the grid, the root of the octree or
+// the DAG, or the chunk window. A DDA crosses at most x + y + z cells of it and the octree
+// traversals take at most one step per cell, and no ray inside it goes further than its
+// diagonal, so of the rays starting in it these budgets only cut those of the later bounces.
+inline RayBudget defaultRayBudget(glm::ivec3 extent) {
+	RayBudget budget;
+	budget.maxSteps = extent.x + extent.y + extent.z;
+	budget.maxDistance = glm::length(glm::vec3(extent));
+	budget.minSteps = budget.maxSteps / 8;
+	budget.minDistance = budget.maxDistance / 8.0f;
+	return budget;
+}
+
+// Contents of the budget SSBO, matching budget_data in fragment.glsl: rays traced and rays that
+// ran out of budget, per bounce
+const int BUDGET_COUNTED_BOUNCES = 32;
+
+struct budget_counters {
+	uint32_t rays[BUDGET_COUNTED_BOUNCES];
+	uint32_t exhausted[BUDGET_COUNTED_BOUNCES];
+};
 
+// Brush requested by a click, applied by the next frame
+enum BrushAction {
+	BRUSH_NONE = 0,
+	BRUSH_ADD,
+	BRUSH_DIG,
+	// Large brushes, run on the GPU (see GpuBrush.h)
+	BRUSH_SCULPT_ADD,
+	BRUSH_SCULPT_DIG,
+	BRUSH_NOISE_ADD,
+	BRUSH_NOISE_DIG
 };
 
 struct Framebuffer {
@@ -59,12 +164,35 @@ struct AppState {
 
 	GLuint shader;
 	GLuint quad_shader;
+	GLuint brushProgram;
+	Wavefront wavefront;
 
 	shader_data s_data;
 	GLuint ssbo;
+	GLuint svoSsbo;
+	GLuint brickmapSsbo;
+	GLuint occupancySsbo;
+	GLuint distanceSsbo;
+	GLuint chunkSsbo;
+	GLuint dagSsbo;
+	GLuint columnSsbo;
+	GLuint budgetSsbo;
+
+	UploadRing uploadRing;
 	Framebuffer fb1;
 	Framebuffer fb2;
 
 	bool useSRGB = true;
 	bool useACES = true;
+	bool sunShadows = true;
+	// Trace with wavefront_comp.glsl instead of fragment.glsl
+	bool useWavefront = false;
+
+	int traversalMode = TRAVERSAL_DDA;
+	int brush = BRUSH_NONE;
+
+	// One per TraversalMode, each sized for the structure it walks
+	RayBudget rayBudgets[TRAVERSAL_COUNT];
+	// Counts the rays that run out of budget into the budget SSBO
+	bool countBudget = false;
 };
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include "ThreadPool.h"
+
+static void runTasks(ThreadPool& pool) {
+	for (int i = pool.next.fetch_add(1); i < pool.count; i = pool.next.fetch_add(1)) {
+		pool.task(i);
+
+		if (pool.finished.fetch_add(1) + 1 == pool.count) {
+			std::lock_guard<std::mutex> lock(pool.mutex);
+			pool.done.notify_all();
+		}
+	}
+}
+
+static void workerLoop(ThreadPool* pool) {
+	uint64_t seen = 0;
+
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(pool->mutex);
+			pool->wake.wait(lock, [&] { return pool->quit || pool->generation != seen; });
+			if (pool->quit) return;
+
+			seen = pool->generation;
+			pool->activeWorkers++;
+		}
+
+		runTasks(*pool);
+
+		std::lock_guard<std::mutex> lock(pool->mutex);
+		pool->activeWorkers--;
+		pool->done.notify_all();
+	}
+}
+
+void initThreadPool(ThreadPool& pool, int threads) {
+	if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+	if (threads <= 0) threads = 1;
+
+	pool.quit = false;
+	for (int i = 1; i < threads; i++) {
+		pool.workers.emplace_back(workerLoop, &pool);
+	}
+}
+
+void destroyThreadPool(ThreadPool& pool) {
+	{
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		pool.quit = true;
+	}
+	pool.wake.notify_all();
+
+	for (std::thread& worker : pool.workers) worker.join();
+	pool.workers.clear();
+}
+
+int threadCount(const ThreadPool& pool) {
+	return (int)pool.workers.size() + 1;
+}
+
+void parallelFor(ThreadPool& pool, int count, const std::function<void(int)>& task) {
+	if (count <= 0) return;
+
+	{
+		// A worker that woke up too late for the previous job may still be on its way out of it,
+		// it must not see the counters of this one
+		std::unique_lock<std::mutex> lock(pool.mutex);
+		pool.done.wait(lock, [&] { return pool.activeWorkers == 0; });
+
+		pool.task = task;
+		pool.count = count;
+		pool.next = 0;
+		pool.finished = 0;
+		pool.generation++;
+	}
+	pool.wake.notify_all();
+
+	runTasks(pool);
+
+	// Also wait for the workers to leave runTasks(), so the next job can safely replace this one
+	std::unique_lock<std::mutex> lock(pool.mutex);
+	pool.done.wait(lock, [&] { return pool.finished == pool.count && pool.activeWorkers == 0; });
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running one parallelFor() at a time
+struct ThreadPool {
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+
+	// Current job, replaced by every parallelFor()
+	std::function<void(int)> task;
+	int count = 0;
+	std::atomic<int> next{ 0 };
+	std::atomic<int> finished{ 0 };
+
+	// Bumped for every job so sleeping workers know there is something new
+	uint64_t generation = 0;
+	int activeWorkers = 0;
+	bool quit = false;
+};
+
+// threads <= 0 uses one thread per hardware thread. The calling thread also takes part in
+// parallelFor(), so threads - 1 workers are started.
+void initThreadPool(ThreadPool& pool, int threads = 0);
+void destroyThreadPool(ThreadPool& pool);
+
+int threadCount(const ThreadPool& pool);
+
+// Runs task(i) for every i in [0, count) and returns once they are all done
+void parallelFor(ThreadPool& pool, int count, const std::function<void(int)>& task);
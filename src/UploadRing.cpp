@@ -0,0 +1,121 @@
+#include "UploadRing.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+void initUploadRing(UploadRing& ring, size_t slotSize) {
+	ring.slotSize = slotSize;
+	ring.slot = 0;
+	ring.used = 0;
+	ring.persistent = GLAD_GL_VERSION_4_4 != 0;
+
+	if (!ring.persistent) {
+		std::cerr << "GL 4.4 buffer storage unavailable, voxel uploads use glBufferSubData" << std::endl;
+		return;
+	}
+
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+	glGenBuffers(1, &ring.buffer);
+	glBindBuffer(GL_COPY_READ_BUFFER, ring.buffer);
+	glBufferStorage(GL_COPY_READ_BUFFER, slotSize * UPLOAD_RING_SLOTS, nullptr, flags);
+	ring.mapped = (char*)glMapBufferRange(GL_COPY_READ_BUFFER, 0, slotSize * UPLOAD_RING_SLOTS, flags);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+
+	if (!ring.mapped) {
+		std::cerr << "Failed to map the upload ring, voxel uploads use glBufferSubData" << std::endl;
+		glDeleteBuffers(1, &ring.buffer);
+		ring.buffer = 0;
+		ring.persistent = false;
+	}
+}
+
+void destroyUploadRing(UploadRing& ring) {
+	for (GLsync& fence : ring.fences) {
+		if (fence) glDeleteSync(fence);
+		fence = nullptr;
+	}
+	if (ring.buffer) {
+		glBindBuffer(GL_COPY_READ_BUFFER, ring.buffer);
+		glUnmapBuffer(GL_COPY_READ_BUFFER);
+		glBindBuffer(GL_COPY_READ_BUFFER, 0);
+		glDeleteBuffers(1, &ring.buffer);
+	}
+	ring.buffer = 0;
+	ring.mapped = nullptr;
+}
+
+// Slot offsets are kept 16 byte aligned for the copies
+static size_t alignedBytes(size_t size) {
+	return (size + 15) & ~(size_t)15;
+}
+
+size_t stagedBytes(DirtySpans& dirty) {
+	mergeDirtySpans(dirty, UPLOAD_MAX_GAP);
+	size_t total = 0;
+	for (const DirtySpan& span : dirty.spans) total += alignedBytes(span.size);
+	return total;
+}
+
+bool beginUploadFrame(UploadRing& ring, size_t bytes) {
+	ring.used = 0;
+	ring.slotAvailable = false;
+	if (!ring.persistent) return true;
+
+	// A new buffer has no copies in flight. The old one is released by the driver once the GPU
+	// is done with it.
+	if (bytes > ring.slotSize) {
+		const size_t slotSize = std::max(alignedBytes(bytes), 2 * ring.slotSize);
+		destroyUploadRing(ring);
+		initUploadRing(ring, slotSize);
+		std::cout << "Upload ring grown to " << UPLOAD_RING_SLOTS << " x " << slotSize << " bytes" << std::endl;
+		if (!ring.persistent) return true;
+	}
+
+	// Zero timeout: only polls the fence, never blocks. A busy slot is tried again next frame.
+	const int slot = (ring.slot + 1) % UPLOAD_RING_SLOTS;
+	GLsync& fence = ring.fences[slot];
+	if (fence) {
+		if (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) return false;
+		glDeleteSync(fence);
+		fence = nullptr;
+	}
+
+	ring.slot = slot;
+	ring.slotAvailable = true;
+	return true;
+}
+
+void endUploadFrame(UploadRing& ring) {
+	if (!ring.persistent || !ring.slotAvailable || ring.used == 0) return;
+
+	ring.fences[ring.slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void stageUpload(UploadRing& ring, GLuint dst, size_t dstOffset, const void* data, size_t size) {
+	// Also what happens to more than beginUploadFrame() was told about, which is a caller bug
+	if (!ring.persistent || !ring.slotAvailable || size > ring.slotSize - ring.used) {
+		glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+		glBufferSubData(GL_COPY_WRITE_BUFFER, dstOffset, size, data);
+		glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+		return;
+	}
+
+	const size_t srcOffset = ring.slot * ring.slotSize + ring.used;
+	memcpy(ring.mapped + srcOffset, data, size);
+
+	glBindBuffer(GL_COPY_READ_BUFFER, ring.buffer);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, dst);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, srcOffset, dstOffset, size);
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+	ring.used = std::min(ring.slotSize, ring.used + alignedBytes(size));
+}
+
+void stageDirtySpans(UploadRing& ring, GLuint dst, size_t baseOffset, const void* data, DirtySpans& dirty) {
+	for (const DirtySpan& span : takeDirtySpans(dirty, UPLOAD_MAX_GAP)) {
+		stageUpload(ring, dst, baseOffset + span.offset, (const char*)data + span.offset, span.size);
+	}
+}
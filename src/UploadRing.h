@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+
+#include <glad/gl.h>
+
+#include "DirtySpans.h"
+
+// Persistently mapped staging buffer split into one slot per frame in flight. Data is copied
+// into the current slot on the CPU and then into its destination buffer with GPU-side copies.
+// A fence guards every slot and is only ever polled, the CPU never waits for the GPU. What a
+// frame changed goes up as one batch in a single slot or not at all: when the next slot is
+// still being read, the whole batch stays dirty for the next frame, so a structure and those
+// derived from it are never seen half uploaded. A batch larger than a slot grows the ring.
+const int UPLOAD_RING_SLOTS = 3;
+
+struct UploadRing {
+	GLuint buffer = 0;
+	char* mapped = nullptr;
+
+	size_t slotSize = 0;
+	int slot = 0;
+	size_t used = 0;
+
+	// False when the frame found its slot still in use by the GPU and stages nothing
+	bool slotAvailable = false;
+
+	GLsync fences[UPLOAD_RING_SLOTS] = {};
+
+	// Without GL 4.4 buffer storage, uploads fall back to glBufferSubData
+	bool persistent = false;
+};
+
+void initUploadRing(UploadRing& ring, size_t slotSize);
+void destroyUploadRing(UploadRing& ring);
+
+// Dirty spans are merged with this gap before staging
+const size_t UPLOAD_MAX_GAP = 256;
+
+// Slot bytes the dirty spans take once staged. Merges them.
+size_t stagedBytes(DirtySpans& dirty);
+
+// Moves to the next slot if the GPU is done with it, growing the ring first when bytes, the
+// whole batch of the frame, would not fit a slot. Returns false when the slot is still in use,
+// in which case nothing may be staged this frame.
+bool beginUploadFrame(UploadRing& ring, size_t bytes);
+
+// Fences the slot once all the copies of the frame are issued
+void endUploadFrame(UploadRing& ring);
+
+// Stages size bytes for dst at dstOffset, beginUploadFrame() must have allowed for them
+void stageUpload(UploadRing& ring, GLuint dst, size_t dstOffset, const void* data, size_t size);
+
+// Stages the dirty ranges of data for dst at baseOffset and forgets them
+void stageDirtySpans(UploadRing& ring, GLuint dst, size_t baseOffset, const void* data, DirtySpans& dirty);
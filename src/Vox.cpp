@@ -0,0 +1,387 @@
+#include "Vox.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+#include "WorldFile.h"
+
+// Voxels read per block while streaming a model
+const uint32_t VOX_BLOCK_VOXELS = 4096;
+
+static uint32_t chunkId(const char* id) {
+	return (uint32_t)id[0] | ((uint32_t)id[1] << 8) | ((uint32_t)id[2] << 16) | ((uint32_t)id[3] << 24);
+}
+
+// Reader over the content of one chunk, which is small for every chunk it is used on
+struct VoxContent {
+	std::vector<char> bytes;
+	size_t position = 0;
+	bool ok = true;
+};
+
+static int32_t readInt(VoxContent& content) {
+	int32_t value = 0;
+	if (content.position + 4 > content.bytes.size()) {
+		content.ok = false;
+		return 0;
+	}
+	memcpy(&value, content.bytes.data() + content.position, 4);
+	content.position += 4;
+	return value;
+}
+
+static std::string readString(VoxContent& content) {
+	const int32_t length = readInt(content);
+	if (length < 0 || content.position + length > content.bytes.size()) {
+		content.ok = false;
+		return std::string();
+	}
+	std::string value(content.bytes.data() + content.position, length);
+	content.position += length;
+	return value;
+}
+
+static std::map<std::string, std::string> readDict(VoxContent& content) {
+	std::map<std::string, std::string> dict;
+	const int32_t pairs = readInt(content);
+	for (int32_t i = 0; i < pairs && content.ok; i++) {
+		std::string key = readString(content);
+		dict[key] = readString(content);
+	}
+	return dict;
+}
+
+// Scene graph nodes, only what placing the models needs
+struct VoxNode {
+	// Ids that no node of the file uses are left as empty groups
+	enum { TRANSFORM, GROUP, SHAPE } type = GROUP;
+	std::vector<int> children;
+	glm::ivec3 translation = glm::ivec3(0);
+	uint8_t rotation = 0x04;	// identity
+	int layer = -1;
+	bool hidden = false;
+};
+
+// Default MagicaVoxel palette for files without an RGBA chunk: the 6x6x6 cube of multiples of
+// 0x33 without black, then ramps of red, green, blue and grey over the other levels
+static void defaultVoxPalette(glm::vec4 palette[PALETTE_SIZE]) {
+	int index = 1;
+	for (int r = 5; r >= 0; r--) {
+		for (int g = 5; g >= 0; g--) {
+			for (int b = 5; b >= 0; b--) {
+				if (r == 0 && g == 0 && b == 0) continue;
+				palette[index++] = glm::vec4(r * 0.2f, g * 0.2f, b * 0.2f, 0.0f);
+			}
+		}
+	}
+
+	for (int ramp = 0; ramp < 4; ramp++) {
+		for (int level = 0xEE; level > 0; level -= 0x11) {
+			if (level % 0x33 == 0) continue;
+			const float v = level / 255.0f;
+			palette[index++] = ramp == 3 ? glm::vec4(v, v, v, 0.0f) : glm::vec4(ramp == 0 ? v : 0.0f, ramp == 1 ? v : 0.0f, ramp == 2 ? v : 0.0f, 0.0f);
+		}
+	}
+}
+
+static void decodeRotation(uint8_t rotation, glm::ivec3& axis, glm::ivec3& sign) {
+	axis.x = rotation & 3;
+	axis.y = (rotation >> 2) & 3;
+	axis.z = 3 - axis.x - axis.y;
+	sign = glm::ivec3((rotation & 0x10) ? -1 : 1, (rotation & 0x20) ? -1 : 1, (rotation & 0x40) ? -1 : 1);
+}
+
+// Position of a model voxel in the MagicaVoxel world (z up), rotated about the model centre
+static glm::ivec3 voxWorldPosition(const VoxInstance& instance, const VoxModel& model, glm::ivec3 voxel) {
+	const glm::ivec3 centred = voxel - model.size / 2;
+	glm::ivec3 rotated;
+	for (int r = 0; r < 3; r++) rotated[r] = instance.sign[r] * centred[instance.axis[r]];
+	return rotated + instance.translation;
+}
+
+// MagicaVoxel axes to the renderer ones: z up becomes y up, y is mirrored to keep handedness
+static glm::ivec3 toRendererAxes(glm::ivec3 p) {
+	return glm::ivec3(p.x, p.z, -p.y);
+}
+
+// Bounds of an instance in the renderer axes, from the corners of its model
+static void instanceBounds(const VoxScene& scene, const VoxInstance& instance, glm::ivec3& min, glm::ivec3& max) {
+	const VoxModel& model = scene.models[instance.model];
+	min = glm::ivec3(INT32_MAX);
+	max = glm::ivec3(INT32_MIN);
+	for (int corner = 0; corner < 8; corner++) {
+		const glm::ivec3 voxel((corner & 1) ? model.size.x - 1 : 0, (corner & 2) ? model.size.y - 1 : 0, (corner & 4) ? model.size.z - 1 : 0);
+		const glm::ivec3 p = toRendererAxes(voxWorldPosition(instance, model, voxel));
+		min = glm::min(min, p);
+		max = glm::max(max, p);
+	}
+}
+
+static void collectInstances(VoxScene& scene, const std::vector<VoxNode>& nodes, const std::vector<bool>& hiddenLayers, int node, glm::ivec3 axis, glm::ivec3 sign, glm::ivec3 translation, int depth) {
+	if (node < 0 || node >= (int)nodes.size() || depth > 64) return;
+	const VoxNode& n = nodes[node];
+
+	if (n.type == VoxNode::TRANSFORM) {
+		if (n.hidden || (n.layer >= 0 && n.layer < (int)hiddenLayers.size() && hiddenLayers[n.layer])) return;
+
+		// Compose the parent transform with this one
+		glm::ivec3 localAxis, localSign;
+		decodeRotation(n.rotation, localAxis, localSign);
+		glm::ivec3 childAxis, childSign, offset;
+		for (int r = 0; r < 3; r++) {
+			childAxis[r] = localAxis[axis[r]];
+			childSign[r] = sign[r] * localSign[axis[r]];
+			offset[r] = sign[r] * n.translation[axis[r]];
+		}
+		for (int child : n.children) collectInstances(scene, nodes, hiddenLayers, child, childAxis, childSign, translation + offset, depth + 1);
+	} else if (n.type == VoxNode::GROUP) {
+		for (int child : n.children) collectInstances(scene, nodes, hiddenLayers, child, axis, sign, translation, depth + 1);
+	} else {
+		for (int model : n.children) {
+			if (model >= 0 && model < (int)scene.models.size()) scene.instances.push_back({ model, axis, sign, translation });
+		}
+	}
+}
+
+bool openVox(VoxScene& scene, const std::string& path) {
+	std::ifstream file(path, std::ios::binary);
+	char magic[4];
+	int32_t version;
+	if (!file || !file.read(magic, 4) || memcmp(magic, "VOX ", 4) != 0 || !file.read((char*)&version, 4)) {
+		std::cerr << "Not a MagicaVoxel file: " << path << std::endl;
+		return false;
+	}
+
+	scene = VoxScene();
+	scene.path = path;
+	std::fill(scene.palette, scene.palette + PALETTE_SIZE, glm::vec4(0.0f));
+	defaultVoxPalette(scene.palette);
+
+	std::vector<VoxNode> nodes;
+	std::vector<bool> hiddenLayers;
+	glm::ivec3 pendingSize(-1);
+
+	// MAIN holds every other chunk as its children, which are walked one header at a time
+	char id[4];
+	int32_t sizes[2];
+	while (file.read(id, 4) && file.read((char*)sizes, 8)) {
+		const uint32_t type = chunkId(id);
+		const std::streamoff contentStart = file.tellg();
+		if (sizes[0] < 0 || sizes[1] < 0) break;
+		if (type == chunkId("MAIN")) continue;
+
+		if (type == chunkId("XYZI")) {
+			uint32_t count = 0;
+			file.read((char*)&count, 4);
+			if (pendingSize.x >= 0) scene.models.push_back({ pendingSize, contentStart + 4, count });
+			pendingSize = glm::ivec3(-1);
+		} else if (type == chunkId("SIZE") || type == chunkId("RGBA") || type == chunkId("nTRN") || type == chunkId("nGRP")
+			|| type == chunkId("nSHP") || type == chunkId("MATL") || type == chunkId("LAYR")) {
+			VoxContent content;
+			content.bytes.resize(sizes[0]);
+			if (!file.read(content.bytes.data(), sizes[0])) break;
+
+			if (type == chunkId("SIZE")) {
+				pendingSize.x = readInt(content);
+				pendingSize.y = readInt(content);
+				pendingSize.z = readInt(content);
+			} else if (type == chunkId("RGBA")) {
+				// Entry i is the colour of index i + 1
+				for (int i = 0; i + 1 < PALETTE_SIZE && (size_t)(i + 1) * 4 <= content.bytes.size(); i++) {
+					const uint8_t* rgba = (const uint8_t*)content.bytes.data() + i * 4;
+					scene.palette[i + 1] = glm::vec4(rgba[0] / 255.0f, rgba[1] / 255.0f, rgba[2] / 255.0f, 0.0f);
+				}
+			} else if (type == chunkId("MATL")) {
+				const int32_t index = readInt(content);
+				std::map<std::string, std::string> dict = readDict(content);
+				if (content.ok && index > 0 && index < PALETTE_SIZE && dict["_type"] == "_emit") {
+					// Same strength as the generator's glowstone at full emission
+					scene.palette[index].w = 2.0f * (float)atof(dict["_emit"].c_str());
+				}
+			} else if (type == chunkId("LAYR")) {
+				const int32_t layer = readInt(content);
+				std::map<std::string, std::string> dict = readDict(content);
+				if (content.ok && layer >= 0 && layer < 4096) {
+					if ((int)hiddenLayers.size() <= layer) hiddenLayers.resize(layer + 1, false);
+					hiddenLayers[layer] = dict["_hidden"] == "1";
+				}
+			} else {
+				VoxNode node;
+				const int32_t nodeId = readInt(content);
+				std::map<std::string, std::string> attributes = readDict(content);
+				node.hidden = attributes["_hidden"] == "1";
+
+				if (type == chunkId("nTRN")) {
+					node.type = VoxNode::TRANSFORM;
+					node.children.push_back(readInt(content));
+					readInt(content);	// reserved
+					node.layer = readInt(content);
+					const int32_t frames = readInt(content);
+					if (frames > 0) {
+						std::map<std::string, std::string> frame = readDict(content);
+						if (!frame["_r"].empty()) node.rotation = (uint8_t)atoi(frame["_r"].c_str());
+						if (!frame["_t"].empty()) sscanf(frame["_t"].c_str(), "%d %d %d", &node.translation.x, &node.translation.y, &node.translation.z);
+					}
+				} else if (type == chunkId("nGRP")) {
+					node.type = VoxNode::GROUP;
+					const int32_t children = readInt(content);
+					for (int32_t i = 0; i < children && content.ok; i++) node.children.push_back(readInt(content));
+				} else {
+					node.type = VoxNode::SHAPE;
+					const int32_t models = readInt(content);
+					for (int32_t i = 0; i < models && content.ok; i++) {
+						node.children.push_back(readInt(content));
+						readDict(content);
+					}
+				}
+
+				if (content.ok && nodeId >= 0 && nodeId < (1 << 20)) {
+					if ((int)nodes.size() <= nodeId) nodes.resize(nodeId + 1);
+					nodes[nodeId] = node;
+				}
+			}
+		}
+
+		file.seekg(contentStart + sizes[0] + sizes[1]);
+	}
+
+	if (scene.models.empty()) {
+		std::cerr << "No models in " << path << std::endl;
+		return false;
+	}
+
+	// Without a scene graph, every model sits at the origin
+	if (nodes.empty()) {
+		for (int i = 0; i < (int)scene.models.size(); i++) scene.instances.push_back({ i, glm::ivec3(0, 1, 2), glm::ivec3(1), scene.models[i].size / 2 });
+	} else {
+		collectInstances(scene, nodes, hiddenLayers, 0, glm::ivec3(0, 1, 2), glm::ivec3(1), glm::ivec3(0), 0);
+	}
+	if (scene.instances.empty()) {
+		std::cerr << "No visible models in " << path << std::endl;
+		return false;
+	}
+
+	glm::ivec3 min(INT32_MAX), max(INT32_MIN);
+	for (const VoxInstance& instance : scene.instances) {
+		glm::ivec3 instanceMin, instanceMax;
+		instanceBounds(scene, instance, instanceMin, instanceMax);
+		min = glm::min(min, instanceMin);
+		max = glm::max(max, instanceMax);
+	}
+	scene.min = min;
+	scene.size = max - min + 1;
+	return true;
+}
+
+bool readVoxVoxels(const VoxScene& scene, const std::function<void(int x, int y, int z, uint8_t id)>& voxel) {
+	std::vector<int> instances(scene.instances.size());
+	for (int i = 0; i < (int)instances.size(); i++) instances[i] = i;
+	return readVoxVoxels(scene, instances, voxel);
+}
+
+bool readVoxVoxels(const VoxScene& scene, const std::vector<int>& instances, const std::function<void(int x, int y, int z, uint8_t id)>& voxel) {
+	std::ifstream file(scene.path, std::ios::binary);
+	if (!file) {
+		std::cerr << "Failed to open " << scene.path << std::endl;
+		return false;
+	}
+
+	std::vector<uint8_t> block(VOX_BLOCK_VOXELS * 4);
+	for (int index : instances) {
+		const VoxInstance& instance = scene.instances[index];
+		const VoxModel& model = scene.models[instance.model];
+		file.seekg(model.voxelsOffset);
+
+		for (uint32_t first = 0; first < model.voxelCount; first += VOX_BLOCK_VOXELS) {
+			const uint32_t count = std::min(VOX_BLOCK_VOXELS, model.voxelCount - first);
+			if (!file.read((char*)block.data(), count * 4)) {
+				std::cerr << "Truncated MagicaVoxel file: " << scene.path << std::endl;
+				return false;
+			}
+
+			for (uint32_t i = 0; i < count; i++) {
+				const uint8_t* v = block.data() + i * 4;
+				if (v[3] == 0) continue;
+				const glm::ivec3 p = toRendererAxes(voxWorldPosition(instance, model, glm::ivec3(v[0], v[1], v[2]))) - scene.min;
+				voxel(p.x, p.y, p.z, v[3]);
+			}
+		}
+	}
+	return true;
+}
+
+bool loadVox(VoxelGrid& grid, const VoxScene& scene, glm::ivec3 offset) {
+	if (grid.bitsPerVoxel < 8) {
+		std::cerr << "MagicaVoxel scenes need at least 8 bits per voxel" << std::endl;
+		return false;
+	}
+
+	return readVoxVoxels(scene, [&](int x, int y, int z, uint8_t id) {
+		const glm::ivec3 p = glm::ivec3(x, y, z) + offset;
+		if (glm::all(glm::greaterThanEqual(p, glm::ivec3(0))) && glm::all(glm::lessThan(p, glm::ivec3(grid.width, grid.height, grid.depth)))) {
+			writeVoxel(grid, p.x, p.y, p.z, id);
+		}
+	});
+}
+
+// Voxels of the chunks of a slab, position in the chunk << 8 | id, and how many of its chunks
+// are still to be packed
+struct VoxSlab {
+	std::vector<std::vector<uint32_t>> chunks;
+	int remaining;
+};
+
+bool writeVoxWorldFile(const std::string& path, const VoxScene& scene, ThreadPool& pool) {
+	const glm::ivec3 dims = (scene.size + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+	// Only a slab of chunks along z is held at a time rather than the whole scene: the slab is
+	// read from the instances that reach into it when its first chunk is packed, and freed once
+	// its last one is. The chunks are packed in directory order, z slowest.
+	std::vector<std::vector<int>> slabInstances(dims.z);
+	for (int i = 0; i < (int)scene.instances.size(); i++) {
+		glm::ivec3 min, max;
+		instanceBounds(scene, scene.instances[i], min, max);
+		const int first = std::max((min.z - scene.min.z) / CHUNK_SIZE, 0);
+		const int last = std::min((max.z - scene.min.z) / CHUNK_SIZE, dims.z - 1);
+		for (int z = first; z <= last; z++) slabInstances[z].push_back(i);
+	}
+
+	std::mutex mutex;
+	std::map<int, VoxSlab> slabs;
+	bool read = true;
+
+	const bool written = writeWorldFile(path, glm::ivec3(0), dims, 0, [&](glm::ivec3 chunk, std::vector<uint8_t>& ids) {
+		ids.assign(CHUNK_VOXELS, 0);
+
+		VoxSlab* slab;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto found = slabs.find(chunk.z);
+			if (found == slabs.end()) {
+				found = slabs.emplace(chunk.z, VoxSlab{ std::vector<std::vector<uint32_t>>((size_t)dims.x * dims.y), dims.x * dims.y }).first;
+				VoxSlab& loaded = found->second;
+				const int z0 = chunk.z * CHUNK_SIZE;
+				read = readVoxVoxels(scene, slabInstances[chunk.z], [&](int x, int y, int z, uint8_t id) {
+					if (z < z0 || z >= z0 + CHUNK_SIZE || glm::any(glm::lessThan(glm::ivec3(x, y, z), glm::ivec3(0))) || glm::any(glm::greaterThanEqual(glm::ivec3(x, y, z), scene.size))) return;
+					const glm::ivec3 local = glm::ivec3(x % CHUNK_SIZE, y % CHUNK_SIZE, z - z0);
+					loaded.chunks[x / CHUNK_SIZE + (size_t)dims.x * (y / CHUNK_SIZE)].push_back((uint32_t)(local.x + CHUNK_SIZE * (local.y + CHUNK_SIZE * local.z)) << 8 | id);
+				}) && read;
+			}
+			slab = &found->second;
+		}
+
+		for (uint32_t voxel : slab->chunks[chunk.x + (size_t)dims.x * chunk.y]) ids[voxel >> 8] = (uint8_t)(voxel & 0xFFu);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (--slab->remaining == 0) slabs.erase(chunk.z);
+	}, pool, scene.palette);
+
+	if (written && !read) std::remove(path.c_str());
+	return written && read;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <ios>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ThreadPool.h"
+#include "VoxelGrid.h"
+
+// MagicaVoxel .vox scenes. openVox() reads everything but the voxels: palette, materials, and
+// the scene graph, which places every model, possibly rotated, possibly more than once. Models
+// are only located in the file, readVoxVoxels() then streams the voxels of every instance in
+// small blocks, so no part of the file is ever held in memory as a whole.
+struct VoxModel {
+	glm::ivec3 size;
+	std::streamoff voxelsOffset;
+	uint32_t voxelCount;
+};
+
+struct VoxInstance {
+	int model;
+	// Rotation as a signed permutation: row r of the matrix is sign[r] in column axis[r]
+	glm::ivec3 axis;
+	glm::ivec3 sign;
+	glm::ivec3 translation;
+};
+
+struct VoxScene {
+	std::string path;
+	std::vector<VoxModel> models;
+	std::vector<VoxInstance> instances;
+
+	// Bounds of all the instances, in the renderer axes (y up)
+	glm::ivec3 min;
+	glm::ivec3 size;
+
+	// Colour index c of the file is voxel id c, w is the emission of _emit materials
+	glm::vec4 palette[PALETTE_SIZE];
+};
+
+bool openVox(VoxScene& scene, const std::string& path);
+
+// Calls voxel for every voxel of every instance, coordinates in [0, scene.size)
+bool readVoxVoxels(const VoxScene& scene, const std::function<void(int x, int y, int z, uint8_t id)>& voxel);
+// Same for the listed instances only
+bool readVoxVoxels(const VoxScene& scene, const std::vector<int>& instances, const std::function<void(int x, int y, int z, uint8_t id)>& voxel);
+
+// Writes the scene into the grid with its minimum corner at offset, bypassing the dirty tracking
+bool loadVox(VoxelGrid& grid, const VoxScene& scene, glm::ivec3 offset);
+
+// Scenes larger than the grid go into chunks: the voxels are sorted into the chunks they fall
+// in, one slab of chunks along z at a time, then packed into a world file covering the scene
+// with its palette, to open with openWorldFile()
+bool writeVoxWorldFile(const std::string& path, const VoxScene& scene, ThreadPool& pool);
@@ -0,0 +1,285 @@
+#include "VoxelEdit.h"
+
+#include <algorithm>
+#include <cmath>
+
+static uint32_t voxelMask(const VoxelGrid& grid) {
+	return grid.bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << grid.bitsPerVoxel) - 1u;
+}
+
+// The id repeated in every voxel of a word
+static uint32_t lanePattern(const VoxelGrid& grid, uint32_t id) {
+	const uint32_t mask = voxelMask(grid);
+	return (id & mask) * (0xFFFFFFFFu / mask);
+}
+
+// All the bits of the voxels of the word that are 0, without looking at the voxels one by one:
+// adding 0111..1 to the low bits of a voxel sets its top bit unless they are all 0
+static uint32_t zeroVoxels(const VoxelGrid& grid, uint32_t word) {
+	if (grid.bitsPerVoxel == 32) return word == 0u ? 0xFFFFFFFFu : 0u;
+
+	const uint32_t low = lanePattern(grid, (1u << (grid.bitsPerVoxel - 1)) - 1u);
+	const uint32_t high = lanePattern(grid, 1u << (grid.bitsPerVoxel - 1));
+	const uint32_t top = ~(((word & low) + low) | word | low) & high;
+	return (top >> (grid.bitsPerVoxel - 1)) * voxelMask(grid);
+}
+
+// How a run of voxels is written: every voxel takes the id of toPattern, or with replace only
+// those holding the id of fromPattern
+struct RunWrite {
+	uint32_t toPattern;
+	uint32_t fromPattern;
+	bool replace;
+};
+
+// Writes the voxels [first, first + count) in index order a whole word at a time, those being
+// contiguous in grid.words. Returns whether any voxel changed.
+static bool writeRun(VoxelGrid& grid, size_t first, size_t count, const RunWrite& write) {
+	const size_t voxelsPerWord = 32 / grid.bitsPerVoxel;
+	const size_t end = first + count;
+	bool changed = false;
+
+	for (size_t index = first; index < end;) {
+		const size_t wordIndex = index / voxelsPerWord;
+		const size_t lane = index % voxelsPerWord;
+		const size_t lanes = std::min(voxelsPerWord - lane, end - index);
+		const uint32_t covered = lanes == voxelsPerWord ? 0xFFFFFFFFu : ((1u << (lanes * grid.bitsPerVoxel)) - 1u) << (lane * grid.bitsPerVoxel);
+
+		uint32_t& word = grid.words[wordIndex];
+		const uint32_t mask = write.replace ? covered & zeroVoxels(grid, word ^ write.fromPattern) : covered;
+		const uint32_t newWord = (word & ~mask) | (write.toPattern & mask);
+		if (newWord != word) {
+			word = newWord;
+			markDirty(grid.dirty, wordIndex * sizeof(uint32_t), sizeof(uint32_t));
+			changed = true;
+		}
+		index += lanes;
+	}
+	return changed;
+}
+
+// Writes the voxels of a shape clipped to the grid. row(y, z, x0, x1) gives the span of the
+// shape in a row of voxels, and returns false if the row misses it; coversTile(min, max) tells
+// whether a box of voxels is entirely in the shape. Rows are single runs in the linear layout,
+// in the Morton layout whole tiles are, and the voxels of partially covered tiles are written
+// one by one.
+template <typename Row, typename CoversTile>
+static bool writeShape(VoxelGrid& grid, VoxelBox bounds, const RunWrite& write, const Row& row, const CoversTile& coversTile) {
+	bounds.min = glm::max(bounds.min, glm::ivec3(0));
+	bounds.max = glm::min(bounds.max, glm::ivec3(grid.width, grid.height, grid.depth) - 1);
+	if (glm::any(glm::greaterThan(bounds.min, bounds.max))) return false;
+
+	bool changed = false;
+	if (grid.layout == VOXEL_LAYOUT_LINEAR) {
+		for (int z = bounds.min.z; z <= bounds.max.z; z++) {
+			for (int y = bounds.min.y; y <= bounds.max.y; y++) {
+				int x0, x1;
+				if (!row(y, z, x0, x1)) continue;
+				x0 = std::max(x0, bounds.min.x);
+				x1 = std::min(x1, bounds.max.x);
+				if (x0 <= x1) changed |= writeRun(grid, voxelIndex(grid, x0, y, z), x1 - x0 + 1, write);
+			}
+		}
+		return changed;
+	}
+
+	const glm::ivec3 firstTile = bounds.min / VOXEL_TILE_SIZE;
+	const glm::ivec3 lastTile = bounds.max / VOXEL_TILE_SIZE;
+	const int tileVoxels = VOXEL_TILE_SIZE * VOXEL_TILE_SIZE * VOXEL_TILE_SIZE;
+	for (int tz = firstTile.z; tz <= lastTile.z; tz++) {
+		for (int ty = firstTile.y; ty <= lastTile.y; ty++) {
+			for (int tx = firstTile.x; tx <= lastTile.x; tx++) {
+				const glm::ivec3 tileMin = glm::ivec3(tx, ty, tz) * VOXEL_TILE_SIZE;
+				const glm::ivec3 tileMax = tileMin + VOXEL_TILE_SIZE - 1;
+				if (glm::all(glm::greaterThanEqual(tileMin, bounds.min)) && glm::all(glm::lessThanEqual(tileMax, bounds.max)) && coversTile(tileMin, tileMax)) {
+					changed |= writeRun(grid, voxelIndex(grid, tileMin.x, tileMin.y, tileMin.z), tileVoxels, write);
+					continue;
+				}
+
+				const glm::ivec3 lo = glm::max(tileMin, bounds.min);
+				const glm::ivec3 hi = glm::min(tileMax, bounds.max);
+				for (int z = lo.z; z <= hi.z; z++) {
+					for (int y = lo.y; y <= hi.y; y++) {
+						int x0, x1;
+						if (!row(y, z, x0, x1)) continue;
+						for (int x = std::max(x0, lo.x); x <= std::min(x1, hi.x); x++) {
+							changed |= writeRun(grid, voxelIndex(grid, x, y, z), 1, write);
+						}
+					}
+				}
+			}
+		}
+	}
+	return changed;
+}
+
+static bool applyEdit(VoxelGrid& grid, const EditQueue& queue, const VoxelEdit& edit) {
+	RunWrite write = { lanePattern(grid, edit.id), lanePattern(grid, edit.from), edit.kind == EDIT_REPLACE };
+
+	if (edit.kind == EDIT_FILL_BOX || edit.kind == EDIT_REPLACE) {
+		auto row = [&](int, int, int& x0, int& x1) {
+			x0 = edit.bounds.min.x;
+			x1 = edit.bounds.max.x;
+			return true;
+		};
+		return writeShape(grid, edit.bounds, write, row, [](glm::ivec3, glm::ivec3) { return true; });
+	}
+
+	if (edit.kind == EDIT_FILL_SPHERE) {
+		const float radius2 = edit.radius * edit.radius;
+		auto inside = [&](glm::ivec3 voxel) {
+			const glm::vec3 d = glm::vec3(voxel) + 0.5f - edit.centre;
+			return glm::dot(d, d) <= radius2;
+		};
+		auto row = [&](int y, int z, int& x0, int& x1) {
+			const float dy = y + 0.5f - edit.centre.y;
+			const float dz = z + 0.5f - edit.centre.z;
+			const float dx2 = radius2 - dy * dy - dz * dz;
+			if (dx2 < 0.0f) return false;
+			const float dx = std::sqrt(dx2);
+			x0 = (int)std::ceil(edit.centre.x - 0.5f - dx);
+			x1 = (int)std::floor(edit.centre.x - 0.5f + dx);
+			return x0 <= x1;
+		};
+		// The sphere is convex, a box is in it when its corners are
+		auto coversTile = [&](glm::ivec3 min, glm::ivec3 max) {
+			for (int i = 0; i < 8; i++) {
+				if (!inside(glm::ivec3(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z))) return false;
+			}
+			return true;
+		};
+		return writeShape(grid, edit.bounds, write, row, coversTile);
+	}
+
+	// Pasted voxels all differ, they are written one at a time
+	const VoxelRegion& region = queue.regions[edit.region];
+	bool changed = false;
+	for (int z = 0; z < region.size.z; z++) {
+		for (int y = 0; y < region.size.y; y++) {
+			for (int x = 0; x < region.size.x; x++) {
+				const glm::ivec3 voxel = edit.bounds.min + glm::ivec3(x, y, z);
+				if (glm::any(glm::lessThan(voxel, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(voxel, glm::ivec3(grid.width, grid.height, grid.depth)))) continue;
+
+				const uint32_t id = region.ids[x + (size_t)region.size.x * (y + (size_t)region.size.y * z)];
+				if (id == 0u && !edit.pasteAir) continue;
+				write.toPattern = lanePattern(grid, id);
+				changed |= writeRun(grid, voxelIndex(grid, voxel.x, voxel.y, voxel.z), 1, write);
+			}
+		}
+	}
+	return changed;
+}
+
+static VoxelEdit makeEdit(VoxelEditKind kind, glm::ivec3 min, glm::ivec3 max, uint32_t id) {
+	VoxelEdit edit = {};
+	edit.kind = kind;
+	edit.bounds = { glm::min(min, max), glm::max(min, max) };
+	edit.id = id;
+	return edit;
+}
+
+void queueSetVoxel(EditQueue& queue, glm::ivec3 voxel, uint32_t id) {
+	queue.edits.push_back(makeEdit(EDIT_FILL_BOX, voxel, voxel, id));
+}
+
+void queueFillBox(EditQueue& queue, glm::ivec3 min, glm::ivec3 max, uint32_t id) {
+	queue.edits.push_back(makeEdit(EDIT_FILL_BOX, min, max, id));
+}
+
+void queueFillSphere(EditQueue& queue, glm::vec3 centre, float radius, uint32_t id) {
+	VoxelEdit edit = makeEdit(EDIT_FILL_SPHERE, glm::ivec3(glm::floor(centre - radius)), glm::ivec3(glm::floor(centre + radius)), id);
+	edit.centre = centre;
+	edit.radius = radius;
+	queue.edits.push_back(edit);
+}
+
+void queueReplace(EditQueue& queue, glm::ivec3 min, glm::ivec3 max, uint32_t from, uint32_t to) {
+	VoxelEdit edit = makeEdit(EDIT_REPLACE, min, max, to);
+	edit.from = from;
+	queue.edits.push_back(edit);
+}
+
+void queuePaste(EditQueue& queue, const VoxelRegion& region, glm::ivec3 min, bool pasteAir) {
+	if (glm::any(glm::lessThanEqual(region.size, glm::ivec3(0)))) return;
+
+	VoxelEdit edit = makeEdit(EDIT_PASTE, min, min + region.size - 1, 0);
+	edit.region = (int)queue.regions.size();
+	edit.pasteAir = pasteAir;
+	queue.regions.push_back(region);
+	queue.edits.push_back(edit);
+}
+
+void copyRegion(const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max, VoxelRegion& region) {
+	const glm::ivec3 lo = glm::min(min, max);
+	region.size = glm::max(min, max) - lo + 1;
+	region.ids.resize((size_t)region.size.x * region.size.y * region.size.z);
+
+	size_t i = 0;
+	for (int z = 0; z < region.size.z; z++) {
+		for (int y = 0; y < region.size.y; y++) {
+			for (int x = 0; x < region.size.x; x++) {
+				region.ids[i++] = getVoxel(grid, lo.x + x, lo.y + y, lo.z + z);
+			}
+		}
+	}
+}
+
+bool hasQueuedEdits(const EditQueue& queue) {
+	return !queue.edits.empty();
+}
+
+static bool boxesTouch(const VoxelBox& a, const VoxelBox& b) {
+	return glm::all(glm::lessThanEqual(a.min, b.max + 1)) && glm::all(glm::lessThanEqual(b.min, a.max + 1));
+}
+
+std::vector<VoxelBox> commitEdits(EditQueue& queue, VoxelGrid& grid) {
+	std::vector<VoxelBox> boxes;
+
+	for (const VoxelEdit& edit : queue.edits) {
+		if (!applyEdit(grid, queue, edit)) continue;
+
+		VoxelBox box = { glm::max(edit.bounds.min, glm::ivec3(0)), glm::min(edit.bounds.max, glm::ivec3(grid.width, grid.height, grid.depth) - 1) };
+		grid.dirtyMin = glm::min(grid.dirtyMin, box.min);
+		grid.dirtyMax = glm::max(grid.dirtyMax, box.max);
+
+		// Growing the box can make it reach boxes it missed, so merging starts over after each one
+		for (size_t i = 0; i < boxes.size();) {
+			if (!boxesTouch(boxes[i], box)) {
+				i++;
+				continue;
+			}
+			box = { glm::min(box.min, boxes[i].min), glm::max(box.max, boxes[i].max) };
+			boxes[i] = boxes.back();
+			boxes.pop_back();
+			i = 0;
+		}
+		boxes.push_back(box);
+	}
+
+	queue.edits.clear();
+	queue.regions.clear();
+	return boxes;
+}
+
+bool raycastGrid(const VoxelGrid& grid, glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3& hit, glm::ivec3& before) {
+	glm::ivec3 cell = glm::ivec3(glm::floor(origin));
+	const glm::ivec3 step = glm::ivec3(glm::sign(direction));
+	const glm::vec3 delta = glm::abs(1.0f / direction);
+	glm::vec3 sideDist = (glm::vec3(cell) + glm::max(glm::vec3(step), glm::vec3(0)) - origin) / direction;
+
+	float t = 0.0f;
+	before = cell;
+	while (t <= maxDistance) {
+		if (getVoxel(grid, cell.x, cell.y, cell.z) != 0u) {
+			hit = cell;
+			return true;
+		}
+
+		before = cell;
+		const int axis = sideDist.x < sideDist.y && sideDist.x < sideDist.z ? 0 : (sideDist.y < sideDist.z ? 1 : 2);
+		t = sideDist[axis];
+		sideDist[axis] += delta[axis];
+		cell[axis] += step[axis];
+	}
+	return false;
+}
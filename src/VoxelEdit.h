@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VoxelGrid.h"
+
+// Edits of the grid are queued as they come and committed together once per frame. A commit
+// applies the edits in order and returns the boxes they changed, overlapping and touching
+// boxes merged, so the derived structures are recomputed once per box and the changed words
+// go up in one upload instead of one per edit.
+
+// Voxels from min to max, both included
+struct VoxelBox {
+	glm::ivec3 min;
+	glm::ivec3 max;
+};
+
+// A copied block of voxels, x-fastest
+struct VoxelRegion {
+	glm::ivec3 size = glm::ivec3(0);
+	std::vector<uint32_t> ids;
+};
+
+enum VoxelEditKind {
+	EDIT_FILL_BOX,
+	EDIT_FILL_SPHERE,
+	EDIT_REPLACE,
+	EDIT_PASTE
+};
+
+struct VoxelEdit {
+	VoxelEditKind kind;
+	// Every voxel the edit can touch
+	VoxelBox bounds;
+	uint32_t id;
+
+	// EDIT_REPLACE: only voxels holding this id are written
+	uint32_t from;
+
+	// EDIT_FILL_SPHERE: voxels whose centre is within radius of centre
+	glm::vec3 centre;
+	float radius;
+
+	// EDIT_PASTE: index in EditQueue::regions, and whether air overwrites the grid
+	int region;
+	bool pasteAir;
+};
+
+struct EditQueue {
+	std::vector<VoxelEdit> edits;
+	// Copies of the regions queued for pasting
+	std::vector<VoxelRegion> regions;
+};
+
+void queueSetVoxel(EditQueue& queue, glm::ivec3 voxel, uint32_t id);
+void queueFillBox(EditQueue& queue, glm::ivec3 min, glm::ivec3 max, uint32_t id);
+void queueFillSphere(EditQueue& queue, glm::vec3 centre, float radius, uint32_t id);
+// Writes to inside [min, max] every voxel that holds from
+void queueReplace(EditQueue& queue, glm::ivec3 min, glm::ivec3 max, uint32_t from, uint32_t to);
+// Pastes the region with its minimum corner at min. Air in the region leaves the grid as it is
+// unless pasteAir is set.
+void queuePaste(EditQueue& queue, const VoxelRegion& region, glm::ivec3 min, bool pasteAir = false);
+
+// Copies [min, max] as the grid is now, before the queued edits. Voxels outside the grid are air.
+void copyRegion(const VoxelGrid& grid, glm::ivec3 min, glm::ivec3 max, VoxelRegion& region);
+
+bool hasQueuedEdits(const EditQueue& queue);
+
+// Applies and forgets the queued edits. Changed words are marked in grid.dirty, and the returned
+// boxes cover every changed voxel. Boxes of edits that changed nothing are left out.
+std::vector<VoxelBox> commitEdits(EditQueue& queue, VoxelGrid& grid);
+
+// First solid voxel along the ray within maxDistance, and the cell the ray came from, which is
+// where a brush adds voxels against the surface
+bool raycastGrid(const VoxelGrid& grid, glm::vec3 origin, glm::vec3 direction, float maxDistance, glm::ivec3& hit, glm::ivec3& before);
@@ -0,0 +1,137 @@
+#include "VoxelGrid.h"
+
+#include <iostream>
+
+static int log2IfPowerOfTwo(int value) {
+	if (value <= 0 || (value & (value - 1)) != 0) return -1;
+
+	int shift = 0;
+	while ((1 << shift) < value) shift++;
+	return shift;
+}
+
+// Spreads the 3 low bits of v so that they land on every third bit
+static uint32_t spreadBits3(uint32_t v) {
+	return (v & 1u) | ((v & 2u) << 2) | ((v & 4u) << 4);
+}
+
+bool initVoxelGrid(VoxelGrid& grid, int width, int height, int depth, int bitsPerVoxel, int layout) {
+	if (bitsPerVoxel != 1 && bitsPerVoxel != 2 && bitsPerVoxel != 4 && bitsPerVoxel != 8 && bitsPerVoxel != 16 && bitsPerVoxel != 32) {
+		std::cerr << "Unsupported voxel bit width: " << bitsPerVoxel << std::endl;
+		return false;
+	}
+	if (width <= 0 || height <= 0 || depth <= 0) {
+		std::cerr << "Invalid voxel grid size: " << width << "x" << height << "x" << depth << std::endl;
+		return false;
+	}
+	if (layout != VOXEL_LAYOUT_LINEAR && layout != VOXEL_LAYOUT_MORTON) {
+		std::cerr << "Unknown voxel layout: " << layout << std::endl;
+		return false;
+	}
+
+	grid.width = width;
+	grid.height = height;
+	grid.depth = depth;
+	grid.bitsPerVoxel = bitsPerVoxel;
+	grid.layout = layout;
+
+	// The Morton layout is indexed by tile, and stores whole tiles even at the edges of the grid
+	size_t storedVoxels = voxelCount(grid);
+	int strideX = width, strideY = height;
+	if (layout == VOXEL_LAYOUT_MORTON) {
+		strideX = (width + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE;
+		strideY = (height + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE;
+		const int tilesZ = (depth + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE;
+		storedVoxels = (size_t)strideX * strideY * tilesZ * VOXEL_TILE_SIZE * VOXEL_TILE_SIZE * VOXEL_TILE_SIZE;
+	}
+
+	grid.strideShiftY = log2IfPowerOfTwo(strideX);
+	grid.strideShiftZ = grid.strideShiftY >= 0 && log2IfPowerOfTwo(strideY) >= 0 ? grid.strideShiftY + log2IfPowerOfTwo(strideY) : -1;
+	if (grid.strideShiftZ < 0) grid.strideShiftY = -1;
+
+	const size_t voxelsPerWord = 32 / bitsPerVoxel;
+	grid.words.assign((storedVoxels + voxelsPerWord - 1) / voxelsPerWord, 0u);
+	clearDirtyVoxels(grid);
+
+	return true;
+}
+
+size_t voxelCount(const VoxelGrid& grid) {
+	return (size_t)grid.width * grid.height * grid.depth;
+}
+
+size_t voxelGridBytes(const VoxelGrid& grid) {
+	return grid.words.size() * sizeof(uint32_t);
+}
+
+size_t voxelIndex(const VoxelGrid& grid, int x, int y, int z) {
+	if (grid.layout == VOXEL_LAYOUT_MORTON) {
+		const int tx = x / VOXEL_TILE_SIZE, ty = y / VOXEL_TILE_SIZE, tz = z / VOXEL_TILE_SIZE;
+		const size_t tile = grid.strideShiftY >= 0
+			? (size_t)tx | ((size_t)ty << grid.strideShiftY) | ((size_t)tz << grid.strideShiftZ)
+			: tx + (size_t)((grid.width + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE) * (ty + (size_t)((grid.height + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE) * tz);
+
+		const uint32_t local = spreadBits3(x % VOXEL_TILE_SIZE) | (spreadBits3(y % VOXEL_TILE_SIZE) << 1) | (spreadBits3(z % VOXEL_TILE_SIZE) << 2);
+		return tile * (VOXEL_TILE_SIZE * VOXEL_TILE_SIZE * VOXEL_TILE_SIZE) + local;
+	}
+
+	if (grid.strideShiftY >= 0) {
+		return (size_t)x | ((size_t)y << grid.strideShiftY) | ((size_t)z << grid.strideShiftZ);
+	}
+	return x + (size_t)grid.width * (y + (size_t)grid.height * z);
+}
+
+uint32_t getVoxel(const VoxelGrid& grid, int x, int y, int z) {
+	if (x < 0 || x >= grid.width || y < 0 || y >= grid.height || z < 0 || z >= grid.depth) return 0;
+
+	const size_t index = voxelIndex(grid, x, y, z);
+	const size_t voxelsPerWord = 32 / grid.bitsPerVoxel;
+	const uint32_t shift = (uint32_t)(index % voxelsPerWord) * grid.bitsPerVoxel;
+	const uint32_t mask = grid.bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << grid.bitsPerVoxel) - 1u;
+
+	return (grid.words[index / voxelsPerWord] >> shift) & mask;
+}
+
+void setVoxel(VoxelGrid& grid, int x, int y, int z, uint32_t id) {
+	if (x < 0 || x >= grid.width || y < 0 || y >= grid.height || z < 0 || z >= grid.depth) return;
+
+	const size_t index = voxelIndex(grid, x, y, z);
+	const size_t voxelsPerWord = 32 / grid.bitsPerVoxel;
+	const uint32_t shift = (uint32_t)(index % voxelsPerWord) * grid.bitsPerVoxel;
+	const uint32_t mask = grid.bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << grid.bitsPerVoxel) - 1u;
+
+	uint32_t& word = grid.words[index / voxelsPerWord];
+	const uint32_t newWord = (word & ~(mask << shift)) | ((id & mask) << shift);
+	if (newWord == word) return;
+
+	word = newWord;
+	markDirty(grid.dirty, index / voxelsPerWord * sizeof(uint32_t), sizeof(uint32_t));
+	grid.dirtyMin = glm::min(grid.dirtyMin, glm::ivec3(x, y, z));
+	grid.dirtyMax = glm::max(grid.dirtyMax, glm::ivec3(x, y, z));
+}
+
+void writeVoxel(VoxelGrid& grid, int x, int y, int z, uint32_t id) {
+	if (x < 0 || x >= grid.width || y < 0 || y >= grid.height || z < 0 || z >= grid.depth) return;
+
+	const size_t index = voxelIndex(grid, x, y, z);
+	const size_t voxelsPerWord = 32 / grid.bitsPerVoxel;
+	const uint32_t shift = (uint32_t)(index % voxelsPerWord) * grid.bitsPerVoxel;
+	const uint32_t mask = grid.bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << grid.bitsPerVoxel) - 1u;
+
+	uint32_t& word = grid.words[index / voxelsPerWord];
+	word = (word & ~(mask << shift)) | ((id & mask) << shift);
+}
+
+bool hasDirtyVoxels(const VoxelGrid& grid) {
+	return grid.dirtyMin.x <= grid.dirtyMax.x;
+}
+
+void clearDirtyBox(VoxelGrid& grid) {
+	grid.dirtyMin = glm::ivec3(INT32_MAX);
+	grid.dirtyMax = glm::ivec3(INT32_MIN);
+}
+
+void clearDirtyVoxels(VoxelGrid& grid) {
+	grid.dirty.spans.clear();
+	clearDirtyBox(grid);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "DirtySpans.h"
+
+// Order of the voxels in memory, shared by the CPU writer and testVoxel() in the shader
+enum VoxelLayout {
+	// x + width * (y + height * z)
+	VOXEL_LAYOUT_LINEAR = 0,
+	// VOXEL_TILE_SIZE^3 tiles stored one after the other in linear order, with the voxels
+	// of a tile in Z-order, so rays moving along any axis stay within few cache lines
+	VOXEL_LAYOUT_MORTON
+};
+
+const int VOXEL_TILE_SIZE = 8;
+
+// Entries of the palette in shader_data, every 8-bit voxel id has one
+const int PALETTE_SIZE = 256;
+
+// Runtime-sized voxel grid. Voxel ids are packed bitsPerVoxel bits at a time into
+// 32-bit words, which is also the layout the shader reads after the shader_data header.
+struct VoxelGrid {
+	int width = 0;
+	int height = 0;
+	int depth = 0;
+
+	// One of 1, 2, 4, 8, 16 or 32 so that voxels never straddle two words
+	int bitsPerVoxel = 8;
+
+	int layout = VOXEL_LAYOUT_LINEAR;
+
+	// log2 of the y and z strides (in voxels for the linear layout, in tiles for the Morton one)
+	// when they are powers of two, so indexing can use shifts instead of multiplies. -1 otherwise.
+	int strideShiftY = -1;
+	int strideShiftZ = -1;
+
+	std::vector<uint32_t> words;
+
+	// What setVoxel() changed since the last upload: byte ranges of words, and the voxel
+	// bounding box for the structures derived from the grid (empty when dirtyMin > dirtyMax)
+	DirtySpans dirty;
+	glm::ivec3 dirtyMin = glm::ivec3(INT32_MAX);
+	glm::ivec3 dirtyMax = glm::ivec3(INT32_MIN);
+};
+
+bool initVoxelGrid(VoxelGrid& grid, int width, int height, int depth, int bitsPerVoxel = 8, int layout = VOXEL_LAYOUT_LINEAR);
+
+size_t voxelCount(const VoxelGrid& grid);
+size_t voxelGridBytes(const VoxelGrid& grid);
+
+size_t voxelIndex(const VoxelGrid& grid, int x, int y, int z);
+
+uint32_t getVoxel(const VoxelGrid& grid, int x, int y, int z);
+void setVoxel(VoxelGrid& grid, int x, int y, int z, uint32_t id);
+
+// setVoxel() without the dirty tracking, for bulk fills that are uploaded as a whole.
+// Threads may call it concurrently as long as they never write to the same word.
+void writeVoxel(VoxelGrid& grid, int x, int y, int z, uint32_t id);
+
+bool hasDirtyVoxels(const VoxelGrid& grid);
+
+// Forgets the dirty bounding box once the derived structures are updated, the spans stay
+void clearDirtyBox(VoxelGrid& grid);
+
+// Forgets both the dirty spans and the box, after a full upload
+void clearDirtyVoxels(VoxelGrid& grid);
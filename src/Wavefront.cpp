@@ -0,0 +1,169 @@
+#include "Wavefront.h"
+
+#include <cstddef>
+#include <cstdint>
+
+#include "RaySort.h"
+#include "utils.h"
+
+// Local size of wavefront_comp.glsl
+static const uint32_t WAVEFRONT_GROUP_SIZE = 64;
+
+// Start of a queue: the number of paths, then the group counts of glDispatchComputeIndirect()
+struct QueueHeader {
+	uint32_t count;
+	uint32_t groups[3];
+};
+
+// Defined in front of wavefront_comp.glsl to pick the entry point of each stage
+static const char* const WAVEFRONT_STAGE_DEFINES[WAVEFRONT_STAGE_COUNT] = {
+	"STAGE_GENERATE",
+	"STAGE_EXTEND",
+	"STAGE_SHADE",
+	"STAGE_ACCUMULATE",
+	"STAGE_SORT_COUNT",
+	"STAGE_SORT_SCAN",
+	"STAGE_SORT_SCATTER"
+};
+
+bool initWavefront(Wavefront& wavefront, const std::string& source, int width, int height) {
+	// The defines go right after the #version line, which has to come first
+	const size_t versionEnd = source.find('\n', source.find("#version")) + 1;
+	for (int stage = 0; stage < WAVEFRONT_STAGE_COUNT; stage++) {
+		const std::string define = std::string("#define ") + WAVEFRONT_STAGE_DEFINES[stage] + "\n";
+		const std::string name = std::string("wavefront ") + WAVEFRONT_STAGE_DEFINES[stage];
+		wavefront.programs[stage] = createComputeProgram(source.substr(0, versionEnd) + define + source.substr(versionEnd), name.c_str());
+		if (wavefront.programs[stage] == 0) {
+			destroyWavefront(wavefront);
+			return false;
+		}
+	}
+
+	wavefront.width = width;
+	wavefront.height = height;
+	const size_t pathCount = (size_t)width * height;
+
+	glGenBuffers(1, &wavefront.pathSsbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, wavefront.pathSsbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, pathCount * WAVEFRONT_PATH_BYTES, nullptr, GL_DYNAMIC_COPY);
+
+	glGenBuffers(2, wavefront.queueSsbo);
+	for (GLuint queue : wavefront.queueSsbo) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(QueueHeader) + pathCount * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+	}
+
+	glGenBuffers(1, &wavefront.sortSsbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, wavefront.sortSsbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, RAY_SORT_BINS * sizeof(uint32_t), nullptr, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	return true;
+}
+
+void destroyWavefront(Wavefront& wavefront) {
+	for (GLuint program : wavefront.programs) glDeleteProgram(program);
+	glDeleteBuffers(1, &wavefront.pathSsbo);
+	glDeleteBuffers(2, wavefront.queueSsbo);
+	glDeleteBuffers(1, &wavefront.sortSsbo);
+	wavefront = Wavefront();
+}
+
+// Puts the program of the stage in use for its next dispatch
+static GLuint useStage(const Wavefront& wavefront, WavefrontStage stage) {
+	glUseProgram(wavefront.programs[stage]);
+	return wavefront.programs[stage];
+}
+
+static void setQueueHeader(GLuint queue, uint32_t count) {
+	const QueueHeader header = { count, { (count + WAVEFRONT_GROUP_SIZE - 1) / WAVEFRONT_GROUP_SIZE, 1, 1 } };
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, queue);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header);
+}
+
+// Sorts the paths of queue into the other one, which then holds the same header. The indirect
+// dispatch buffer must be queue.
+static void sortQueue(const Wavefront& wavefront, GLuint queue, GLuint sorted) {
+	// The header is copied and the bins cleared by buffer commands, after shaders wrote them
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, wavefront.sortSsbo);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, queue);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, sorted);
+
+	useStage(wavefront, WAVEFRONT_SORT_COUNT);
+	glDispatchComputeIndirect(offsetof(QueueHeader, groups));
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	useStage(wavefront, WAVEFRONT_SORT_SCAN);
+	glDispatchCompute(1, 1, 1);
+	glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+	useStage(wavefront, WAVEFRONT_SORT_SCATTER);
+	glDispatchComputeIndirect(offsetof(QueueHeader, groups));
+
+	glBindBuffer(GL_COPY_READ_BUFFER, queue);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, sorted);
+	glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, sizeof(QueueHeader));
+	glBindBuffer(GL_COPY_READ_BUFFER, 0);
+	glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void traceWavefront(const Wavefront& wavefront, GLuint colorTexture, GLuint bloomTexture, int spp, int bounces) {
+	const uint32_t pathCount = (uint32_t)(wavefront.width * wavefront.height);
+	const GLuint pixelGroups = (pathCount + WAVEFRONT_GROUP_SIZE - 1) / WAVEFRONT_GROUP_SIZE;
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 11, wavefront.pathSsbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 14, wavefront.sortSsbo);
+	glBindImageTexture(0, colorTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+	glBindImageTexture(1, bloomTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA32F);
+
+	for (int sample = 0; sample < spp; sample++) {
+		// Generate lists every path in the first queue
+		setQueueHeader(wavefront.queueSsbo[0], pathCount);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, wavefront.queueSsbo[0]);
+		setUniformInt(useStage(wavefront, WAVEFRONT_GENERATE), "u_Sample", sample);
+		glDispatchCompute(pixelGroups, 1, 1);
+		// Queue headers are reset with glBufferSubData() after the shaders counted in them
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+		// Queue of the paths to extend, the other one is filled by shade
+		int current = 0;
+		for (int bounce = 0; bounce < bounces; bounce++) {
+			const GLuint in = wavefront.queueSsbo[current];
+			const GLuint out = wavefront.queueSsbo[1 - current];
+
+			setQueueHeader(out, 0);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 12, in);
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 13, out);
+			glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, in);
+
+			const GLuint extend = useStage(wavefront, WAVEFRONT_EXTEND);
+			setUniformInt(extend, "u_Sample", sample);
+			setUniformInt(extend, "u_Bounce", bounce);
+			glDispatchComputeIndirect(offsetof(QueueHeader, groups));
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+			setUniformInt(useStage(wavefront, WAVEFRONT_SHADE), "u_Bounce", bounce);
+			glDispatchComputeIndirect(offsetof(QueueHeader, groups));
+			// The next bounce dispatches from the queue this one filled, and resets the header of
+			// the one it read
+			glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+			if (wavefront.sortRays && bounce + 1 < bounces) {
+				// Back into the queue just extended, which the next bounce reads again
+				glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, out);
+				sortQueue(wavefront, out, in);
+				glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+			} else {
+				current = 1 - current;
+			}
+		}
+	}
+
+	useStage(wavefront, WAVEFRONT_ACCUMULATE);
+	glDispatchCompute(pixelGroups, 1, 1);
+	glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT | GL_FRAMEBUFFER_BARRIER_BIT);
+
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, 0);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+
+#include <glad/gl.h>
+
+// Compute-shader alternative to the fragment.glsl megakernel (wavefront_comp.glsl). Each sample
+// goes through the stages below, with one dispatch per stage:
+//
+//   generate                    one path per pixel from the camera, all of them queued
+//   extend, shade (x bounces)   closest hit of every queued path, then its shading, which queues
+//                               the paths still going into the other queue for the next bounce
+//   accumulate (once a frame)   the samples of every pixel blended into the frame
+//
+// Extend and shade only run over the queue, with indirect dispatches sized by the shade stage of
+// the bounce before, so that the paths still going at bounce 30 are packed into full groups
+// instead of being scattered among invocations that stopped long ago.
+//
+// With sortRays, three more stages run after each shade to reorder the queue it filled by ray
+// octant and origin cell (RaySort.h) before the next extend: count the rays of every bin, scan
+// the counts into bin starts, scatter the rays into the other queue.
+enum WavefrontStage {
+	WAVEFRONT_GENERATE = 0,
+	WAVEFRONT_EXTEND,
+	WAVEFRONT_SHADE,
+	WAVEFRONT_ACCUMULATE,
+	WAVEFRONT_SORT_COUNT,
+	WAVEFRONT_SORT_SCAN,
+	WAVEFRONT_SORT_SCATTER,
+	WAVEFRONT_STAGE_COUNT
+};
+
+// Bytes of the PathState struct of wavefront_comp.glsl
+const size_t WAVEFRONT_PATH_BYTES = 7 * 16;
+
+struct Wavefront {
+	// One program per stage, indexed by WavefrontStage
+	GLuint programs[WAVEFRONT_STAGE_COUNT] = {};
+	// One path state per pixel, and the two ray queues used in turn
+	GLuint pathSsbo = 0;
+	GLuint queueSsbo[2] = {};
+	// Bins of the coherence sort
+	GLuint sortSsbo = 0;
+
+	// Sort the secondary rays before tracing them
+	bool sortRays = false;
+
+	int width = 0;
+	int height = 0;
+};
+
+// Compiles the program of every stage from the expanded source of wavefront_comp.glsl, each with
+// only its own entry point, and allocates the path states and queues for a width x height target.
+// False on failure.
+bool initWavefront(Wavefront& wavefront, const std::string& source, int width, int height);
+void destroyWavefront(Wavefront& wavefront);
+
+// Traces spp samples of bounces bounces for every pixel into the colour and bloom textures
+// (GL_RGBA32F, width x height). The uniforms of tracing.glsl must be set on every program, and the
+// voxel SSBOs and the textures of the last frame bound like for fragment.glsl.
+void traceWavefront(const Wavefront& wavefront, GLuint colorTexture, GLuint bloomTexture, int spp, int bounces);
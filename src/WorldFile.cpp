@@ -0,0 +1,281 @@
+#include "WorldFile.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+
+static uint64_t alignUp(uint64_t offset) {
+	return (offset + WORLD_FILE_ALIGNMENT - 1) / WORLD_FILE_ALIGNMENT * WORLD_FILE_ALIGNMENT;
+}
+
+// Offset of a level among the mips of a chunk
+static int mipLevelOffset(int level) {
+	int offset = 0;
+	for (int l = WORLD_FILE_MIP_FIRST; l < level; l++) {
+		const int cells = CHUNK_SIZE >> l;
+		offset += cells * cells * cells;
+	}
+	return offset;
+}
+
+// Largest id of every cell, the first level straight from the ids, the others from the level before
+static void buildChunkMips(const std::vector<uint8_t>& ids, uint8_t* mips) {
+	std::fill(mips, mips + WORLD_FILE_MIP_BYTES, 0);
+
+	const int first = CHUNK_SIZE >> WORLD_FILE_MIP_FIRST;
+	for (int z = 0; z < CHUNK_SIZE; z++) {
+		for (int y = 0; y < CHUNK_SIZE; y++) {
+			const uint8_t* row = ids.data() + CHUNK_SIZE * (y + CHUNK_SIZE * z);
+			uint8_t* cells = mips + first * ((y >> WORLD_FILE_MIP_FIRST) + first * (z >> WORLD_FILE_MIP_FIRST));
+			for (int x = 0; x < CHUNK_SIZE; x++) {
+				uint8_t& cell = cells[x >> WORLD_FILE_MIP_FIRST];
+				cell = std::max(cell, row[x]);
+			}
+		}
+	}
+
+	for (int level = WORLD_FILE_MIP_FIRST + 1; level < WORLD_FILE_MIP_FIRST + WORLD_FILE_MIP_LEVELS; level++) {
+		const uint8_t* fine = mips + mipLevelOffset(level - 1);
+		uint8_t* coarse = mips + mipLevelOffset(level);
+		const int n = CHUNK_SIZE >> level;
+		for (int z = 0; z < 2 * n; z++) {
+			for (int y = 0; y < 2 * n; y++) {
+				for (int x = 0; x < 2 * n; x++) {
+					uint8_t& cell = coarse[(x >> 1) + n * ((y >> 1) + n * (z >> 1))];
+					cell = std::max(cell, fine[x + 2 * n * (y + 2 * n * z)]);
+				}
+			}
+		}
+	}
+}
+
+static uint64_t payloadBytes(const WorldFileChunk& chunk) {
+	if ((chunk.header & CHUNK_UNIFORM) != 0u) return 0;
+	return (uint64_t)(chunk.header & 0xFFu) * CHUNK_PAGE_WORDS * sizeof(uint32_t);
+}
+
+bool writeWorldFile(const std::string& path, glm::ivec3 origin, glm::ivec3 dims, uint32_t seed, const ChunkSource& source, ThreadPool& pool, const glm::vec4* palette) {
+	if (glm::any(glm::lessThanEqual(dims, glm::ivec3(0)))) {
+		std::cerr << "Invalid world size: " << dims.x << "x" << dims.y << "x" << dims.z << " chunks" << std::endl;
+		return false;
+	}
+
+	std::ofstream file(path, std::ios::binary);
+	if (!file) {
+		std::cerr << "Failed to open " << path << " for writing" << std::endl;
+		return false;
+	}
+
+	const size_t chunks = (size_t)dims.x * dims.y * dims.z;
+	std::vector<WorldFileChunk> directory(chunks);
+
+	WorldFileHeader header = {};
+	header.magic = WORLD_FILE_MAGIC;
+	header.version = WORLD_FILE_VERSION;
+	header.chunkSize = CHUNK_SIZE;
+	header.seed = seed;
+	header.origin = glm::ivec4(origin, 0);
+	header.dims = glm::ivec4(dims, 0);
+	header.paletteOffset = palette != nullptr ? sizeof(WorldFileHeader) : 0;
+	header.directoryOffset = sizeof(WorldFileHeader) + (palette != nullptr ? PALETTE_SIZE * sizeof(glm::vec4) : 0);
+	header.mipOffset = header.directoryOffset + chunks * sizeof(WorldFileChunk);
+
+	// The directory is written last, once the payload offsets are known
+	uint64_t offset = alignUp(header.mipOffset + chunks * WORLD_FILE_MIP_BYTES);
+
+	const int batch = 4 * threadCount(pool);
+	std::vector<PackedChunk> packed(batch);
+	std::vector<uint8_t> mips((size_t)batch * WORLD_FILE_MIP_BYTES);
+
+	for (size_t first = 0; first < chunks; first += batch) {
+		const int count = (int)std::min((size_t)batch, chunks - first);
+		parallelFor(pool, count, [&](int i) {
+			const size_t index = first + i;
+			const glm::ivec3 chunk = origin + glm::ivec3(index % dims.x, (index / dims.x) % dims.y, index / ((size_t)dims.x * dims.y));
+
+			std::vector<uint8_t> ids;
+			source(chunk, ids);
+			packChunk(ids, packed[i]);
+			buildChunkMips(ids, mips.data() + (size_t)i * WORLD_FILE_MIP_BYTES);
+		});
+
+		// The mips of a batch are contiguous, they go in one write
+		file.seekp(header.mipOffset + first * WORLD_FILE_MIP_BYTES);
+		file.write((const char*)mips.data(), (size_t)count * WORLD_FILE_MIP_BYTES);
+		file.seekp(offset);
+
+		for (int i = 0; i < count; i++) {
+			WorldFileChunk& entry = directory[first + i];
+			entry.header = packed[i].header;
+			std::copy(packed[i].palette, packed[i].palette + CHUNK_MAX_PALETTE / 4, entry.palette);
+			if (packed[i].words.empty()) continue;
+
+			entry.offset = offset;
+			file.write((const char*)packed[i].words.data(), packed[i].words.size() * sizeof(uint32_t));
+			offset += alignUp(packed[i].words.size() * sizeof(uint32_t));
+		}
+	}
+
+	header.fileSize = offset;
+	file.seekp(0);
+	file.write((const char*)&header, sizeof(header));
+	if (palette != nullptr) file.write((const char*)palette, PALETTE_SIZE * sizeof(glm::vec4));
+	file.write((const char*)directory.data(), directory.size() * sizeof(WorldFileChunk));
+	if (!file) {
+		std::cerr << "Failed to write " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+bool writeWorldFile(const std::string& path, const WorldGenParams& params, glm::ivec3 origin, glm::ivec3 dims, ThreadPool& pool) {
+	const float worldHeight = (float)(dims.y * CHUNK_SIZE);
+	return writeWorldFile(path, origin, dims, params.seed, [&](glm::ivec3 chunk, std::vector<uint8_t>& ids) {
+		generateChunkIds(params, worldHeight, chunk, ids);
+	}, pool);
+}
+
+// Whether count elements of elementBytes starting at offset fit in size bytes, without overflowing
+static bool fitsInFile(uint64_t offset, uint64_t count, uint64_t elementBytes, uint64_t size) {
+	return offset <= size && count <= (size - offset) / elementBytes;
+}
+
+bool openWorldFile(WorldFile& file, const std::string& path) {
+	closeWorldFile(file);
+
+	// Chunks are read in whatever order the camera needs them
+	if (!mapFile(file.mapping, path, MAPPED_FILE_RANDOM))
+		return false;
+
+	const WorldFileHeader* header = (const WorldFileHeader*)file.mapping.data;
+	const size_t size = file.mapping.size;
+	if (size < sizeof(WorldFileHeader) || header->magic != WORLD_FILE_MAGIC || header->version < 1 || header->version > WORLD_FILE_VERSION || header->chunkSize != (uint32_t)CHUNK_SIZE) {
+		std::cerr << "Not a version " << WORLD_FILE_VERSION << " world file: " << path << std::endl;
+		closeWorldFile(file);
+		return false;
+	}
+
+	// Every dimension is bounded by the entries the file can hold before they are multiplied
+	const uint64_t maxChunks = size / sizeof(WorldFileChunk);
+	uint64_t chunks = 1;
+	bool truncated = header->fileSize > size;
+	for (int axis = 0; axis < 3 && !truncated; axis++) {
+		const int dim = header->dims[axis];
+		truncated = dim <= 0 || (uint64_t)dim > maxChunks / chunks;
+		if (!truncated) chunks *= (uint64_t)dim;
+	}
+	truncated = truncated || !fitsInFile(header->directoryOffset, chunks, sizeof(WorldFileChunk), size);
+	if (header->version >= 2 && !truncated) {
+		truncated = !fitsInFile(header->paletteOffset, PALETTE_SIZE, sizeof(glm::vec4), size) || !fitsInFile(header->mipOffset, chunks, WORLD_FILE_MIP_BYTES, size);
+	}
+	if (truncated) {
+		std::cerr << "Truncated world file: " << path << std::endl;
+		closeWorldFile(file);
+		return false;
+	}
+
+	file.header = header;
+	file.directory = (const WorldFileChunk*)(file.mapping.data + header->directoryOffset);
+	return true;
+}
+
+void closeWorldFile(WorldFile& file) {
+	unmapFile(file.mapping);
+	file = WorldFile();
+}
+
+// Directory index of a chunk, -1 outside the box
+static int64_t chunkEntry(const WorldFile& file, glm::ivec3 chunk) {
+	const glm::ivec3 local = chunk - glm::ivec3(file.header->origin);
+	const glm::ivec3 dims = glm::ivec3(file.header->dims);
+	if (glm::any(glm::lessThan(local, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(local, dims))) return -1;
+	return local.x + (int64_t)dims.x * (local.y + (int64_t)dims.y * local.z);
+}
+
+const WorldFileChunk* worldFileChunk(const WorldFile& file, glm::ivec3 chunk) {
+	const int64_t index = chunkEntry(file, chunk);
+	if (index < 0) return nullptr;
+
+	return file.directory + index;
+}
+
+bool worldFileChunkValid(const WorldFile& file, const WorldFileChunk& chunk) {
+	if ((chunk.header & CHUNK_UNIFORM) != 0u) return (chunk.header & ~CHUNK_UNIFORM) <= 0xFFu;
+
+	const uint32_t bits = chunk.header & 0xFFu;
+	const uint32_t paletteSize = chunk.header >> 8;
+	if (bits == 0u || bits > (uint32_t)CHUNK_MAX_BITS || (bits & (bits - 1u)) != 0u) return false;
+	if (bits < (uint32_t)CHUNK_MAX_BITS ? paletteSize > (1u << bits) : paletteSize != 0u) return false;
+	return chunk.offset % WORLD_FILE_ALIGNMENT == 0 && fitsInFile(chunk.offset, payloadBytes(chunk), 1, file.mapping.size);
+}
+
+const uint32_t* worldFileWords(const WorldFile& file, const WorldFileChunk& chunk) {
+	return (const uint32_t*)(file.mapping.data + chunk.offset);
+}
+
+const glm::vec4* worldFilePalette(const WorldFile& file) {
+	if (file.header->version < 2 || file.header->paletteOffset == 0) return nullptr;
+	return (const glm::vec4*)(file.mapping.data + file.header->paletteOffset);
+}
+
+const uint8_t* worldFileMip(const WorldFile& file, glm::ivec3 chunk, int level) {
+	if (file.header->version < 2 || level < WORLD_FILE_MIP_FIRST || level >= WORLD_FILE_MIP_FIRST + WORLD_FILE_MIP_LEVELS) return nullptr;
+	const int64_t index = chunkEntry(file, chunk);
+	if (index < 0) return nullptr;
+	return file.mapping.data + file.header->mipOffset + (uint64_t)index * WORLD_FILE_MIP_BYTES + mipLevelOffset(level);
+}
+
+int loadWorldFileMip(VoxelGrid& grid, const WorldFile& file) {
+	if (file.header->version < 2) return -1;
+	if (grid.bitsPerVoxel < 8) {
+		std::cerr << "World file overviews need at least 8 bits per voxel" << std::endl;
+		return -1;
+	}
+
+	const glm::ivec3 dims = glm::ivec3(file.header->dims);
+	const glm::ivec3 origin = glm::ivec3(file.header->origin);
+	for (int level = WORLD_FILE_MIP_FIRST; level < WORLD_FILE_MIP_FIRST + WORLD_FILE_MIP_LEVELS; level++) {
+		const int cells = CHUNK_SIZE >> level;
+		const glm::ivec3 size = dims * cells;
+		if (glm::any(glm::greaterThan(size, glm::ivec3(grid.width, grid.height, grid.depth)))) continue;
+
+		const glm::ivec3 offset((grid.width - size.x) / 2, 0, (grid.depth - size.z) / 2);
+		for (int cz = 0; cz < dims.z; cz++) {
+			for (int cy = 0; cy < dims.y; cy++) {
+				for (int cx = 0; cx < dims.x; cx++) {
+					const uint8_t* mip = worldFileMip(file, origin + glm::ivec3(cx, cy, cz), level);
+					for (int i = 0; i < cells * cells * cells; i++) {
+						if (mip[i] == 0) continue;
+						const glm::ivec3 p = offset + glm::ivec3(cx, cy, cz) * cells + glm::ivec3(i % cells, (i / cells) % cells, i / (cells * cells));
+						writeVoxel(grid, p.x, p.y, p.z, mip[i]);
+					}
+				}
+			}
+		}
+		return level;
+	}
+
+	// Past one cell per chunk, a cell spans several chunks and holds the largest of their cells
+	const int chunkLevel = WORLD_FILE_MIP_FIRST + WORLD_FILE_MIP_LEVELS - 1;
+	for (int level = chunkLevel + 1; level - chunkLevel < 31; level++) {
+		const int span = 1 << (level - chunkLevel);
+		const glm::ivec3 size = (dims + span - 1) / span;
+		if (glm::any(glm::greaterThan(size, glm::ivec3(grid.width, grid.height, grid.depth)))) continue;
+
+		const glm::ivec3 offset((grid.width - size.x) / 2, 0, (grid.depth - size.z) / 2);
+		for (int cz = 0; cz < dims.z; cz++) {
+			for (int cy = 0; cy < dims.y; cy++) {
+				for (int cx = 0; cx < dims.x; cx++) {
+					const uint8_t id = *worldFileMip(file, origin + glm::ivec3(cx, cy, cz), chunkLevel);
+					if (id == 0) continue;
+					const glm::ivec3 p = offset + glm::ivec3(cx, cy, cz) / span;
+					if (id > getVoxel(grid, p.x, p.y, p.z)) writeVoxel(grid, p.x, p.y, p.z, id);
+				}
+			}
+		}
+		return level;
+	}
+	return -1;
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ChunkWorld.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "WorldGen.h"
+
+// Native world file: a header, a directory with one entry per chunk of a box of chunks, then
+// the payloads. A payload is the pages of a PackedChunk exactly as the chunk pool stores them,
+// starting on a WORLD_FILE_ALIGNMENT boundary. Opening a file maps it and reads the header
+// only, chunks are copied out of the mapping when the chunk world touches them.
+// Version 2 adds an optional palette and the mips of every chunk, version 1 files have neither.
+const uint32_t WORLD_FILE_MAGIC = 0x46575856u;	// "VXWF"
+const uint32_t WORLD_FILE_VERSION = 2;
+const uint64_t WORLD_FILE_ALIGNMENT = 4096;
+
+// Every chunk has mips from CHUNK_SIZE / 4 down to a single cell, each cell holding the largest
+// id below it: non-zero cells are occupied, and ids sorted by density, like the classes of a
+// scanned volume, keep their densest class. The levels of a chunk follow each other, x-fastest.
+const int WORLD_FILE_MIP_FIRST = 2;
+const int WORLD_FILE_MIP_LEVELS = 4;
+const int WORLD_FILE_MIP_BYTES = 8 * 8 * 8 + 4 * 4 * 4 + 2 * 2 * 2 + 1;
+
+struct WorldFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t chunkSize;
+	uint32_t seed;
+	// Chunk coordinates of the first directory entry, the directory is x-fastest
+	glm::ivec4 origin;
+	glm::ivec4 dims;
+	uint64_t directoryOffset;
+	uint64_t fileSize;
+	// PALETTE_SIZE vec4 as in shader_data, 0 when the file has none
+	uint64_t paletteOffset;
+	// WORLD_FILE_MIP_BYTES per directory entry, in the same order
+	uint64_t mipOffset;
+};
+
+struct WorldFileChunk {
+	// Payload of the chunk, 0 for uniform chunks which have none
+	uint64_t offset;
+	// As in PackedChunk
+	uint32_t header;
+	uint32_t reserved;
+	uint32_t palette[CHUNK_MAX_PALETTE / 4];
+};
+
+struct WorldFile {
+	MappedFile mapping;
+	const WorldFileHeader* header = nullptr;
+	const WorldFileChunk* directory = nullptr;
+};
+
+// Fills the x-fastest ids of a chunk, called from the pool threads
+using ChunkSource = std::function<void(glm::ivec3 chunk, std::vector<uint8_t>& ids)>;
+
+// Packs the chunks of the box [origin, origin + dims) and builds their mips on the pool, then
+// writes them out. Only a few chunks per thread are in memory at any time.
+bool writeWorldFile(const std::string& path, glm::ivec3 origin, glm::ivec3 dims, uint32_t seed, const ChunkSource& source, ThreadPool& pool, const glm::vec4* palette = nullptr);
+
+// Generated terrain spanning the height of the box, see WorldGenParams
+bool writeWorldFile(const std::string& path, const WorldGenParams& params, glm::ivec3 origin, glm::ivec3 dims, ThreadPool& pool);
+
+bool openWorldFile(WorldFile& file, const std::string& path);
+void closeWorldFile(WorldFile& file);
+
+// Directory entry of a chunk, nullptr outside the box. Entries are not checked until they are
+// read, see worldFileChunkValid().
+const WorldFileChunk* worldFileChunk(const WorldFile& file, glm::ivec3 chunk);
+
+// False for a corrupt entry: a header that is no PackedChunk one, or a payload that is not
+// aligned or lies outside the file
+bool worldFileChunkValid(const WorldFile& file, const WorldFileChunk& chunk);
+
+// Pages of indices of a chunk, the mapping is only read when they are
+const uint32_t* worldFileWords(const WorldFile& file, const WorldFileChunk& chunk);
+
+// PALETTE_SIZE entries, nullptr when the file has no palette
+const glm::vec4* worldFilePalette(const WorldFile& file);
+
+// (CHUNK_SIZE >> level)^3 cells of a chunk for level in [WORLD_FILE_MIP_FIRST,
+// WORLD_FILE_MIP_FIRST + WORLD_FILE_MIP_LEVELS), nullptr outside the box or without mips
+const uint8_t* worldFileMip(const WorldFile& file, glm::ivec3 chunk, int level);
+
+// Fills the grid from the finest mip level at which the whole box fits, one voxel per cell,
+// centred in x and z. Levels coarser than a cell per chunk are made on the fly from the
+// one-cell mips of the chunks they span. The grid needs 8 bits per voxel for the ids. Returns
+// the level, or -1 when the file has no mips or the grid is too narrow.
+int loadWorldFileMip(VoxelGrid& grid, const WorldFile& file);
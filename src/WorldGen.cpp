@@ -0,0 +1,223 @@
+#include "WorldGen.h"
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include "Noise.h"
+
+static_assert(WORLDGEN_CHUNK_SIZE % VOXEL_TILE_SIZE == 0, "chunks must be made of whole Morton tiles");
+
+// Cave noise is sampled every CAVE_STEP voxels and trilinearly interpolated in between
+const int CAVE_STEP = 4;
+const int CAVE_LATTICE = WORLDGEN_CHUNK_SIZE / CAVE_STEP + 1;
+
+// Distinct seeds for the independent noise fields
+const uint32_t SEED_CAVE_A = 0x1B873593u;
+const uint32_t SEED_CAVE_B = 0x68E31DA4u;
+const uint32_t SEED_VEINS = 0x5EED0BE5u;
+
+static float randomFloat01(uint32_t hash) {
+	return (hash >> 8) * (1.0f / 16777216.0f);
+}
+
+void generateChunkIds(const WorldGenParams& params, float worldHeight, glm::ivec3 chunk, std::vector<uint8_t>& ids) {
+	const int size = WORLDGEN_CHUNK_SIZE;
+	const glm::ivec3 origin = chunk * size;
+
+	ids.assign(size * size * size, BLOCK_AIR);
+
+	// All the noise of the chunk is evaluated in batches, see fbm2Batch()
+	float columnX[WORLDGEN_CHUNK_SIZE * WORLDGEN_CHUNK_SIZE], columnZ[WORLDGEN_CHUNK_SIZE * WORLDGEN_CHUNK_SIZE];
+	float heights[WORLDGEN_CHUNK_SIZE * WORLDGEN_CHUNK_SIZE];
+	for (int z = 0; z < size; z++) {
+		for (int x = 0; x < size; x++) {
+			columnX[x + size * z] = (origin.x + x) / params.terrainScale;
+			columnZ[x + size * z] = (origin.z + z) / params.terrainScale;
+		}
+	}
+	fbm2Batch(params.seed, columnX, columnZ, heights, size * size, params.terrainOctaves);
+	for (int i = 0; i < size * size; i++) {
+		heights[i] = (params.baseHeight + params.heightAmplitude * heights[i]) * worldHeight;
+	}
+
+	// Tunnels follow the zero crossings of two noise fields. The lattice points sit at
+	// multiples of CAVE_STEP in world space, so neighbouring chunks line up.
+	const int latticePoints = CAVE_LATTICE * CAVE_LATTICE * CAVE_LATTICE;
+	float latticeX[latticePoints], latticeY[latticePoints], latticeZ[latticePoints];
+	for (int k = 0; k < CAVE_LATTICE; k++) {
+		for (int j = 0; j < CAVE_LATTICE; j++) {
+			for (int i = 0; i < CAVE_LATTICE; i++) {
+				const glm::vec3 p = glm::vec3(origin + glm::ivec3(i, j, k) * CAVE_STEP) / params.caveScale * glm::vec3(1.0f, 1.5f, 1.0f);
+				const int index = i + CAVE_LATTICE * (j + CAVE_LATTICE * k);
+				latticeX[index] = p.x;
+				latticeY[index] = p.y;
+				latticeZ[index] = p.z;
+			}
+		}
+	}
+	float caveA[latticePoints], caveB[latticePoints];
+	fbm3Batch(params.seed ^ SEED_CAVE_A, latticeX, latticeY, latticeZ, caveA, latticePoints, 3);
+	fbm3Batch(params.seed ^ SEED_CAVE_B, latticeX, latticeY, latticeZ, caveB, latticePoints, 3);
+
+	for (int z = 0; z < size; z++) {
+		for (int y = 0; y < size; y++) {
+			for (int x = 0; x < size; x++) {
+				const float height = heights[x + size * z];
+				const int worldY = origin.y + y;
+				if (worldY > height) continue;
+
+				const float depth = height - worldY;
+				const bool beach = height < params.sandLevel * worldHeight;
+
+				uint8_t id = BLOCK_STONE;
+				if (depth < 1.0f) id = beach ? BLOCK_SAND : (height > params.snowLevel * worldHeight ? BLOCK_SNOW : BLOCK_GRASS);
+				else if (depth < 4.0f) id = beach ? BLOCK_SAND : BLOCK_DIRT;
+
+				// The bottom layer is never carved
+				if (worldY > 0) {
+					const int i = x / CAVE_STEP, j = y / CAVE_STEP, k = z / CAVE_STEP;
+					const float u = (x % CAVE_STEP) / (float)CAVE_STEP, v = (y % CAVE_STEP) / (float)CAVE_STEP, w = (z % CAVE_STEP) / (float)CAVE_STEP;
+
+					auto sample = [&](const float* lattice) {
+						auto at = [&](int di, int dj, int dk) { return lattice[(i + di) + CAVE_LATTICE * ((j + dj) + CAVE_LATTICE * (k + dk))]; };
+						const float c00 = at(0, 0, 0) + (at(1, 0, 0) - at(0, 0, 0)) * u;
+						const float c10 = at(0, 1, 0) + (at(1, 1, 0) - at(0, 1, 0)) * u;
+						const float c01 = at(0, 0, 1) + (at(1, 0, 1) - at(0, 0, 1)) * u;
+						const float c11 = at(0, 1, 1) + (at(1, 1, 1) - at(0, 1, 1)) * u;
+						const float c0 = c00 + (c10 - c00) * v;
+						const float c1 = c01 + (c11 - c01) * v;
+						return c0 + (c1 - c0) * w;
+					};
+
+					if (std::abs(sample(caveA)) < params.caveThreshold && std::abs(sample(caveB)) < params.caveThreshold) id = BLOCK_AIR;
+				}
+
+				ids[x + size * (y + size * z)] = id;
+			}
+		}
+	}
+
+	// Ore veins are small blobs inside the chunk's stone, their kind depends on the depth
+	const uint32_t veinSeed = hashCoords(params.seed ^ SEED_VEINS, chunk.x, chunk.y, chunk.z);
+	for (int vein = 0; vein < params.veinsPerChunk; vein++) {
+		const glm::vec3 center = glm::vec3(
+			randomFloat01(hashCoords(veinSeed, vein, 0, 0)),
+			randomFloat01(hashCoords(veinSeed, vein, 1, 0)),
+			randomFloat01(hashCoords(veinSeed, vein, 2, 0))) * (float)size;
+		const float radius = 1.0f + 1.5f * randomFloat01(hashCoords(veinSeed, vein, 3, 0));
+		const float rarity = randomFloat01(hashCoords(veinSeed, vein, 4, 0));
+
+		const float relativeHeight = (origin.y + center.y) / worldHeight;
+		uint8_t ore = BLOCK_COAL;
+		if (relativeHeight < 0.15f) ore = rarity < 0.3f ? BLOCK_GLOWSTONE : BLOCK_GOLD;
+		else if (relativeHeight < 0.3f) ore = rarity < 0.5f ? BLOCK_IRON : BLOCK_COAL;
+
+		const glm::ivec3 lo = glm::max(glm::ivec3(glm::floor(center - radius)), glm::ivec3(0));
+		const glm::ivec3 hi = glm::min(glm::ivec3(glm::ceil(center + radius)), glm::ivec3(size - 1));
+		for (int z = lo.z; z <= hi.z; z++) {
+			for (int y = lo.y; y <= hi.y; y++) {
+				for (int x = lo.x; x <= hi.x; x++) {
+					uint8_t& id = ids[x + size * (y + size * z)];
+					if (id == BLOCK_STONE && glm::length(glm::vec3(x, y, z) + 0.5f - center) < radius) id = ore;
+				}
+			}
+		}
+	}
+}
+
+static void writeChunk(VoxelGrid& grid, glm::ivec3 chunk, const std::vector<uint8_t>& ids) {
+	const int size = WORLDGEN_CHUNK_SIZE;
+	const glm::ivec3 origin = chunk * size;
+	const glm::ivec3 end = glm::min(origin + size, glm::ivec3(grid.width, grid.height, grid.depth));
+
+	for (int z = origin.z; z < end.z; z++) {
+		for (int y = origin.y; y < end.y; y++) {
+			for (int x = origin.x; x < end.x; x++) {
+				writeVoxel(grid, x, y, z, ids[(x - origin.x) + size * ((y - origin.y) + size * (z - origin.z))]);
+			}
+		}
+	}
+}
+
+// Chunks can be written concurrently when no packed word holds voxels of two chunks
+static bool chunksOwnWords(const VoxelGrid& grid) {
+	// Chunks are made of whole tiles, and tiles of whole words
+	if (grid.layout == VOXEL_LAYOUT_MORTON) return true;
+	// Every row starts on a word boundary
+	return grid.width % (32 / grid.bitsPerVoxel) == 0;
+}
+
+void generateChunk(VoxelGrid& grid, const WorldGenParams& params, glm::ivec3 chunk) {
+	std::vector<uint8_t> ids;
+	generateChunkIds(params, (float)grid.height, chunk, ids);
+	writeChunk(grid, chunk, ids);
+}
+
+bool generateWorld(VoxelGrid& grid, const WorldGenParams& params, ThreadPool& pool) {
+	static_assert(BLOCK_COUNT <= 1 << WORLDGEN_MIN_BITS, "WORLDGEN_MIN_BITS must hold every block id");
+	if (grid.bitsPerVoxel < WORLDGEN_MIN_BITS) {
+		std::cerr << "World generation needs at least " << WORLDGEN_MIN_BITS << " bits per voxel, the grid has " << grid.bitsPerVoxel << std::endl;
+		return false;
+	}
+
+	const glm::ivec3 chunks = (glm::ivec3(grid.width, grid.height, grid.depth) + WORLDGEN_CHUNK_SIZE - 1) / WORLDGEN_CHUNK_SIZE;
+	const int chunkCount = chunks.x * chunks.y * chunks.z;
+
+	auto chunkAt = [&](int i) {
+		return glm::ivec3(i % chunks.x, (i / chunks.x) % chunks.y, i / (chunks.x * chunks.y));
+	};
+
+	if (chunksOwnWords(grid)) {
+		parallelFor(pool, chunkCount, [&](int i) {
+			generateChunk(grid, params, chunkAt(i));
+		});
+		return true;
+	}
+
+	// Otherwise only the noise runs in parallel and the chunks are written one after the other
+	std::vector<std::vector<uint8_t>> chunkIds(chunkCount);
+	parallelFor(pool, chunkCount, [&](int i) {
+		generateChunkIds(params, (float)grid.height, chunkAt(i), chunkIds[i]);
+	});
+	for (int i = 0; i < chunkCount; i++) {
+		writeChunk(grid, chunkAt(i), chunkIds[i]);
+	}
+	return true;
+}
+
+uint32_t architectureVoxel(int x, int y, int z) {
+	const int size = ARCHITECTURE_ROOM_SIZE;
+	const int lx = x % size, ly = y % size, lz = z % size;
+
+	// Floor slab with a gold trim along two edges
+	if (ly < 2) return BLOCK_STONE;
+	if (ly == 2 && (lx == 0 || lz == 0)) return BLOCK_GOLD;
+
+	// Pillars in the corners
+	if (lx < 4 && lz < 4) return BLOCK_STONE;
+
+	// Walls across every other room, pierced by a row of windows
+	if ((x / size) % 2 == 0 && lx >= 14 && lx < 16) {
+		const bool window = ly >= 10 && ly < 22 && lz % 8 >= 2 && lz % 8 < 6;
+		return window ? BLOCK_AIR : BLOCK_DIRT;
+	}
+
+	// Ceiling lamp
+	if (ly >= 28 && lx >= 22 && lx < 24 && lz >= 22 && lz < 24) return BLOCK_GLOWSTONE;
+
+	return BLOCK_AIR;
+}
+
+void worldGenPalette(glm::vec4 palette[BLOCK_COUNT]) {
+	palette[BLOCK_AIR] = glm::vec4(0.0f);
+	palette[BLOCK_GLOWSTONE] = glm::vec4(1.0f, 0.8f, 0.45f, 2.0f);
+	palette[BLOCK_STONE] = glm::vec4(0.5f, 0.5f, 0.52f, 0.0f);
+	palette[BLOCK_DIRT] = glm::vec4(0.45f, 0.3f, 0.18f, 0.0f);
+	palette[BLOCK_GRASS] = glm::vec4(0.3f, 0.6f, 0.2f, 0.0f);
+	palette[BLOCK_SAND] = glm::vec4(0.85f, 0.8f, 0.55f, 0.0f);
+	palette[BLOCK_SNOW] = glm::vec4(0.95f, 0.95f, 0.97f, 0.0f);
+	palette[BLOCK_COAL] = glm::vec4(0.15f, 0.15f, 0.15f, 0.0f);
+	palette[BLOCK_IRON] = glm::vec4(0.7f, 0.55f, 0.45f, 0.0f);
+	palette[BLOCK_GOLD] = glm::vec4(0.95f, 0.75f, 0.2f, 0.0f);
+}
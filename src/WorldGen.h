@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "VoxelGrid.h"
+#include "ThreadPool.h"
+
+// Procedural terrain: fBm height field, noise caves and ore veins. The world is generated
+// in WORLDGEN_CHUNK_SIZE^3 chunks; everything in a chunk only depends on the seed and the
+// chunk position, so the same seed gives the same bytes at any thread count.
+const int WORLDGEN_CHUNK_SIZE = 32;
+
+// Voxel ids written by the generator, also indices into the palette
+enum WorldBlock {
+	BLOCK_AIR = 0,
+	BLOCK_GLOWSTONE,	// emissive in fragment.glsl
+	BLOCK_STONE,
+	BLOCK_DIRT,
+	BLOCK_GRASS,
+	BLOCK_SAND,
+	BLOCK_SNOW,
+	BLOCK_COAL,
+	BLOCK_IRON,
+	BLOCK_GOLD,
+	BLOCK_COUNT
+};
+
+struct WorldGenParams {
+	uint32_t seed = 1337;
+
+	// Terrain surface, as fractions of the grid height
+	float baseHeight = 0.45f;
+	float heightAmplitude = 0.6f;
+	float sandLevel = 0.36f;
+	float snowLevel = 0.62f;
+
+	// Horizontal size of the main terrain features, in voxels
+	float terrainScale = 192.0f;
+	int terrainOctaves = 6;
+
+	float caveScale = 48.0f;
+	// Width of the cave tunnels, larger values carve more
+	float caveThreshold = 0.06f;
+
+	int veinsPerChunk = 6;
+};
+
+// Ids of one chunk, x fastest, for a world whose terrain levels are relative to worldHeight.
+// The chunk can be anywhere, also outside of any grid.
+void generateChunkIds(const WorldGenParams& params, float worldHeight, glm::ivec3 chunk, std::vector<uint8_t>& ids);
+
+// Smallest VoxelGrid::bitsPerVoxel that holds every WorldBlock
+const int WORLDGEN_MIN_BITS = 4;
+
+// The grid must have at least WORLDGEN_MIN_BITS bits per voxel
+void generateChunk(VoxelGrid& grid, const WorldGenParams& params, glm::ivec3 chunk);
+
+// Fills the whole grid, one chunk per pool task. Bypasses the dirty tracking. False, with the
+// grid untouched, when its voxels are too narrow for the block ids.
+bool generateWorld(VoxelGrid& grid, const WorldGenParams& params, ThreadPool& pool);
+
+// Colours of the blocks, w is the emission strength and only glowstone has some
+void worldGenPalette(glm::vec4 palette[BLOCK_COUNT]);
+
+// A city of identical rooms: floors, pillars, walls with windows and a lamp per room,
+// repeating every ARCHITECTURE_ROOM_SIZE voxels in every direction
+const int ARCHITECTURE_ROOM_SIZE = 32;
+
+uint32_t architectureVoxel(int x, int y, int z);
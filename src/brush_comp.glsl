@@ -0,0 +1,253 @@
+#version 430 core
+
+// Brushes applied straight to the voxel SSBO, see GpuBrush.h. Every dispatch runs one pass over
+// the box [u_Min, u_Min + u_Size): the brush itself, then the passes that bring the structures
+// derived from the voxels up to date over what it changed.
+layout (local_size_x = 4, local_size_y = 4, local_size_z = 4) in;
+
+// Same blocks as in fragment.glsl
+layout (std430, binding = 2) buffer shader_data {
+	int mapw;
+	int maph;
+	int mapd;
+	int bitsPerVoxel;
+
+	int voxelLayout;
+	int strideShiftY;
+	int strideShiftZ;
+
+	vec4 palette[256];
+
+	uint data[];
+};
+
+layout (std430, binding = 5) buffer occupancy_data {
+	int occLevels;
+	ivec4 occLevel[8];
+
+	uvec2 occWords[];
+};
+
+layout (std430, binding = 6) buffer distance_data {
+	uint distances[];
+};
+
+layout (std430, binding = 9) buffer column_data {
+	int columnLevels;
+	ivec4 columnLevel[16];
+
+	uint columnTops[];
+};
+
+const int VOXEL_LAYOUT_MORTON = 1;
+const int VOXEL_TILE_SIZE = 8;
+
+// Values of GpuBrushPass
+const int PASS_VOXELS = 0;
+const int PASS_OCCUPANCY = 1;
+const int PASS_COLUMNS = 2;
+const int PASS_DISTANCE = 3;
+
+// Values of GpuBrushShape
+const int SHAPE_SPHERE = 0;
+const int SHAPE_BOX = 1;
+const int SHAPE_NOISE = 2;
+
+uniform int u_Pass;
+uniform ivec3 u_Min;
+uniform ivec3 u_Size;
+
+// Occupancy pyramid or column quadtree level of PASS_OCCUPANCY and PASS_COLUMNS
+uniform int u_Level;
+
+uniform int u_Shape;
+uniform vec3 u_Centre;
+uniform float u_Radius;
+uniform uint u_Id;
+// Only voxels holding this id are written, any voxel when negative
+uniform int u_From;
+
+uniform float u_NoiseScale;
+uniform float u_NoiseThreshold;
+uniform uint u_Seed;
+
+// Voxels the brush edited, for PASS_DISTANCE
+uniform ivec3 u_EditMin;
+uniform ivec3 u_EditMax;
+
+// Spreads the 3 low bits of v so that they land on every third bit
+uint spreadBits3(uint v) {
+	return (v & 1u) | ((v & 2u) << 2) | ((v & 4u) << 4);
+}
+
+// Must match voxelIndex() in VoxelGrid.cpp
+uint voxelIndex(int x, int y, int z) {
+	if (voxelLayout == VOXEL_LAYOUT_MORTON) {
+		uvec3 tile = uvec3(x, y, z) >> 3u;
+		uint tileIndex = strideShiftY >= 0
+			? tile.x | (tile.y << strideShiftY) | (tile.z << strideShiftZ)
+			: tile.x + uint((mapw + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE) * (tile.y + uint((maph + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE) * tile.z);
+
+		uvec3 local = uvec3(x, y, z) & 7u;
+		return (tileIndex << 9) | spreadBits3(local.x) | (spreadBits3(local.y) << 1) | (spreadBits3(local.z) << 2);
+	}
+
+	if (strideShiftY >= 0) return uint(x) | (uint(y) << strideShiftY) | (uint(z) << strideShiftZ);
+	return uint(x + y * mapw) + uint(z) * uint(mapw * maph);
+}
+
+bool insideGrid(ivec3 p) {
+	return all(greaterThanEqual(p, ivec3(0))) && all(lessThan(p, ivec3(mapw, maph, mapd)));
+}
+
+uint testVoxel(ivec3 p) {
+	if (!insideGrid(p)) return 0u;
+
+	uint index = voxelIndex(p.x, p.y, p.z);
+	int bitsShift = findLSB(bitsPerVoxel);
+	uint wordShift = uint(5 - bitsShift);
+	uint shift = (index & ((1u << wordShift) - 1u)) << bitsShift;
+	uint mask = bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << bitsPerVoxel) - 1u;
+
+	return (data[index >> wordShift] >> shift) & mask;
+}
+
+uint hash(uvec3 p) {
+	uint h = u_Seed ^ (p.x * 73856093u) ^ (p.y * 19349663u) ^ (p.z * 83492791u);
+	h = (h ^ 61u) ^ (h >> 16);
+	h *= 9u;
+	h ^= h >> 4;
+	h *= 0x27d4eb2du;
+	h ^= h >> 15;
+	return h;
+}
+
+// Value noise in [0, 1]
+float valueNoise(vec3 p) {
+	vec3 cell = floor(p);
+	vec3 f = p - cell;
+	f = f * f * (3.0 - 2.0 * f);
+
+	uvec3 c = uvec3(ivec3(cell));
+	float v[8];
+	for (int i = 0; i < 8; i++) {
+		v[i] = float(hash(c + uvec3(i & 1, (i >> 1) & 1, i >> 2)) & 0xFFFFu) / 65535.0;
+	}
+	return mix(mix(mix(v[0], v[1], f.x), mix(v[2], v[3], f.x), f.y),
+	           mix(mix(v[4], v[5], f.x), mix(v[6], v[7], f.x), f.y), f.z);
+}
+
+float fbm(vec3 p) {
+	float sum = 0.0;
+	float amplitude = 0.5;
+	for (int octave = 0; octave < 3; octave++) {
+		sum += amplitude * valueNoise(p);
+		p *= 2.0;
+		amplitude *= 0.5;
+	}
+	return sum / 0.875;
+}
+
+bool insideBrush(ivec3 p) {
+	if (u_Shape == SHAPE_BOX) return true;
+
+	vec3 d = vec3(p) + 0.5 - u_Centre;
+	if (dot(d, d) > u_Radius * u_Radius) return false;
+	return u_Shape == SHAPE_SPHERE || fbm(vec3(p) * u_NoiseScale) > u_NoiseThreshold;
+}
+
+// Voxels sharing a word are written by different invocations, so the bits of a voxel are
+// cleared and set with atomics that leave the other voxels of the word alone
+void brushVoxel(ivec3 p) {
+	if (!insideGrid(p) || !insideBrush(p)) return;
+
+	uint index = voxelIndex(p.x, p.y, p.z);
+	int bitsShift = findLSB(bitsPerVoxel);
+	uint wordShift = uint(5 - bitsShift);
+	uint shift = (index & ((1u << wordShift) - 1u)) << bitsShift;
+	uint mask = bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << bitsPerVoxel) - 1u;
+	uint word = index >> wordShift;
+
+	uint old = (data[word] >> shift) & mask;
+	uint id = u_Id & mask;
+	if (old == id || (u_From >= 0 && old != uint(u_From))) return;
+
+	atomicAnd(data[word], ~(mask << shift));
+	atomicOr(data[word], id << shift);
+}
+
+// Same as computeLeafWord() and computeParentWord() in Occupancy.cpp
+void occupancyWord(ivec3 word) {
+	ivec4 info = occLevel[u_Level];
+	if (any(greaterThanEqual(word, info.xyz))) return;
+
+	uvec2 bits = uvec2(0u);
+	for (int i = 0; i < 64; i++) {
+		ivec3 child = word * 4 + ivec3(i & 3, (i >> 2) & 3, i >> 4);
+
+		bool solid;
+		if (u_Level == 0) {
+			solid = testVoxel(child) != 0u;
+		} else {
+			ivec4 below = occLevel[u_Level - 1];
+			solid = all(lessThan(child, below.xyz)) && occWords[below.w + child.x + below.x * (child.y + below.y * child.z)] != uvec2(0u);
+		}
+
+		if (solid) {
+			if (i < 32) bits.x |= 1u << i;
+			else bits.y |= 1u << (i - 32);
+		}
+	}
+	occWords[info.w + word.x + info.x * (word.y + info.y * word.z)] = bits;
+}
+
+// Same as scanColumn() and computeParentTop() in ColumnHeights.cpp
+void columnEntry(ivec2 entry) {
+	ivec4 info = columnLevel[u_Level];
+	if (any(greaterThanEqual(entry, info.xy))) return;
+
+	uint top = 0u;
+	if (u_Level == 0) {
+		for (int y = maph - 1; y >= 0; y--) {
+			if (testVoxel(ivec3(entry.x, y, entry.y)) != 0u) {
+				top = uint(y) + 1u;
+				break;
+			}
+		}
+	} else {
+		ivec4 below = columnLevel[u_Level - 1];
+		for (int i = 0; i < 4; i++) {
+			ivec2 child = entry * 2 + ivec2(i & 1, i >> 1);
+			if (all(lessThan(child, below.xy))) top = max(top, columnTops[below.w + child.x + below.x * child.y]);
+		}
+	}
+	columnTops[info.w + entry.x + info.x * entry.y] = top;
+}
+
+// An exact distance transform needs the whole neighbourhood, so the field is only lowered to the
+// distance to the edited box, which never exceeds the distance to the nearest new solid voxel.
+// Cells inside the box get 0 and are tested like solid ones.
+void lowerDistance(ivec3 p) {
+	if (!insideGrid(p)) return;
+
+	ivec3 outside = max(max(u_EditMin - p, p - u_EditMax), ivec3(0));
+	uint bound = uint(max(outside.x, max(outside.y, outside.z)));
+
+	uint index = uint(p.x + p.y * mapw) + uint(p.z) * uint(mapw * maph);
+	uint shift = (index & 3u) * 8u;
+	if (((distances[index >> 2] >> shift) & 0xFFu) <= bound) return;
+
+	atomicAnd(distances[index >> 2], ~(0xFFu << shift));
+	atomicOr(distances[index >> 2], bound << shift);
+}
+
+void main() {
+	ivec3 local = ivec3(gl_GlobalInvocationID);
+	if (any(greaterThanEqual(local, u_Size))) return;
+	ivec3 p = u_Min + local;
+
+	if (u_Pass == PASS_VOXELS) brushVoxel(p);
+	else if (u_Pass == PASS_OCCUPANCY) occupancyWord(p);
+	else if (u_Pass == PASS_COLUMNS) columnEntry(p.xz);
+	else if (u_Pass == PASS_DISTANCE) lowerDistance(p);
+}
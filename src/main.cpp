@@ -4,6 +4,8 @@
 // Only show a fullscreen rectangle, the voxel scene is rendered by a shader
 // GPU side : voxel scene rendering, fullscreen rectangle rendering
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -18,6 +20,15 @@
 
 #include "utils.h"
 #include "Structs.h"
+#include "Benchmark.h"
+#include "GpuBrush.h"
+#include "Heightmap.h"
+#include "RawVolume.h"
+#include "Vox.h"
+#include "VoxelEdit.h"
+#include "Wavefront.h"
+#include "WorldFile.h"
+#include "WorldGen.h"
 
 #include <random>
 
@@ -74,12 +85,56 @@ void cameraMouseCallback(GLFWwindow *window, const double posX, const double pos
 bool useFresnel = false;
 AppState* appStatePtr;
 
+const char* traversalNames[TRAVERSAL_COUNT] = { "DDA", "SVO", "Brickmap", "Occupancy", "Distance field", "Chunks", "DAG", "Columns" };
+
+// Left click adds a sphere of stone against the surface under the crosshair, right click digs one.
+// With shift the sphere is 64 voxels wide, with alt it is as wide and shaped by noise.
+void mouseButtonCallback(GLFWwindow*, int button, int action, int mods) {
+	if (paused || action != GLFW_PRESS)
+		return;
+
+	const bool add = button == GLFW_MOUSE_BUTTON_LEFT;
+	if (!add && button != GLFW_MOUSE_BUTTON_RIGHT)
+		return;
+
+	if (mods & GLFW_MOD_SHIFT)
+		appStatePtr->brush = add ? BRUSH_SCULPT_ADD : BRUSH_SCULPT_DIG;
+	else if (mods & GLFW_MOD_ALT)
+		appStatePtr->brush = add ? BRUSH_NOISE_ADD : BRUSH_NOISE_DIG;
+	else
+		appStatePtr->brush = add ? BRUSH_ADD : BRUSH_DIG;
+}
+
 void keyPressedCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
 
 	if (key == GLFW_KEY_P && action == GLFW_PRESS) {
 		appStatePtr->useSRGB = !appStatePtr->useSRGB;
 	}if (key == GLFW_KEY_O && action == GLFW_PRESS) {
 		appStatePtr->useACES = !appStatePtr->useACES;
+	}if (key == GLFW_KEY_T && action == GLFW_PRESS) {
+		appStatePtr->traversalMode = (appStatePtr->traversalMode + 1) % TRAVERSAL_COUNT;
+		std::cout << "Traversal : " << traversalNames[appStatePtr->traversalMode] << std::endl;
+		frameSinceLastReset = 0;
+	}if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+		// Cycles through 1 (every bounce gets the full budget), 0.75, 0.5 and 0.25
+		float falloff = appStatePtr->rayBudgets[0].bounceFalloff;
+		falloff = falloff <= 0.25f ? 1.0f : falloff - 0.25f;
+		for (RayBudget& budget : appStatePtr->rayBudgets) budget.bounceFalloff = falloff;
+		std::cout << "Bounce budget falloff : " << falloff << std::endl;
+		frameSinceLastReset = 0;
+	}if (key == GLFW_KEY_N && action == GLFW_PRESS) {
+		appStatePtr->countBudget = !appStatePtr->countBudget;
+	}if (key == GLFW_KEY_L && action == GLFW_PRESS) {
+		appStatePtr->sunShadows = !appStatePtr->sunShadows;
+		frameSinceLastReset = 0;
+	}if (key == GLFW_KEY_V && action == GLFW_PRESS && appStatePtr->wavefront.programs[WAVEFRONT_GENERATE] != 0) {
+		appStatePtr->useWavefront = !appStatePtr->useWavefront;
+		std::cout << "Renderer : " << (appStatePtr->useWavefront ? "wavefront" : "megakernel") << std::endl;
+		frameSinceLastReset = 0;
+	}if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+		// Only changes the order the wavefront traces its rays in, not the image
+		appStatePtr->wavefront.sortRays = !appStatePtr->wavefront.sortRays;
+		std::cout << "Ray sorting : " << (appStatePtr->wavefront.sortRays ? "on" : "off") << std::endl;
 	}
 
 
@@ -137,7 +192,7 @@ void keyPressedCallback(GLFWwindow* window, int key, int scancode, int action, i
 
 
 void initCamera() {
-	camera.position = glm::vec3(0.0f, 0.5f, -5.0f);
+	camera.position = glm::vec3(128.0f, 110.0f, -30.0f);
 	camera.direction = glm::vec3(0.0f, 0.0f, 1.0f);
 	camera.rotationX = 0.0f;
 	camera.rotationY = 0.0f;
@@ -159,6 +214,22 @@ std::string loadFile(std::string filename) {
 	return buffer.str();
 }
 
+// Loads a shader, replacing every #include "file" line with the file, taken from the same directory
+std::string loadShader(std::string filename) {
+	const std::string directory = filename.substr(0, filename.find_last_of('/') + 1);
+	std::stringstream source(loadFile(filename));
+	std::string expanded, line;
+	while (std::getline(source, line)) {
+		const size_t quote = line.find('"');
+		if (line.rfind("#include", 0) == 0 && quote != std::string::npos) {
+			expanded += loadShader(directory + line.substr(quote + 1, line.find('"', quote + 1) - quote - 1));
+		} else {
+			expanded += line + "\n";
+		}
+	}
+	return expanded;
+}
+
 void updateCamera(float deltaTime) {
 	const float cameraSpeed = 5.0f * deltaTime;
 	if (camera.keys.w)
@@ -249,8 +320,152 @@ void initFrameBuffer(Framebuffer& buff) {
 	glBindFramebuffer(GL_FRAMEBUFFER, 0);
 }
 
-int main() {
-	srand(time(NULL));
+// (Re)allocates the voxel SSBO to fit the header and the packed grid, then uploads both
+void uploadShaderData(GLuint ssbo, const shader_data& s_data, const VoxelGrid& grid) {
+	const GLsizeiptr size = sizeof(shader_data) + voxelGridBytes(grid);
+
+	GLint64 maxBlockSize = 0;
+	glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBlockSize);
+	if (size > maxBlockSize) {
+		std::cerr << "Voxel data (" << size << " bytes) exceeds GL_MAX_SHADER_STORAGE_BLOCK_SIZE (" << maxBlockSize << " bytes)" << std::endl;
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(shader_data), &s_data);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(shader_data), voxelGridBytes(grid), grid.words.data());
+}
+
+void uploadOctree(GLuint ssbo, const SparseVoxelOctree& svo) {
+	const int header[2] = { svo.size, svo.depth };
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(header) + octreeBytes(svo), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(header), octreeBytes(svo), svo.nodes.data());
+}
+
+// The buffer has room for a quarter more bricks than the pool holds, so that edits can add bricks
+// through updateBrickmap() before it needs uploading again. Returns that room in pool words.
+size_t uploadBrickmap(GLuint ssbo, const Brickmap& brickmap) {
+	const int header[4] = { brickmap.width, brickmap.height, brickmap.depth, brickmap.wordsPerBrick };
+	const size_t cellBytes = brickmap.cells.size() * sizeof(uint32_t);
+	const size_t poolCapacity = brickmap.pool.size() + (brickmap.pool.size() / brickmap.wordsPerBrick / 4 + 64) * brickmap.wordsPerBrick;
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(header) + cellBytes + poolCapacity * sizeof(uint32_t), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), header);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(header), cellBytes, brickmap.cells.data());
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(header) + cellBytes, brickmap.pool.size() * sizeof(uint32_t), brickmap.pool.data());
+	return poolCapacity;
+}
+
+void uploadOccupancy(GLuint ssbo, const OccupancyPyramid& occupancy) {
+	occupancy_header header = {};
+	header.levels = occupancy.levels;
+	for (int i = 0; i < occupancy.levels; i++) {
+		header.level[i] = glm::ivec4(occupancy.dims[i], (int)occupancy.offsets[i]);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(header) + occupancyBytes(occupancy), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(header), occupancyBytes(occupancy), occupancy.words.data());
+}
+
+void uploadColumnHeights(GLuint ssbo, const ColumnHeights& columns) {
+	column_header header = {};
+	header.levels = columns.levels;
+	for (int i = 0; i < columns.levels; i++) {
+		header.level[i] = glm::ivec4(columns.dims[i], 0, (int)columns.offsets[i]);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(header) + columnHeightsBytes(columns), nullptr, GL_DYNAMIC_DRAW);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(header), &header);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, sizeof(header), columnHeightsBytes(columns), columns.tops.data());
+}
+
+int main(int argc, char** argv) {
+	if (argc > 2 && std::string(argv[1]) == "--bench") {
+		return runBenchmark(argv[2], argc > 3 ? atoi(argv[3]) : 0);
+	}
+	if (argc > 4 && std::string(argv[1]) == "--build-dag") {
+		return buildDagFile(argv[2], argv[3], atoi(argv[4]));
+	}
+
+	uint32_t seed = (uint32_t)time(NULL);
+	std::string dagPath;
+	std::string worldPath;
+	std::string voxPath;
+	std::string heightmapPath;
+	// Overrides of defaultRayBudget(), when positive
+	int maxSteps = 0;
+	float maxDistance = 0.0f;
+	float bounceFalloff = 0.0f;
+	bool useWavefront = false;
+	bool sortRays = false;
+	for (int i = 1; i < argc; i++) {
+		if (std::string(argv[i]) == "--wavefront") useWavefront = true;
+		if (std::string(argv[i]) == "--sort-rays") sortRays = true;
+		if (i + 1 == argc) break;
+
+		if (std::string(argv[i]) == "--seed") seed = (uint32_t)strtoul(argv[i + 1], nullptr, 10);
+		if (std::string(argv[i]) == "--dag") dagPath = argv[i + 1];
+		if (std::string(argv[i]) == "--world") worldPath = argv[i + 1];
+		if (std::string(argv[i]) == "--vox") voxPath = argv[i + 1];
+		if (std::string(argv[i]) == "--heightmap") heightmapPath = argv[i + 1];
+		if (std::string(argv[i]) == "--max-steps") maxSteps = atoi(argv[i + 1]);
+		if (std::string(argv[i]) == "--max-distance") maxDistance = (float)atof(argv[i + 1]);
+		if (std::string(argv[i]) == "--bounce-falloff") bounceFalloff = (float)atof(argv[i + 1]);
+	}
+
+	// Offline world writer, the file is then opened with --world
+	if (argc > 5 && std::string(argv[1]) == "--write-world") {
+		WorldGenParams params;
+		params.seed = seed;
+		const glm::ivec3 dims(atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
+
+		ThreadPool pool;
+		initThreadPool(pool);
+		const auto start = std::chrono::steady_clock::now();
+		const bool written = writeWorldFile(argv[2], params, glm::ivec3(0), dims, pool);
+		destroyThreadPool(pool);
+		if (!written) return -1;
+
+		WorldFile file;
+		if (!openWorldFile(file, argv[2])) return -1;
+		std::cout << "World file : " << dims.x << "x" << dims.y << "x" << dims.z << " chunks, " << file.mapping.size / (1 << 20) << " MiB, written in "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s" << std::endl;
+		closeWorldFile(file);
+		return 0;
+	}
+
+	// Offline classification of a raw volume into a world file, the bytes per sample are 1, 2,
+	// or 2be for big-endian 16-bit samples
+	if (argc > 8 && std::string(argv[1]) == "--ingest-raw") {
+		const glm::ivec3 dims(atoi(argv[3]), atoi(argv[4]), atoi(argv[5]));
+		const std::string format = argv[6];
+		std::vector<uint32_t> thresholds;
+		for (int i = 8; i < argc; i++) thresholds.push_back((uint32_t)strtoul(argv[i], nullptr, 10));
+
+		RawVolume volume;
+		if (!openRawVolume(volume, argv[2], dims, atoi(format.c_str()), format == "2be"))
+			return -1;
+
+		ThreadPool pool;
+		initThreadPool(pool);
+		const auto start = std::chrono::steady_clock::now();
+		const bool written = ingestRawVolume(argv[7], volume, thresholds, pool);
+		const int threads = threadCount(pool);
+		destroyThreadPool(pool);
+		closeRawVolume(volume);
+		if (!written) return -1;
+
+		std::cout << "Ingested " << argv[2] << " : " << dims.x << "x" << dims.y << "x" << dims.z << ", " << thresholds.size() << " classes in "
+			<< std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() << " s on " << threads << " threads" << std::endl;
+		return 0;
+	}
 
 	AppState appState;
 	appStatePtr = &appState;
@@ -293,7 +508,7 @@ int main() {
 	// Loading the shaders and checking for compilation errors
 
 	std::string vertexShaderSource = loadFile("../../src/vertex.glsl");
-	std::string fragmentShaderSource = loadFile("../../src/fragment.glsl");
+	std::string fragmentShaderSource = loadShader("../../src/fragment.glsl");
 	std::string quadFragShaderSource = loadFile("../../src/quad_frag.glsl");
 
 	// TODO: 
@@ -350,26 +565,192 @@ int main() {
 	glDeleteShader(fragmentShader);
 	glDeleteShader(quad_fragmentShader);
 
+	appState.brushProgram = createGpuBrushProgram(loadFile("../../src/brush_comp.glsl"));
+
+	// Falls back to the megakernel when the compute path tracer is not available
+	appState.useWavefront = initWavefront(appState.wavefront, loadShader("../../src/wavefront_comp.glsl"), width, height) && useWavefront;
+	appState.wavefront.sortRays = sortRays;
+
 	// Init shader storage buffer
 
-	shader_data s_data = { 15, 15, 15};
-	for (int i = 0; i < s_data.mapw; i++) {
-		for (int j = 0; j < s_data.maph; j++) {
-			for (int k = 0; k < s_data.mapd; k++) {
-				s_data.data[i + s_data.mapw * j + s_data.mapw * s_data.maph * k] = (rand() % 9 + 1) * ((i==0||i== s_data.mapw-1||j==0||j== s_data.maph-1||k==0||k== s_data.mapd-1) || (rand() % 10 == 0));
-			}
+	VoxelGrid grid;
+	if (!initVoxelGrid(grid, 256, 128, 256, 8, VOXEL_LAYOUT_MORTON))
+		return -1;
+
+	WorldGenParams worldGen;
+	worldGen.seed = seed;
+	std::cout << "Seed : " << worldGen.seed << std::endl;
+
+	ThreadPool threadPool;
+	initThreadPool(threadPool);
+
+	shader_data s_data = {};
+	s_data.mapw = grid.width;
+	s_data.maph = grid.height;
+	s_data.mapd = grid.depth;
+	s_data.bitsPerVoxel = grid.bitsPerVoxel;
+	s_data.layout = grid.layout;
+	s_data.strideShiftY = grid.strideShiftY;
+	s_data.strideShiftZ = grid.strideShiftZ;
+
+	// A MagicaVoxel scene replaces the terrain: in the grid when it fits, otherwise converted
+	// to a world file next to it which the chunked world pages in
+	if (!voxPath.empty()) {
+		VoxScene scene;
+		double loadStart = glfwGetTime();
+		if (!openVox(scene, voxPath))
+			return -1;
+		std::copy(scene.palette, scene.palette + PALETTE_SIZE, s_data.palette);
+
+		if (glm::all(glm::lessThanEqual(scene.size, glm::ivec3(grid.width, grid.height, grid.depth)))) {
+			const glm::ivec3 offset((grid.width - scene.size.x) / 2, 0, (grid.depth - scene.size.z) / 2);
+			if (!loadVox(grid, scene, offset))
+				return -1;
+		} else {
+			worldPath = voxPath + ".vxw";
+			if (!writeVoxWorldFile(worldPath, scene, threadPool))
+				return -1;
+			appState.traversalMode = TRAVERSAL_CHUNKS;
+			std::cout << "Scene larger than the grid, written to " << worldPath << std::endl;
 		}
+		std::cout << "Loaded " << voxPath << " : " << scene.size.x << "x" << scene.size.y << "x" << scene.size.z << ", "
+			<< scene.models.size() << " models, " << scene.instances.size() << " instances in " << (glfwGetTime() - loadStart) * 1000.0 << " ms" << std::endl;
 	}
-	for (int i = 0; i < 10; i++) {
-		s_data.palette[i] = glm::vec3(rand() / (float)RAND_MAX, rand() / (float)RAND_MAX, rand() / (float)RAND_MAX);
+
+	WorldFile worldFile;
+	if (!worldPath.empty()) {
+		double openStart = glfwGetTime();
+		if (!openWorldFile(worldFile, worldPath))
+			return -1;
+
+		const glm::ivec3 dims = glm::ivec3(worldFile.header->dims);
+		std::cout << "World file : " << dims.x << "x" << dims.y << "x" << dims.z << " chunks, " << worldFile.mapping.size / (1 << 20) << " MiB, opened in "
+			<< (glfwGetTime() - openStart) * 1000.0 << " ms" << std::endl;
+	}
+
+	// A world file with its own palette is imported data, not terrain: the grid shows an
+	// overview of it made from the mips stored in the file
+	if (voxPath.empty() && !worldPath.empty() && worldFilePalette(worldFile) != nullptr) {
+		std::copy(worldFilePalette(worldFile), worldFilePalette(worldFile) + PALETTE_SIZE, s_data.palette);
+		const int level = loadWorldFileMip(grid, worldFile);
+		if (level >= 0) std::cout << "Overview : 1 voxel per " << (1ull << level) << "^3 voxels of the world file" << std::endl;
+	} else if (voxPath.empty() && !heightmapPath.empty()) {
+		Heightmap heightmap;
+		double loadStart = glfwGetTime();
+		if (!loadHeightmap(heightmap, heightmapPath))
+			return -1;
+		loadHeightmapTerrain(grid, heightmap, worldGen, threadPool);
+		std::cout << "Loaded " << heightmapPath << " : " << heightmap.width << "x" << heightmap.depth << " in " << (glfwGetTime() - loadStart) * 1000.0 << " ms" << std::endl;
+
+		worldGenPalette(s_data.palette);
+		appState.traversalMode = TRAVERSAL_COLUMNS;
+	} else if (voxPath.empty()) {
+		double generationStart = glfwGetTime();
+		if (!generateWorld(grid, worldGen, threadPool))
+			return -1;
+		std::cout << "World generated in " << (glfwGetTime() - generationStart) * 1000.0 << " ms on " << threadCount(threadPool) << " threads" << std::endl;
+
+		worldGenPalette(s_data.palette);
 	}
 
 	glGenBuffers(1, &appState.ssbo);
-	glBindBuffer(GL_SHADER_STORAGE_BUFFER, appState.ssbo);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(shader_data), &s_data, GL_DYNAMIC_DRAW);
+	uploadShaderData(appState.ssbo, s_data, grid);
+	clearDirtyVoxels(grid);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, appState.ssbo);
+
+	SparseVoxelOctree svo;
+	buildOctree(svo, grid);
+
+	glGenBuffers(1, &appState.svoSsbo);
+	uploadOctree(appState.svoSsbo, svo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, appState.svoSsbo);
+
+	// The DAG comes from the grid, or from a file made by --build-dag, which is then never rebuilt
+	SparseVoxelOctree dag;
+	double dagStart = glfwGetTime();
+	if (dagPath.empty()) {
+		buildDag(dag, grid);
+	} else if (!loadDag(dag, dagPath)) {
+		return -1;
+	}
+	const double dagMs = (glfwGetTime() - dagStart) * 1000.0;
+
+	glGenBuffers(1, &appState.dagSsbo);
+	uploadOctree(appState.dagSsbo, dag);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, appState.dagSsbo);
+
+	Brickmap brickmap;
+	buildBrickmap(brickmap, grid);
+
+	glGenBuffers(1, &appState.brickmapSsbo);
+	size_t brickPoolCapacity = uploadBrickmap(appState.brickmapSsbo, brickmap);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, appState.brickmapSsbo);
+
+	OccupancyPyramid occupancy;
+	buildOccupancy(occupancy, grid);
+
+	glGenBuffers(1, &appState.occupancySsbo);
+	uploadOccupancy(appState.occupancySsbo, occupancy);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, appState.occupancySsbo);
+
+	ColumnHeights columns;
+	buildColumnHeights(columns, grid, threadPool);
+
+	glGenBuffers(1, &appState.columnSsbo);
+	uploadColumnHeights(appState.columnSsbo, columns);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, appState.columnSsbo);
+
+	DistanceField distanceField;
+	buildDistanceField(distanceField, grid);
+
+	glGenBuffers(1, &appState.distanceSsbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, appState.distanceSsbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, distanceFieldBytes(distanceField), distanceField.distances.data(), GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, appState.distanceSsbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	const budget_counters noBudgetCounts = {};
+	glGenBuffers(1, &appState.budgetSsbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, appState.budgetSsbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(budget_counters), &noBudgetCounts, GL_DYNAMIC_READ);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, appState.budgetSsbo);
 	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
+	// The chunked world pages its own chunks around the camera, with the same terrain as the grid
+	ChunkWorld chunkWorld;
+	if (!initChunkWorld(chunkWorld, worldGen, (float)grid.height, glm::ivec3(5, 2, 5)))
+		return -1;
+
+	// With a world file, the chunked world pages its chunks from the file instead
+	if (!worldPath.empty()) chunkWorld.file = &worldFile;
+
+	// Sized from the structure each traversal walks, a DAG from --dag can be much larger than the grid
+	for (int mode = 0; mode < TRAVERSAL_COUNT; mode++) {
+		glm::ivec3 extent(grid.width, grid.height, grid.depth);
+		if (mode == TRAVERSAL_SVO) extent = glm::ivec3(svo.size);
+		if (mode == TRAVERSAL_DAG) extent = glm::ivec3(dag.size);
+		if (mode == TRAVERSAL_CHUNKS) extent = chunkWorld.dims * CHUNK_SIZE;
+
+		RayBudget& budget = appState.rayBudgets[mode];
+		budget = defaultRayBudget(extent);
+		if (maxSteps > 0) budget.maxSteps = maxSteps;
+		if (maxDistance > 0) budget.maxDistance = maxDistance;
+		if (bounceFalloff > 0) budget.bounceFalloff = bounceFalloff;
+	}
+
+	glGenBuffers(1, &appState.chunkSsbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, appState.chunkSsbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(chunk_header) + chunkTableBytes(chunkWorld) + chunkRecordBytes(chunkWorld) + chunkPoolBytes(chunkWorld), nullptr, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, appState.chunkSsbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	std::cout << "SVO : " << svo.nodes.size() << " nodes, " << octreeBytes(svo) << " bytes (grid : " << voxelGridBytes(grid) << " bytes)" << std::endl;
+	std::cout << "DAG : " << dag.nodes.size() << " nodes, " << octreeBytes(dag) << " bytes, 1:" << (double)dagTreeNodes(dag) / dag.nodes.size()
+		<< " against the SVO, " << (dagPath.empty() ? "built" : "loaded") << " in " << dagMs << " ms" << std::endl;
+	std::cout << "Columns : " << columns.levels << " levels, " << columnHeightsBytes(columns) << " bytes" << std::endl;
+	std::cout << "Brickmap : " << brickmap.pool.size() / brickmap.wordsPerBrick << " bricks, " << brickmapBytes(brickmap) << " bytes" << std::endl;
+	std::cout << "Chunks : " << chunkWorld.dims.x << "x" << chunkWorld.dims.y << "x" << chunkWorld.dims.z << " window, " << chunkWorld.pageCount << " pages, " << chunkTableBytes(chunkWorld) + chunkRecordBytes(chunkWorld) + chunkPoolBytes(chunkWorld) << " bytes" << std::endl;
+
 	// Init the frame buffers
 
 	Framebuffer *fb1 = &appState.fb1;
@@ -380,7 +761,16 @@ int main() {
 
 	// Init the camera
 	
-	bool s_data_changed = false;
+	EditQueue edits;
+	bool hierarchiesStale = false;
+	// Brushes waiting for the GPU, and the boxes they edited that the grid has not caught up with
+	std::vector<GpuBrush> gpuBrushes;
+	std::vector<VoxelBox> gpuEdited;
+	DirtySpans headerDirty;
+	chunk_header chunkHeader = {};
+	DirtySpans chunkHeaderDirty;
+
+	initUploadRing(appState.uploadRing, 4 << 20);
 
 	int spp = 1;
 	int bounces = 30;
@@ -393,6 +783,7 @@ int main() {
 
 	glfwSetCursorPosCallback(appState.window, cameraMouseCallback);
 	glfwSetKeyCallback(appState.window, keyPressedCallback);
+	glfwSetMouseButtonCallback(appState.window, mouseButtonCallback);
 
 	float lastTime = glfwGetTime();
 	float lastTimeFPS = glfwGetTime();
@@ -409,7 +800,25 @@ int main() {
 
 		frameCount++;
 		if (currentTime > lastTimeFPS + 1) {
-			std::cout << "FPS : " << frameCount << std::endl << "SPP : " << spp << std::endl << std::endl;
+			std::cout << "FPS : " << frameCount << std::endl << "SPP : " << spp << std::endl;
+			if (appState.countBudget) {
+				// Share of the rays of every bounce that ran out of budget since the last print
+				budget_counters counts;
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, appState.budgetSsbo);
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counts), &counts);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(noBudgetCounts), &noBudgetCounts);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+				uint64_t rays = 0, exhausted = 0;
+				std::cout << "Out of budget :";
+				for (int i = 0; i < BUDGET_COUNTED_BOUNCES && counts.rays[i] > 0; i++) {
+					rays += counts.rays[i];
+					exhausted += counts.exhausted[i];
+					std::cout << " " << 100.0 * counts.exhausted[i] / counts.rays[i] << "%";
+				}
+				std::cout << " per bounce, " << (rays > 0 ? 100.0 * exhausted / rays : 0.0) << "% of " << rays << " rays" << std::endl;
+			}
+			std::cout << std::endl;
 			frameCount = 0;
 			lastTimeFPS = currentTime;
 		}
@@ -434,18 +843,146 @@ int main() {
 
 		glViewport(0, 0, fb1->width, fb1->height);
 
-		glUseProgram(appState.shader);
-
 		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, appState.ssbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, appState.svoSsbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, appState.brickmapSsbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, appState.occupancySsbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, appState.distanceSsbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, appState.chunkSsbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 8, appState.dagSsbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 9, appState.columnSsbo);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 10, appState.budgetSsbo);
+
+		// Page chunks in and out around the camera while the chunked world is displayed
+		if (appState.traversalMode == TRAVERSAL_CHUNKS) {
+			if (updateChunkWorld(chunkWorld, camera.position, deltaTime, threadPool) > 0) frameSinceLastReset = 0;
+
+			// Brushes edit the chunks themselves, on the CPU: the GPU brushes only know the grid, so
+			// they become plain spheres of their size
+			if (appState.brush != BRUSH_NONE) {
+				glm::ivec3 hit, before;
+				if (raycastChunkWorld(chunkWorld, camera.position, camera.front, 256.0f, hit, before)) {
+					const bool add = appState.brush == BRUSH_ADD || appState.brush == BRUSH_SCULPT_ADD || appState.brush == BRUSH_NOISE_ADD;
+					const float radius = appState.brush == BRUSH_ADD || appState.brush == BRUSH_DIG ? 3.0f : 32.0f;
+					if (fillChunkWorldSphere(chunkWorld, glm::vec3(add ? before : hit) + 0.5f, radius, add ? BLOCK_STONE : BLOCK_AIR) > 0) frameSinceLastReset = 0;
+				}
+				appState.brush = BRUSH_NONE;
+			}
+		}
+		if (!chunkWorld.tableDirty.spans.empty()) {
+			chunkHeader.origin = glm::ivec4(chunkWorld.origin, chunkWorld.slotCount);
+			chunkHeader.dims = glm::ivec4(chunkWorld.dims, chunkWorld.pageCount);
+			markDirty(chunkHeaderDirty, 0, sizeof(chunk_header));
+		}
 
-		if (s_data_changed) {
+		// The grid catches up with the GPU brushes before anything reads it. The occupancy and the
+		// column heights are recomputed again here only so that the CPU copies match, the distance
+		// field however becomes exact again instead of conservative: the whole reach the brush
+		// lowered goes up again, as the CPU copy cannot tell those cells from the unchanged ones.
+		const bool gridNeeded = appState.brush != BRUSH_NONE || hasQueuedEdits(edits) || appState.traversalMode == TRAVERSAL_BRICKMAP
+			|| (hierarchiesStale && (appState.traversalMode == TRAVERSAL_SVO || appState.traversalMode == TRAVERSAL_DAG));
+		if (gridNeeded && !gpuEdited.empty()) {
+			for (const VoxelBox& box : gpuEdited) {
+				readBackVoxels(appState.ssbo, sizeof(shader_data), grid, box);
+				updateOccupancy(occupancy, grid, box.min, box.max);
+				updateColumnHeights(columns, grid, box.min, box.max);
+				updateDistanceField(distanceField, grid, box.min, box.max);
+				markDistanceFieldReach(distanceField, box.min, box.max);
+				updateBrickmap(brickmap, grid, box.min, box.max);
+			}
+			gpuEdited.clear();
+
+			// The brickmap, octree and DAG only catch up with the brushes now, so the samples traced
+			// through them before are dropped
+			if (appState.traversalMode == TRAVERSAL_BRICKMAP || appState.traversalMode == TRAVERSAL_SVO || appState.traversalMode == TRAVERSAL_DAG) {
+				frameSinceLastReset = 0;
+			}
+		}
+
+		if (appState.brush != BRUSH_NONE) {
+			glm::ivec3 hit, before;
+			if (raycastGrid(grid, camera.position, camera.front, 256.0f, hit, before)) {
+				const glm::vec3 addCentre = glm::vec3(before) + 0.5f, digCentre = glm::vec3(hit) + 0.5f;
+				switch (appState.brush) {
+				case BRUSH_ADD: queueFillSphere(edits, addCentre, 3.0f, BLOCK_STONE); break;
+				case BRUSH_DIG: queueFillSphere(edits, digCentre, 3.0f, BLOCK_AIR); break;
+				case BRUSH_SCULPT_ADD: gpuBrushes.push_back(sphereGpuBrush(addCentre, 32.0f, BLOCK_STONE)); break;
+				case BRUSH_SCULPT_DIG: gpuBrushes.push_back(sphereGpuBrush(digCentre, 32.0f, BLOCK_AIR)); break;
+				case BRUSH_NOISE_ADD: gpuBrushes.push_back(noiseGpuBrush(addCentre, 32.0f, BLOCK_STONE, 0.08f, 0.55f, (uint32_t)frame)); break;
+				case BRUSH_NOISE_DIG: gpuBrushes.push_back(noiseGpuBrush(digCentre, 32.0f, BLOCK_AIR, 0.08f, 0.45f, (uint32_t)frame)); break;
+				}
+			}
+			appState.brush = BRUSH_NONE;
+		}
 
-			glBindBuffer(GL_SHADER_STORAGE_BUFFER, appState.ssbo);
-			GLvoid* p = glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_WRITE_ONLY);
-			memcpy(p, &s_data, sizeof(shader_data));
-			glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+		// Everything edited since the last frame is committed at once, and only the derived data
+		// in the merged boxes of the edits is recomputed
+		if (hasQueuedEdits(edits)) {
+			for (const VoxelBox& box : commitEdits(edits, grid)) {
+				updateOccupancy(occupancy, grid, box.min, box.max);
+				updateColumnHeights(columns, grid, box.min, box.max);
+				updateDistanceField(distanceField, grid, box.min, box.max);
+				updateBrickmap(brickmap, grid, box.min, box.max);
+				hierarchiesStale = true;
+				frameSinceLastReset = 0;
+			}
+			clearDirtyBox(grid);
+		}
 
-			s_data_changed = false;
+		// Stream what changed through the upload ring, all of it in one frame so that the derived
+		// structures never get ahead of the voxels they were computed from. When the ring has no
+		// free slot yet, everything stays dirty and goes up with the next frame's changes.
+		const size_t uploadBytes = stagedBytes(headerDirty) + stagedBytes(grid.dirty) + stagedBytes(occupancy.dirty) + stagedBytes(columns.dirty)
+			+ stagedBytes(distanceField.dirty) + stagedBytes(brickmap.cellsDirty) + stagedBytes(brickmap.poolDirty) + stagedBytes(chunkWorld.poolDirty)
+			+ stagedBytes(chunkWorld.recordsDirty) + stagedBytes(chunkWorld.tableDirty) + stagedBytes(chunkHeaderDirty);
+		if (uploadBytes > 0 && beginUploadFrame(appState.uploadRing, uploadBytes)) {
+			stageDirtySpans(appState.uploadRing, appState.ssbo, 0, &s_data, headerDirty);
+			stageDirtySpans(appState.uploadRing, appState.ssbo, sizeof(shader_data), grid.words.data(), grid.dirty);
+			stageDirtySpans(appState.uploadRing, appState.occupancySsbo, sizeof(occupancy_header), occupancy.words.data(), occupancy.dirty);
+			stageDirtySpans(appState.uploadRing, appState.columnSsbo, sizeof(column_header), columns.tops.data(), columns.dirty);
+			stageDirtySpans(appState.uploadRing, appState.distanceSsbo, 0, distanceField.distances.data(), distanceField.dirty);
+			if (brickmap.pool.size() > brickPoolCapacity) {
+				brickPoolCapacity = uploadBrickmap(appState.brickmapSsbo, brickmap);
+				brickmap.cellsDirty.spans.clear();
+				brickmap.poolDirty.spans.clear();
+			}
+			stageDirtySpans(appState.uploadRing, appState.brickmapSsbo, 4 * sizeof(int), brickmap.cells.data(), brickmap.cellsDirty);
+			stageDirtySpans(appState.uploadRing, appState.brickmapSsbo, 4 * sizeof(int) + brickmap.cells.size() * sizeof(uint32_t), brickmap.pool.data(), brickmap.poolDirty);
+			stageDirtySpans(appState.uploadRing, appState.chunkSsbo, sizeof(chunk_header) + chunkTableBytes(chunkWorld) + chunkRecordBytes(chunkWorld), chunkWorld.pool.data(), chunkWorld.poolDirty);
+			stageDirtySpans(appState.uploadRing, appState.chunkSsbo, sizeof(chunk_header) + chunkTableBytes(chunkWorld), chunkWorld.records.data(), chunkWorld.recordsDirty);
+			stageDirtySpans(appState.uploadRing, appState.chunkSsbo, sizeof(chunk_header), chunkWorld.table.data(), chunkWorld.tableDirty);
+			stageDirtySpans(appState.uploadRing, appState.chunkSsbo, 0, &chunkHeader, chunkHeaderDirty);
+			endUploadFrame(appState.uploadRing);
+		}
+
+		// A GPU brush waits until nothing it writes is still to be uploaded from the CPU copies,
+		// which would otherwise overwrite it. The brickmap, octree and DAG are built from the CPU
+		// grid, so they only see the brush once it is read back at the start of the next frame:
+		// the frame of the brush still traces them as they were before it. Reading it back here
+		// instead would stall on the brush and need a second upload batch in the frame.
+		const bool uploadsPending = !grid.dirty.spans.empty() || !occupancy.dirty.spans.empty() || !columns.dirty.spans.empty() || !distanceField.dirty.spans.empty();
+		if (!gpuBrushes.empty() && !uploadsPending && appState.brushProgram != 0) {
+			for (const GpuBrush& brush : gpuBrushes) {
+				VoxelBox box;
+				if (!dispatchGpuBrush(appState.brushProgram, brush, grid, occupancy, columns, box)) continue;
+				gpuEdited.push_back(box);
+				hierarchiesStale = true;
+				frameSinceLastReset = 0;
+			}
+			gpuBrushes.clear();
+		}
+
+		// The octree and the DAG are rebuilt as a whole, so only when they are in use, and from a
+		// grid that has caught up with the GPU brushes
+		if (hierarchiesStale && gpuEdited.empty() && (appState.traversalMode == TRAVERSAL_SVO || appState.traversalMode == TRAVERSAL_DAG)) {
+			if (dagPath.empty()) {
+				buildDag(dag, grid);
+				uploadOctree(appState.dagSsbo, dag);
+			}
+			buildOctree(svo, grid);
+			uploadOctree(appState.svoSsbo, svo);
+
+			hierarchiesStale = false;
 		}
 
 		camera.projection = glm::perspective(glm::radians(70.0f ), (float)width / (float)height, 0.1f, 100.0f);
@@ -454,32 +991,52 @@ int main() {
 		// First Pass
 		// TODO: Create the quad shader, make second and first pass, edit the fragment shader to do framebuffer.
 
-		// Draw the main quad
+		// Draw the main quad, or trace the frame with the wavefront kernels. All of them read the
+		// same uniforms, which are set on each program of the wavefront stages.
+		const GLuint* tracers = appState.useWavefront ? appState.wavefront.programs : &appState.shader;
+		const int tracerCount = appState.useWavefront ? WAVEFRONT_STAGE_COUNT : 1;
+		const RayBudget& rayBudget = appState.rayBudgets[appState.traversalMode];
+		for (int i = 0; i < tracerCount; i++) {
+			const GLuint tracer = tracers[i];
+			glUseProgram(tracer);
 
-		setUniformV2(appState.shader, "u_Resolution", glm::vec2(fb1->width, fb1->height));
-		setUniformF(appState.shader, "u_Time", glfwGetTime());
+			setUniformV2(tracer, "u_Resolution", glm::vec2(fb1->width, fb1->height));
+			setUniformF(tracer, "u_Time", glfwGetTime());
 
-		setUniformM4(appState.shader, "u_InverseView", glm::inverse(camera.view));
-		setUniformM4(appState.shader, "u_InverseProjection", glm::inverse(camera.projection));
+			setUniformM4(tracer, "u_InverseView", glm::inverse(camera.view));
+			setUniformM4(tracer, "u_InverseProjection", glm::inverse(camera.projection));
 
-		setUniformInt(appState.shader, "useFresnel", useFresnel);
-		
-		setUniformInt(appState.shader, "u_SPP", spp);
-		setUniformInt(appState.shader, "u_Bounces", bounces);
+			setUniformInt(tracer, "useFresnel", useFresnel);
+			setUniformInt(tracer, "u_TraversalMode", appState.traversalMode);
 
-		setUniformInt(appState.shader, "u_FrameSinceLastReset", frameSinceLastReset);
+			setUniformInt(tracer, "u_SPP", spp);
+			setUniformInt(tracer, "u_Bounces", bounces);
+
+			setUniformInt(tracer, "u_MaxSteps", rayBudget.maxSteps);
+			setUniformF(tracer, "u_MaxDistance", rayBudget.maxDistance);
+			setUniformF(tracer, "u_BounceFalloff", rayBudget.bounceFalloff);
+			setUniformInt(tracer, "u_MinSteps", rayBudget.minSteps);
+			setUniformF(tracer, "u_MinDistance", rayBudget.minDistance);
+			setUniformInt(tracer, "u_CountBudget", appState.countBudget);
+			setUniformInt(tracer, "u_SunShadows", appState.sunShadows);
+
+			setUniformInt(tracer, "u_FrameSinceLastReset", frameSinceLastReset);
+
+			setUniformInt(tracer, "u_LastColors", 0);
+			setUniformInt(tracer, "u_LastBloom", 1);
+		}
 
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, fb2->colorTexture);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, fb2->bloomTexture);
 
-		setUniformInt(appState.shader, "u_LastColors", 0);
-		setUniformInt(appState.shader, "u_LastBloom", 1);
-
-		glClear(GL_COLOR_BUFFER_BIT);
-
-		glDrawArrays(GL_TRIANGLES, 0, 6);
+		if (appState.useWavefront) {
+			traceWavefront(appState.wavefront, fb1->colorTexture, fb1->bloomTexture, spp, bounces);
+		} else {
+			glClear(GL_COLOR_BUFFER_BIT);
+			glDrawArrays(GL_TRIANGLES, 0, 6);
+		}
 
 		//glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
 
@@ -522,7 +1079,20 @@ int main() {
 	glDeleteVertexArrays(1, &appState.vao);
 	glDeleteBuffers(1, &appState.vbo);
 	glDeleteProgram(appState.shader);
+	glDeleteProgram(appState.brushProgram);
+	destroyWavefront(appState.wavefront);
 	glDeleteBuffers(1, &appState.ssbo);
+	glDeleteBuffers(1, &appState.svoSsbo);
+	glDeleteBuffers(1, &appState.brickmapSsbo);
+	glDeleteBuffers(1, &appState.occupancySsbo);
+	glDeleteBuffers(1, &appState.columnSsbo);
+	glDeleteBuffers(1, &appState.budgetSsbo);
+	glDeleteBuffers(1, &appState.distanceSsbo);
+	glDeleteBuffers(1, &appState.chunkSsbo);
+	glDeleteBuffers(1, &appState.dagSsbo);
+	destroyUploadRing(appState.uploadRing);
+	destroyThreadPool(threadPool);
+	closeWorldFile(worldFile);
 	glDeleteFramebuffers(1, &fb1->fbo);
 	glDeleteFramebuffers(1, &fb2->fbo);
 	glDeleteTextures(1, &fb1->colorTexture);
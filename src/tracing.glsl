@@ -0,0 +1,1033 @@
+// Everything both path tracers need: the scene and its voxel structures, the traversals, and
+// the shading of one bounce. fragment.glsl traces whole paths in one fragment, wavefront_comp.glsl
+// splits them into kernels. Included after their #version line by loadShader() in main.cpp.
+
+layout (std430, binding = 2) buffer shader_data {
+	int mapw;
+	int maph;
+	int mapd;
+	int bitsPerVoxel;
+
+	// See VoxelGrid.h
+	int voxelLayout;
+	int strideShiftY;
+	int strideShiftZ;
+
+	vec4 palette[256];	// rgb: colour, w: emission strength
+
+	// Voxel ids packed bitsPerVoxel bits at a time, low bits first
+	uint data[];
+};
+
+const int VOXEL_LAYOUT_LINEAR = 0;
+const int VOXEL_LAYOUT_MORTON = 1;
+const int VOXEL_TILE_SIZE = 8;
+
+// Sparse voxel octree built from the same grid, see Octree.h for the node encoding
+layout (std430, binding = 3) buffer svo_data {
+	int svoSize;
+	int svoDepth;
+
+	uint svoNodes[];
+};
+
+const uint SVO_LEAF = 0x80000000u;
+
+// Sparse voxel DAG, same node format as the octree with shared child blocks (see Dag.h)
+layout (std430, binding = 8) buffer dag_data {
+	int dagSize;
+	int dagDepth;
+
+	uint dagNodes[];
+};
+
+// Brickmap built from the same grid, see Brickmap.h. The coarse cells are stored
+// first in brickData, followed by the pool of brickWords words per brick.
+layout (std430, binding = 4) buffer brickmap_data {
+	int brickw;
+	int brickh;
+	int brickd;
+	int brickWords;
+
+	uint brickData[];
+};
+
+const int BRICK_SIZE = 8;
+const uint BRICK_UNIFORM = 0x80000000u;
+
+// Occupancy pyramid built from the same grid, see Occupancy.h. occLevel[i].xyz is the size
+// of level i in words, occLevel[i].w where it starts in occWords. Words are 64-bit, low half first.
+layout (std430, binding = 5) buffer occupancy_data {
+	int occLevels;
+	ivec4 occLevel[8];
+
+	uvec2 occWords[];
+};
+
+// Chebyshev distance to the nearest solid voxel, one byte per cell in grid order (see DistanceField.h)
+layout (std430, binding = 6) buffer distance_data {
+	uint distances[];
+};
+
+// Resident window of the chunked world, see ChunkWorld.h. chunkData holds the indirection table,
+// one entry per chunk of the window, then chunkOrigin.w records of palette and pages, then the pool
+// of pages.
+layout (std430, binding = 7) buffer chunk_data {
+	ivec4 chunkOrigin;	// xyz: chunk coordinates of the first table entry, w: number of records
+	ivec4 chunkDims;	// xyz: table size in chunks, w: number of pages
+
+	uint chunkData[];
+};
+
+const int CHUNK_SIZE = 32;
+const uint CHUNK_UNIFORM = 0x80000000u;
+const uint CHUNK_PAGE_WORDS = 1024u;
+const uint CHUNK_MAX_BITS = 8u;
+const uint CHUNK_RECORD_PAGES = 1u;
+const uint CHUNK_RECORD_PALETTE = 9u;
+const uint CHUNK_RECORD_WORDS = 13u;
+
+// Max-height quadtree over the columns of the grid, see ColumnHeights.h. columnLevel[i].xy is
+// the size of level i in entries, columnLevel[i].w where it starts in columnTops.
+layout (std430, binding = 9) buffer column_data {
+	int columnLevels;
+	ivec4 columnLevel[16];
+
+	uint columnTops[];
+};
+
+// Rays traced and rays that ran out of budget, per bounce, while u_CountBudget is set (see RayBudget in Structs.h)
+const int BUDGET_COUNTED_BOUNCES = 32;
+
+layout (std430, binding = 10) buffer budget_data {
+	uint budgetRays[BUDGET_COUNTED_BOUNCES];
+	uint budgetExhausted[BUDGET_COUNTED_BOUNCES];
+};
+
+const int TRAVERSAL_DDA = 0;
+const int TRAVERSAL_SVO = 1;
+const int TRAVERSAL_BRICKMAP = 2;
+const int TRAVERSAL_OCCUPANCY = 3;
+const int TRAVERSAL_DISTANCE = 4;
+const int TRAVERSAL_CHUNKS = 5;
+const int TRAVERSAL_DAG = 6;
+const int TRAVERSAL_COLUMNS = 7;
+
+// How voxel_traversal() skips empty space
+const int SKIP_NONE = 0;
+const int SKIP_OCCUPANCY = 1;
+const int SKIP_DISTANCE = 2;
+const int SKIP_COLUMNS = 3;
+
+uniform vec2 u_Resolution;
+
+uniform float u_Time;
+
+uniform mat4 u_InverseProjection;
+uniform mat4 u_InverseView;
+
+uniform bool useFresnel;
+uniform int u_TraversalMode;
+
+uniform int u_SPP;
+uniform int u_Bounces;
+
+// Step and distance budget of the voxel traversals, see bounceBudget()
+uniform int u_MaxSteps;
+uniform float u_MaxDistance;
+uniform float u_BounceFalloff;
+uniform int u_MinSteps;
+uniform float u_MinDistance;
+uniform bool u_CountBudget;
+
+// Samples the sun with a shadow ray at every diffuse bounce, see scatter()
+uniform bool u_SunShadows;
+
+uniform int u_FrameSinceLastReset;
+
+uniform sampler2D u_LastColors;
+uniform sampler2D u_LastBloom;
+
+uint wang_hash(inout uint seed) {
+    seed = uint(seed ^ uint(61)) ^ uint(seed >> uint(16));
+    seed *= uint(9);
+    seed = seed ^ (seed >> 4);
+    seed *= uint(0x27d4eb2d);
+    seed = seed ^ (seed >> 15);
+    return seed;
+}
+// Seed of the random numbers of a pixel, a new one every frame
+uint pixelSeed(uvec2 pixel) {
+	return (pixel.x * 19873u + pixel.y * 92787u + uint(u_FrameSinceLastReset)) | 1u;
+}
+float RandomFloat01(inout uint state) {
+    return float(wang_hash(state)) / 4294967296.0;
+}
+vec3 RandomUnitVector(inout uint state) {
+	float z = 1.0 - 2.0 * RandomFloat01(state);
+	float r = sqrt(1.0 - z * z);
+	float phi = 6.28318530718 * RandomFloat01(state);
+	float x = r * cos(phi);
+	float y = r * sin(phi);
+	return vec3(x, y, z);
+}
+
+// --------------- Structs ---------------
+
+struct Material {
+	vec3 diffuse;
+	vec3 specular;
+	vec3 emissive;
+	float smoothness;
+	float specularChance;
+};
+
+struct Sphere {
+	vec3 pos;
+	float radius;
+	Material material;
+};
+
+struct Plane {
+	vec3 pos;
+	vec3 normal;
+	Material material;
+};
+
+struct intersection {
+	float t;
+	vec3 pos;
+	vec3 normal;
+	Material material;
+	// See sceneMaterial()
+	uint materialId;
+	bool hit;
+};
+
+// How far a voxel traversal may go: maxSteps iterations of its loop, and no hit further than
+// maxDistance along the ray. exhausted is set when the ray stops on either before leaving the grid.
+struct RayBudget {
+	int maxSteps;
+	float maxDistance;
+	bool exhausted;
+};
+
+
+// --------------- Scene ---------------
+
+
+const int numSpheres = 4;
+
+Sphere spheres[numSpheres] = Sphere[] (
+	Sphere(vec3(-3, 0, 0), 1, Material(vec3(0.95, 0.5, 0.95), vec3(1.0, 0.80, 0.80), vec3(0), 1.0, 0.9)),
+	Sphere(vec3(-1, 0, 0), 1, Material(vec3(0.5, 0.95, 0.95), vec3(0.80, 1.0, 0.80), vec3(0), 0.9, 0.9)),
+	Sphere(vec3(5, 2, 5), 1, Material(vec3(0.95, 0.95, 0.95), vec3(1, 1, 1), vec3(10), 0, 0)),
+	Sphere(vec3( 3, 0, 0), 1, Material(vec3(0.95, 0.95, 0.95), vec3(0.50, 0.50, 0.95), vec3(0), 0.9, 0.9))
+);
+
+const int numPlanes = 1;
+
+Plane planes[numPlanes] = Plane[] (
+	Plane(vec3(0, -1, 0), vec3(0, 1, 0), Material(vec3(1.0, 1.0, 1.0), vec3(0), vec3(0), 0.2, 0.5))
+);
+
+// Materials by id: voxel ids index the palette, the primitives come after them
+const uint MATERIAL_SPHERES = 256u;
+const uint MATERIAL_PLANES = MATERIAL_SPHERES + uint(numSpheres);
+
+Material sceneMaterial(uint id) {
+	if (id >= MATERIAL_PLANES) return planes[id - MATERIAL_PLANES].material;
+	if (id >= MATERIAL_SPHERES) return spheres[id - MATERIAL_SPHERES].material;
+	return Material(palette[id].rgb, vec3(1), vec3(palette[id].w), 0, 0);
+}
+
+// --------------- Intersections ---------------
+
+float sphereIntersect(Sphere sphere, vec3 pos, vec3 dir) {
+	vec3 oc = pos - sphere.pos;
+	float b = dot(oc, dir);
+	float c = dot(oc, oc) - sphere.radius * sphere.radius;
+	float h = b * b - c;
+	if (h < 0) return -1;
+	return -b - sqrt(h);
+}
+
+float planeIntersect(vec3 pos, vec3 dir, vec3 planeNormal, vec3 planePos) {
+	float denom = dot(dir, -planeNormal);
+	if (denom > 1e-6) {
+		vec3 p0l0 = planePos - pos;
+		float t = dot(p0l0, -planeNormal) / denom;
+		if (t >= 0) return t;
+	}
+	return -1;
+}
+
+// Spreads the 3 low bits of v so that they land on every third bit
+uint spreadBits3(uint v) {
+	return (v & 1u) | ((v & 2u) << 2) | ((v & 4u) << 4);
+}
+
+// Must match voxelIndex() in VoxelGrid.cpp
+uint voxelIndex(int x, int y, int z) {
+	if (voxelLayout == VOXEL_LAYOUT_MORTON) {
+		uvec3 tile = uvec3(x, y, z) >> 3u;
+		uint tileIndex = strideShiftY >= 0
+			? tile.x | (tile.y << strideShiftY) | (tile.z << strideShiftZ)
+			: tile.x + uint((mapw + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE) * (tile.y + uint((maph + VOXEL_TILE_SIZE - 1) / VOXEL_TILE_SIZE) * tile.z);
+
+		uvec3 local = uvec3(x, y, z) & 7u;
+		return (tileIndex << 9) | spreadBits3(local.x) | (spreadBits3(local.y) << 1) | (spreadBits3(local.z) << 2);
+	}
+
+	if (strideShiftY >= 0) return uint(x) | (uint(y) << strideShiftY) | (uint(z) << strideShiftZ);
+	return uint(x + y * mapw) + uint(z) * uint(mapw * maph);
+}
+
+// Voxel of a cell known to be in the grid
+uint readVoxel(int x, int y, int z) {
+	// bitsPerVoxel is a power of two, so are the voxels per word
+	uint index = voxelIndex(x, y, z);
+	int bitsShift = findLSB(bitsPerVoxel);
+	uint wordShift = uint(5 - bitsShift);
+	uint shift = (index & ((1u << wordShift) - 1u)) << bitsShift;
+	uint mask = bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << bitsPerVoxel) - 1u;
+
+	return (data[index >> wordShift] >> shift) & mask;
+}
+
+uint testVoxel(int x, int y, int z) {
+	if(x < 0 || x >= mapw || y < 0 || y >= maph || z < 0 || z >= mapd) return 0;
+	return readVoxel(x, y, z);
+}
+
+float projectToCube(vec3 ro, vec3 rd) {
+	
+	float tx1 = (0 - ro.x) / rd.x;
+	float tx2 = (mapw - ro.x) / rd.x;
+
+	float ty1 = (0 - ro.y) / rd.y;
+	float ty2 = (maph - ro.y) / rd.y;
+
+	float tz1 = (0 - ro.z) / rd.z;
+	float tz2 = (mapd - ro.z) / rd.z;
+
+	float tx = max(min(tx1, tx2), 0);
+	float ty = max(min(ty1, ty2), 0);
+	float tz = max(min(tz1, tz2), 0);
+
+	float t = max(tx, max(ty, tz));
+	
+	return t;
+}
+
+// Where the ray leaves the box [boxMin, boxMin + size), with the axis of the face it crosses
+float exitBox(vec3 orig, vec3 direction, vec3 invDir, ivec3 boxMin, ivec3 size, out int side) {
+	vec3 exitPlanes = vec3(boxMin) + vec3(greaterThan(direction, vec3(0))) * vec3(size);
+	vec3 tPlanes = (exitPlanes - orig) * invDir;
+
+	side = tPlanes.x <= tPlanes.y && tPlanes.x <= tPlanes.z ? 0 : (tPlanes.y <= tPlanes.z ? 1 : 2);
+	return tPlanes[side];
+}
+
+// Cell the ray enters after leaving the box through the given side at distance t
+ivec3 cellAfterExit(vec3 orig, vec3 direction, float t, ivec3 boxMin, ivec3 size, int side) {
+	ivec3 cell = clamp(ivec3(floor(orig + direction * t)), boxMin, boxMin + size - 1);
+	cell[side] = direction[side] > 0 ? boxMin[side] + size[side] : boxMin[side] - 1;
+	return cell;
+}
+
+// Clips the ray to the box [0, boxMax) and returns the entry distance and cell, or false if it misses.
+// side is the axis of the entry face, startInside tells whether the origin already was in the box.
+bool enterBox(vec3 orig, vec3 direction, vec3 invDir, vec3 boxMax, out float t, out float tExit, out ivec3 cell, out int side, out bool startInside) {
+	vec3 tA = (vec3(0) - orig) * invDir;
+	vec3 tB = (boxMax - orig) * invDir;
+	vec3 tNear = min(tA, tB);
+	vec3 tFar = max(tA, tB);
+
+	float tEnter = max(max(tNear.x, tNear.y), tNear.z);
+	tExit = min(min(tFar.x, tFar.y), tFar.z);
+	if (tEnter >= tExit || tExit <= 0) return false;
+
+	t = max(tEnter, 0);
+	cell = clamp(ivec3(floor(orig + direction * t)), ivec3(0), ivec3(boxMax) - 1);
+
+	side = tNear.x >= tNear.y && tNear.x >= tNear.z ? 0 : (tNear.y >= tNear.z ? 1 : 2);
+	startInside = tEnter <= 0;
+	if (!startInside) {
+		cell[side] = direction[side] > 0 ? 0 : int(boxMax[side]) - 1;
+	}
+	return true;
+}
+
+bool occupied(int level, ivec3 cell) {
+	ivec3 c = cell >> (2 * level);
+	ivec4 info = occLevel[level];
+	uvec2 word = occWords[info.w + (c.x >> 2) + info.x * ((c.y >> 2) + info.y * (c.z >> 2))];
+	int bit = (c.x & 3) + 4 * (c.y & 3) + 16 * (c.z & 3);
+	return ((bit < 32 ? word.x >> bit : word.y >> (bit - 32)) & 1u) != 0u;
+}
+
+// Edge length of the coarsest empty occupancy block containing the cell, 0 if the voxel is solid
+int emptyBlockSize(ivec3 cell) {
+	int size = 0;
+	for (int level = 0; level < occLevels; level++) {
+		if (occupied(level, cell)) break;
+		size = 1 << (2 * level);
+	}
+	return size;
+}
+
+uint cellDistance(ivec3 cell) {
+	uint index = uint(cell.x + cell.y * mapw) + uint(cell.z) * uint(mapw * maph);
+	return (distances[index >> 2] >> ((index & 3u) * 8u)) & 0xFFu;
+}
+
+uint columnTop(int level, ivec3 cell) {
+	ivec4 info = columnLevel[level];
+	return columnTops[info.w + (cell.x >> level) + info.x * (cell.z >> level)];
+}
+
+// Coarsest column quadtree level whose block of columns is empty from the cell up, -1 if none is
+int emptyColumnLevel(ivec3 cell) {
+	int level = -1;
+	while (level + 1 < columnLevels && uint(cell.y) >= columnTop(level + 1, cell)) level++;
+	return level;
+}
+
+// Grid DDA. With SKIP_OCCUPANCY or SKIP_DISTANCE, the occupancy pyramid or the distance field
+// is used to jump over whole empty blocks at once instead of stepping through them one cell at a time.
+// With SKIP_COLUMNS, a ray above the terrain crosses whole blocks of columns down to their top at once.
+float voxel_traversal(vec3 orig, vec3 direction, inout vec3 normal, inout uint blockType, int emptySkip, inout RayBudget budget) {
+	vec3 origin = orig;
+	
+	float t1 = max(projectToCube(origin, direction) - 0.001, 0);
+	origin += t1 * direction;
+
+	int mapX = int(floor(origin.x));
+	int mapY = int(floor(origin.y));
+	int mapZ = int(floor(origin.z));
+
+	float sideDistX;
+	float sideDistY;
+	float sideDistZ;
+
+	float deltaDX = abs(1 / direction.x);
+	float deltaDY = abs(1 / direction.y);
+	float deltaDZ = abs(1 / direction.z);
+	vec3 invDir = 1.0 / direction;
+	float perpWallDist;
+
+	int stepX;
+	int stepY;
+	int stepZ;
+
+	int side;
+
+	if (direction.x < 0) {
+		stepX = -1;
+		sideDistX = (origin.x - mapX) * deltaDX;
+	} else {
+		stepX = 1;
+		sideDistX = (mapX + 1.0 - origin.x) * deltaDX;
+	}
+	if (direction.y < 0) {
+		stepY = -1;
+		sideDistY = (origin.y - mapY) * deltaDY;
+	} else {
+		stepY = 1;
+		sideDistY = (mapY + 1.0 - origin.y) * deltaDY;
+	}
+	if (direction.z < 0) {
+		stepZ = -1;
+		sideDistZ = (origin.z - mapZ) * deltaDZ;
+	} else {
+		stepZ = 1;
+		sideDistZ = (mapZ + 1.0 - origin.z) * deltaDZ;
+	}
+
+	for (int i = 0; i < budget.maxSteps; i++) {
+		if ((mapX >= mapw && stepX > 0) || (mapY >= maph && stepY > 0) || (mapZ >= mapd && stepZ > 0)) return -1;
+		if ((mapX < 0 && stepX < 0) || (mapY < 0 && stepY < 0) || (mapZ < 0 && stepZ < 0)) return -1;
+
+		// The next cell starts where the ray leaves this one
+		if (t1 + min(sideDistX, min(sideDistY, sideDistZ)) > budget.maxDistance) break;
+
+		ivec3 boxMin;
+		ivec3 emptySize = ivec3(0);
+		if (emptySkip != SKIP_NONE && mapX >= 0 && mapX < mapw && mapY >= 0 && mapY < maph && mapZ >= 0 && mapZ < mapd) {
+			if (emptySkip == SKIP_OCCUPANCY) {
+				int size = emptyBlockSize(ivec3(mapX, mapY, mapZ));
+				emptySize = ivec3(size);
+				boxMin = (ivec3(mapX, mapY, mapZ) / max(size, 1)) * size;
+			} else if (emptySkip == SKIP_DISTANCE) {
+				// Every cell closer than the distance is empty, so the cube around the cell can be crossed at once
+				int dist = int(cellDistance(ivec3(mapX, mapY, mapZ)));
+				emptySize = ivec3(2 * dist - 1);
+				boxMin = ivec3(mapX, mapY, mapZ) - (dist - 1);
+			} else {
+				// Everything from the top of the block of columns to the top of the grid is empty
+				int level = emptyColumnLevel(ivec3(mapX, mapY, mapZ));
+				if (level >= 0) {
+					int top = int(columnTop(level, ivec3(mapX, mapY, mapZ)));
+					boxMin = ivec3((mapX >> level) << level, top, (mapZ >> level) << level);
+					emptySize = ivec3(1 << level, maph - top, 1 << level);
+				}
+			}
+		}
+
+		if (emptySize.x * emptySize.y * emptySize.z > 1) {
+			// Leave the whole empty block and restart the DDA from the cell behind it
+			float tExit = exitBox(origin, direction, invDir, boxMin, emptySize, side);
+			ivec3 cell = cellAfterExit(origin, direction, tExit, boxMin, emptySize, side);
+
+			mapX = cell.x;
+			mapY = cell.y;
+			mapZ = cell.z;
+			sideDistX = (mapX + (stepX > 0 ? 1 : 0) - origin.x) * invDir.x;
+			sideDistY = (mapY + (stepY > 0 ? 1 : 0) - origin.y) * invDir.y;
+			sideDistZ = (mapZ + (stepZ > 0 ? 1 : 0) - origin.z) * invDir.z;
+		} else if (sideDistX < sideDistY && sideDistX < sideDistZ) {
+			sideDistX += deltaDX;
+			mapX += stepX;
+			side = 0;
+		} else if (sideDistY < sideDistZ) {
+			sideDistY += deltaDY;
+			mapY += stepY;
+			side = 1;
+		} else {
+			sideDistZ += deltaDZ;
+			mapZ += stepZ;
+			side = 2;
+		}
+
+		uint block = testVoxel(mapX, mapY, mapZ);
+		if (block != 0u) {
+			blockType = block;
+
+			if (side == 0) {
+				perpWallDist = (mapX - origin.x + (1 - stepX) / 2) / direction.x + t1;
+				normal = vec3(1, 0, 0) * -stepX;
+			}
+			else if (side == 1) {
+				perpWallDist = (mapY - origin.y + (1 - stepY) / 2) / direction.y + t1;
+				normal = vec3(0, 1, 0) * -stepY;
+			}
+			else {
+				perpWallDist = (mapZ - origin.z + (1 - stepZ) / 2) / direction.z + t1;
+				normal = vec3(0, 0, 1) * -stepZ;
+			}
+			return perpWallDist;
+		}
+	}
+
+	// The exit is only noticed at the top of the loop, so the last step can already have left
+	// the grid: that ray is a miss, not one that ran out of budget
+	bool exited = (mapX >= mapw && stepX > 0) || (mapY >= maph && stepY > 0) || (mapZ >= mapd && stepZ > 0)
+		|| (mapX < 0 && stepX < 0) || (mapY < 0 && stepY < 0) || (mapZ < 0 && stepZ < 0);
+	if (!exited) budget.exhausted = true;
+	return -1;
+}
+
+// Grid DDA without empty space skipping, hitting the same voxels as voxel_traversal() with SKIP_NONE
+// and the same step choice. The ray is clipped to the grid once with enterBox() and the DDA starts
+// from the entry point, so every cell it visits is in the grid and is read without bounds checks:
+// the only test left in the loop is one vector compare against where the ray leaves the grid.
+// The layout is picked once per ray, in the linear one the voxel index follows the steps.
+float dda_traversal(vec3 orig, vec3 direction, inout vec3 normal, inout uint blockType, inout RayBudget budget) {
+	vec3 invDir = 1.0 / direction;
+	ivec3 gridSize = ivec3(mapw, maph, mapd);
+
+	float t1, tExit;
+	ivec3 cell;
+	int side;
+	bool startInside;
+	if (!enterBox(orig, direction, invDir, vec3(gridSize), t1, tExit, cell, side, startInside)) return -1;
+	vec3 origin = orig + t1 * direction;
+
+	bvec3 negative = lessThan(direction, vec3(0));
+	ivec3 stepDir = 1 - 2 * ivec3(negative);
+	vec3 deltaDist = abs(invDir);
+	vec3 sideDist = (vec3(cell) + vec3(not(negative)) - origin) * invDir;
+
+	// The ray has left the grid once cell * stepDir reaches this on any axis
+	ivec3 exitLimit = ivec3(not(negative)) * (gridSize - 1) + 1;
+
+	// What readVoxel() works out on every call
+	int bitsShift = findLSB(bitsPerVoxel);
+	uint wordShift = uint(5 - bitsShift);
+	uint voxelMask = bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << bitsPerVoxel) - 1u;
+	ivec3 indexStep = ivec3(1, mapw, mapw * maph) * stepDir;
+	uint index = voxelIndex(cell.x, cell.y, cell.z);
+
+	// Like voxel_traversal(), a ray starting in the grid does not test its first cell,
+	// and one entering it past the distance budget stops there
+	vec3 mask = vec3(equal(ivec3(side), ivec3(0, 1, 2)));
+	uint block = 0u;
+	if (t1 > budget.maxDistance) {
+		budget.exhausted = true;
+		return -1;
+	}
+	if (!startInside) block = (data[index >> wordShift] >> ((index & ((1u << wordShift) - 1u)) << bitsShift)) & voxelMask;
+	bool outside = false;
+	// Entering the grid costs one step, like the one voxel_traversal() takes from just before it
+	int steps = startInside ? 0 : 1;
+
+	// Same choice as voxel_traversal(): x when strictly closest, then y unless z is closer.
+	// Ties and NaNs still step some axis, so the ray never gets stuck on one.
+	if (voxelLayout != VOXEL_LAYOUT_MORTON) {
+		for (; steps < budget.maxSteps && block == 0u; steps++) {
+			if (t1 + min(sideDist.x, min(sideDist.y, sideDist.z)) > budget.maxDistance) break;
+
+			mask.x = float(sideDist.x < sideDist.y && sideDist.x < sideDist.z);
+			mask.y = (1.0 - mask.x) * float(sideDist.y < sideDist.z);
+			mask.z = 1.0 - mask.x - mask.y;
+
+			sideDist += mask * deltaDist;
+			cell += ivec3(mask) * stepDir;
+			outside = any(greaterThanEqual(cell * stepDir, exitLimit));
+			if (outside) break;
+
+			index += uint(int(dot(mask, vec3(indexStep))));
+			block = (data[index >> wordShift] >> ((index & ((1u << wordShift) - 1u)) << bitsShift)) & voxelMask;
+		}
+	} else {
+		for (; steps < budget.maxSteps && block == 0u; steps++) {
+			if (t1 + min(sideDist.x, min(sideDist.y, sideDist.z)) > budget.maxDistance) break;
+
+			mask.x = float(sideDist.x < sideDist.y && sideDist.x < sideDist.z);
+			mask.y = (1.0 - mask.x) * float(sideDist.y < sideDist.z);
+			mask.z = 1.0 - mask.x - mask.y;
+
+			sideDist += mask * deltaDist;
+			cell += ivec3(mask) * stepDir;
+			outside = any(greaterThanEqual(cell * stepDir, exitLimit));
+			if (outside) break;
+
+			index = voxelIndex(cell.x, cell.y, cell.z);
+			block = (data[index >> wordShift] >> ((index & ((1u << wordShift) - 1u)) << bitsShift)) & voxelMask;
+		}
+	}
+
+	if (block == 0u) {
+		// Out of steps or distance before leaving the grid
+		if (!outside) budget.exhausted = true;
+		return -1;
+	}
+
+	side = mask.x > 0 ? 0 : (mask.y > 0 ? 1 : 2);
+	blockType = block;
+	normal = vec3(0);
+	normal[side] = float(-stepDir[side]);
+	return (cell[side] - origin[side] + (1 - stepDir[side]) / 2) / direction[side] + t1;
+}
+
+uint octreeNode(bool dag, uint index) {
+	return dag ? dagNodes[index] : svoNodes[index];
+}
+
+// Stackless octree traversal: every step descends from the root to the node containing the
+// current cell, then jumps to where the ray leaves that node. Empty space is crossed one
+// node at a time instead of one cell at a time. Walks the DAG the same way when dag is set.
+float svo_traversal(vec3 orig, vec3 direction, inout vec3 normal, inout uint blockType, bool dag, inout RayBudget budget) {
+	vec3 invDir = 1.0 / direction;
+	int rootSize = dag ? dagSize : svoSize;
+
+	float t, tExit;
+	ivec3 cell;
+	int side;
+	bool startInside;
+	if (!enterBox(orig, direction, invDir, vec3(rootSize), t, tExit, cell, side, startInside)) return -1;
+
+	for (int i = 0; i < budget.maxSteps; i++) {
+		if (t > budget.maxDistance) break;
+
+		uint node = octreeNode(dag, 0u);
+		int size = rootSize;
+		ivec3 nodeMin = ivec3(0);
+
+		while (node != 0u && (node & SVO_LEAF) == 0u) {
+			size >>= 1;
+			ivec3 octant = ivec3(greaterThanEqual(cell - nodeMin, ivec3(size)));
+			nodeMin += octant * size;
+			node = octreeNode(dag, node + uint(octant.x + octant.y * 2 + octant.z * 4));
+		}
+
+		if ((node & SVO_LEAF) != 0u) {
+			if (!(startInside && i == 0)) {
+				blockType = node & ~SVO_LEAF;
+				normal = vec3(0);
+				normal[side] = -sign(direction[side]);
+				return t;
+			}
+			// Like the DDA, ignore the cell the ray starts in
+			nodeMin = cell;
+			size = 1;
+		}
+
+		t = exitBox(orig, direction, invDir, nodeMin, ivec3(size), side);
+		if (t >= tExit) return -1;
+
+		cell = cellAfterExit(orig, direction, t, nodeMin, ivec3(size), side);
+		if (cell[side] < 0 || cell[side] >= rootSize) return -1;
+	}
+
+	// Every step returns above once its next cell is outside, so that cell is still inside here
+	budget.exhausted = true;
+	return -1;
+}
+
+uint brickVoxel(uint brickCell, ivec3 cell) {
+	if ((brickCell & BRICK_UNIFORM) != 0u) return brickCell & ~BRICK_UNIFORM;
+
+	ivec3 local = cell % BRICK_SIZE;
+	uint index = uint(local.x + BRICK_SIZE * (local.y + BRICK_SIZE * local.z));
+	uint voxelsPerWord = 32u / uint(bitsPerVoxel);
+	uint shift = (index % voxelsPerWord) * uint(bitsPerVoxel);
+	uint mask = bitsPerVoxel == 32 ? 0xFFFFFFFFu : (1u << bitsPerVoxel) - 1u;
+
+	uint brickStart = uint(brickw * brickh * brickd) + (brickCell - 1u) * uint(brickWords);
+	return (brickData[brickStart + index / voxelsPerWord] >> shift) & mask;
+}
+
+// Two-level traversal of the brickmap: empty bricks are crossed in a single step,
+// occupied ones cell by cell
+float brickmap_traversal(vec3 orig, vec3 direction, inout vec3 normal, inout uint blockType, inout RayBudget budget) {
+	vec3 invDir = 1.0 / direction;
+	ivec3 gridSize = ivec3(mapw, maph, mapd);
+
+	float t, tExit;
+	ivec3 cell;
+	int side;
+	bool startInside;
+	if (!enterBox(orig, direction, invDir, vec3(gridSize), t, tExit, cell, side, startInside)) return -1;
+
+	for (int i = 0; i < budget.maxSteps; i++) {
+		if (t > budget.maxDistance) break;
+
+		ivec3 brick = cell / BRICK_SIZE;
+		uint brickCell = brickData[brick.x + brickw * (brick.y + brickh * brick.z)];
+
+		ivec3 boxMin = brick * BRICK_SIZE;
+		int size = BRICK_SIZE;
+
+		if (brickCell != 0u) {
+			uint block = brickVoxel(brickCell, cell);
+			if (block != 0u && !(startInside && i == 0)) {
+				blockType = block;
+				normal = vec3(0);
+				normal[side] = -sign(direction[side]);
+				return t;
+			}
+			boxMin = cell;
+			size = 1;
+		}
+
+		t = exitBox(orig, direction, invDir, boxMin, ivec3(size), side);
+		if (t >= tExit) return -1;
+
+		cell = cellAfterExit(orig, direction, t, boxMin, ivec3(size), side);
+		if (cell[side] < 0 || cell[side] >= gridSize[side]) return -1;
+	}
+
+	// Every step returns above once its next cell is outside, so that cell is still inside here
+	budget.exhausted = true;
+	return -1;
+}
+
+// Chunks index their palette like a 32^3 grid in VOXEL_LAYOUT_MORTON: 4x4x4 tiles, Z-order inside
+// them. The indices are 1, 2, 4 or 8 bits, 8 bits being the ids themselves.
+uint chunkVoxel(uint entry, ivec3 local) {
+	if ((entry & CHUNK_UNIFORM) != 0u) return entry & ~CHUNK_UNIFORM;
+
+	uvec3 tile = uvec3(local) >> 3u;
+	uvec3 inTile = uvec3(local) & 7u;
+	uint index = ((tile.x | (tile.y << 2) | (tile.z << 4)) << 9) | spreadBits3(inTile.x) | (spreadBits3(inTile.y) << 1) | (spreadBits3(inTile.z) << 2);
+
+	uint tableSize = uint(chunkDims.x * chunkDims.y * chunkDims.z);
+	uint record = tableSize + (entry - 1u) * CHUNK_RECORD_WORDS;
+	uint bits = chunkData[record] & 0xFFu;
+
+	uint bit = index * bits;
+	uint word = bit >> 5;
+	uint page = chunkData[record + CHUNK_RECORD_PAGES + word / CHUNK_PAGE_WORDS];
+	uint poolStart = tableSize + uint(chunkOrigin.w) * CHUNK_RECORD_WORDS;
+	uint value = (chunkData[poolStart + page * CHUNK_PAGE_WORDS + word % CHUNK_PAGE_WORDS] >> (bit & 31u)) & ((1u << bits) - 1u);
+
+	if (bits == CHUNK_MAX_BITS) return value;
+	return (chunkData[record + CHUNK_RECORD_PALETTE + value / 4u] >> (value % 4u * 8u)) & 0xFFu;
+}
+
+// Two-level traversal of the resident chunks, like the brickmap one: chunks that are not
+// loaded or only hold air are crossed in one step. Works relative to the window so the
+// coordinates stay small wherever the camera is.
+float chunk_traversal(vec3 orig, vec3 direction, inout vec3 normal, inout uint blockType, inout RayBudget budget) {
+	vec3 invDir = 1.0 / direction;
+	vec3 localOrig = orig - vec3(chunkOrigin.xyz * CHUNK_SIZE);
+	ivec3 windowSize = chunkDims.xyz * CHUNK_SIZE;
+
+	float t, tExit;
+	ivec3 cell;
+	int side;
+	bool startInside;
+	if (!enterBox(localOrig, direction, invDir, vec3(windowSize), t, tExit, cell, side, startInside)) return -1;
+
+	for (int i = 0; i < budget.maxSteps; i++) {
+		if (t > budget.maxDistance) break;
+
+		ivec3 chunk = cell / CHUNK_SIZE;
+		uint entry = chunkData[chunk.x + chunkDims.x * (chunk.y + chunkDims.y * chunk.z)];
+
+		ivec3 boxMin = chunk * CHUNK_SIZE;
+		int size = CHUNK_SIZE;
+
+		if (entry != 0u && entry != CHUNK_UNIFORM) {
+			uint block = chunkVoxel(entry, cell - boxMin);
+			if (block != 0u && !(startInside && i == 0)) {
+				blockType = block;
+				normal = vec3(0);
+				normal[side] = -sign(direction[side]);
+				return t;
+			}
+			boxMin = cell;
+			size = 1;
+		}
+
+		t = exitBox(localOrig, direction, invDir, boxMin, ivec3(size), side);
+		if (t >= tExit) return -1;
+
+		cell = cellAfterExit(localOrig, direction, t, boxMin, ivec3(size), side);
+		if (cell[side] < 0 || cell[side] >= windowSize[side]) return -1;
+	}
+
+	// Every step returns above once its next cell is outside, so that cell is still inside here
+	budget.exhausted = true;
+	return -1;
+}
+
+float voxelIntersect(vec3 pos, vec3 dir, inout vec3 normal, inout uint blockType, inout RayBudget budget) {
+	if (u_TraversalMode == TRAVERSAL_SVO) return svo_traversal(pos, dir, normal, blockType, false, budget);
+	if (u_TraversalMode == TRAVERSAL_DAG) return svo_traversal(pos, dir, normal, blockType, true, budget);
+	if (u_TraversalMode == TRAVERSAL_BRICKMAP) return brickmap_traversal(pos, dir, normal, blockType, budget);
+	if (u_TraversalMode == TRAVERSAL_OCCUPANCY) return voxel_traversal(pos, dir, normal, blockType, SKIP_OCCUPANCY, budget);
+	if (u_TraversalMode == TRAVERSAL_DISTANCE) return voxel_traversal(pos, dir, normal, blockType, SKIP_DISTANCE, budget);
+	if (u_TraversalMode == TRAVERSAL_CHUNKS) return chunk_traversal(pos, dir, normal, blockType, budget);
+	if (u_TraversalMode == TRAVERSAL_COLUMNS) return voxel_traversal(pos, dir, normal, blockType, SKIP_COLUMNS, budget);
+	return dda_traversal(pos, dir, normal, blockType, budget);
+}
+
+void sceneIntersect(vec3 pos, vec3 dir, out intersection closest, inout RayBudget budget) {
+	closest.t = 1000000;
+	closest.hit = false;
+	for (int i = 0; i < numSpheres; i++) {
+		float t = sphereIntersect(spheres[i], pos, dir);
+		if (t > 0 && t < closest.t) {
+			closest.t = t;
+			closest.pos = pos + dir * t;
+			closest.normal = -normalize(spheres[i].pos - closest.pos);
+			closest.material = spheres[i].material;
+			closest.materialId = MATERIAL_SPHERES + uint(i);
+			closest.hit = true;
+		}
+	}
+	for (int i = 0; i < numPlanes; i++) {
+		float t = planeIntersect(pos, dir, planes[i].normal, planes[i].pos);
+		if (t > 0 && t < closest.t) {
+			closest.t = t;
+			closest.pos = pos + dir * t;
+			closest.normal = planes[i].normal;
+			closest.material = planes[i].material;
+			closest.materialId = MATERIAL_PLANES + uint(i);
+			closest.hit = true;
+		}
+	}
+	
+	vec3 normal = vec3(0);
+	uint blockType = 0u;
+	float t = voxelIntersect(pos, dir, normal, blockType, budget);
+
+	if (t > 0 && t < closest.t) {
+		closest.t = t;
+		closest.pos = pos + dir * t;
+		closest.normal = normal;
+		closest.material = sceneMaterial(blockType);
+		closest.materialId = blockType;
+		closest.hit = true;
+	}
+}
+
+// Any-hit query for shadow and visibility rays: whether anything lies along the ray before maxT.
+// Primitives are tested first since they are cheap, and it returns on the first one in range
+// whichever is closest. The voxel walk stops at its first solid voxel like for sceneIntersect(),
+// but nothing reads its normal or block type, so that work and the material lookup are dropped.
+// A walk that runs out of budget has not found the way out, and counts as occluded: otherwise
+// every point too deep under an overhang for the budget would be lit.
+bool sceneOccluded(vec3 pos, vec3 dir, float maxT, inout RayBudget budget) {
+	for (int i = 0; i < numSpheres; i++) {
+		float t = sphereIntersect(spheres[i], pos, dir);
+		if (t > 0 && t < maxT) return true;
+	}
+	for (int i = 0; i < numPlanes; i++) {
+		float t = planeIntersect(pos, dir, planes[i].normal, planes[i].pos);
+		if (t > 0 && t < maxT) return true;
+	}
+
+	// The walk is not cut at maxT, so that running out of budget only ever means that
+	vec3 normal = vec3(0);
+	uint blockType = 0u;
+	float t = voxelIntersect(pos, dir, normal, blockType, budget);
+	return t > 0 ? t < maxT : budget.exhausted;
+}
+
+// Primary rays get u_MaxSteps and no distance limit, so the budget never cuts what is on screen.
+// Every bounce after that scales both budgets by u_BounceFalloff, down to u_MinSteps and u_MinDistance.
+// A ray that runs out of budget is treated as a miss and sees the sky.
+RayBudget bounceBudget(int bounce) {
+	if (bounce == 0) return RayBudget(u_MaxSteps, 1e30, false);
+
+	float scale = pow(u_BounceFalloff, float(bounce - 1));
+	return RayBudget(max(int(float(u_MaxSteps) * scale), u_MinSteps), max(u_MaxDistance * scale, u_MinDistance), false);
+}
+
+float lerp(float a, float b, float t) {
+	return a + (b - a) * t;
+}
+
+vec3 lerp(vec3 a, vec3 b, float t) {
+	return a + (b - a) * t;
+}
+
+struct environment {
+	vec3 SkyColorZenith;
+	vec3 SkyColorHorizon;
+	vec3 GroundColor;
+
+	vec3 SunColor;
+	vec3 SunDirection;
+	float SunFocus;
+	float SunIntensity;
+};
+
+environment env = environment(
+	vec3(0.5, 0.7, 0.9) * 0.5, // SkyColorZenith
+	vec3(1.0, 0.8, 0.6) * 0.5, // SkyColorHorizon
+	vec3(0.7, 0.6, 0.4) * 0.5, // GroundColor
+	vec3(1, 1, 1),
+	normalize(vec3(0.5, 0.5, 0.5)),
+	500,
+	50
+
+);
+
+float FresnelReflectAmount(float n1, float n2, vec3 normal, vec3 incident, float f0, float f90) {
+        // Schlick aproximation
+        float r0 = (n1-n2) / (n1+n2);
+        r0 *= r0;
+        float cosX = -dot(normal, incident);
+        if (n1 > n2) {
+            float n = n1/n2;
+            float sinT2 = n*n*(1.0-cosX*cosX);
+            // Total internal reflection
+            if (sinT2 > 1.0)
+                return f90;
+            cosX = sqrt(1.0-sinT2);
+        }
+        float x = 1.0-cosX;
+        float ret = r0+(1.0-r0)*x*x*x*x*x;
+ 
+        // adjust reflect multiplier for object reflectivity
+        return mix(f0, f90, ret);
+}
+
+
+// simple background environment lighting with sun, without it when it was already sampled
+vec3 skycolor(vec3 dir, bool withSun) {
+
+	float skyGradientT = pow(smoothstep(0., 0.4, dir.y), 0.35);
+	vec3 skyGradient = lerp(env.SkyColorHorizon, env.SkyColorZenith, skyGradientT);
+	float sun = withSun ? pow(max(0, dot(dir, env.SunDirection)), env.SunFocus) * env.SunIntensity : 0;
+
+	float groundToSkyT = smoothstep(-0.01, 0., dir.y);
+	float sunMask = groundToSkyT >= 1 ? 1 : 0;
+
+	return lerp(env.GroundColor, skyGradient, groundToSkyT) + sun * env.SunColor * sunMask;
+}
+
+// What a diffuse surface facing the sun gets from it, the integral of the sun lobe of skycolor()
+// over the hemisphere weighted like the cosine-distributed bounces
+vec3 sunIrradiance() {
+	return env.SunColor * env.SunIntensity * 2.0 / (env.SunFocus + 1.0);
+}
+
+float compMax(vec3 color) {
+    return max(max(color.x, color.y), color.z);
+}
+
+// --------------- Paths ---------------
+
+// Primary ray through a random point of the pixel whose centre is at pixel
+void cameraRay(vec2 pixel, inout uint rng, out vec3 origin, out vec3 direction) {
+	vec2 ScreenSpace = (pixel + vec2(RandomFloat01(rng), RandomFloat01(rng))) / u_Resolution.xy;
+	vec4 Clip = vec4(ScreenSpace.xy * 2.0f - 1.0f, -1.0, 1.0);
+	vec4 Eye = vec4(vec2(u_InverseProjection * Clip), -1.0, 0.0);
+
+	origin = u_InverseView[3].xyz;
+	direction = normalize(vec3(u_InverseView * Eye));
+}
+
+// Only the first sample of the pixel is counted, which is enough for the shares and keeps
+// the counters from overflowing at high sample counts
+void countBudget(int sampleIndex, int bounce, RayBudget budget) {
+	if (u_CountBudget && sampleIndex == 0 && bounce < BUDGET_COUNTED_BOUNCES) {
+		atomicAdd(budgetRays[bounce], 1u);
+		if (budget.exhausted) atomicAdd(budgetExhausted[bounce], 1u);
+	}
+}
+
+// Continues the path from the surface it hit: adds what the surface emits, picks the next ray
+// and takes its colour into rayColor, the throughput of the path. sunSampled is set when the
+// bounce sampled the sun itself, so that the next ray does not count it again.
+void scatter(intersection closest, int bounce, inout vec3 rayOrigin, inout vec3 rayDirection, inout vec3 rayColor, inout vec3 incomingLight, inout bool sunSampled, inout uint rng) {
+	rayOrigin = closest.pos;
+	vec3 diffuseDir = normalize(closest.normal + RandomUnitVector(rng));
+	vec3 specularDir = reflect(rayDirection, closest.normal);
+	bool ifSpecular = RandomFloat01(rng) < (useFresnel ? FresnelReflectAmount(1, 1.5, rayDirection, closest.normal, closest.material.specularChance, 1) : closest.material.specularChance);
+
+	// Kept unit length, the sun lobe of skycolor() and sunIrradiance() assume it
+	rayDirection = normalize(lerp(diffuseDir, specularDir, ifSpecular ? closest.material.smoothness : 0) + 0.001 * closest.normal);
+	incomingLight += rayColor * closest.material.emissive;
+	rayColor *= lerp(closest.material.diffuse, closest.material.specular, ifSpecular ? closest.material.smoothness : 0);
+
+	// A purely diffuse bounce takes the sun from a shadow ray instead of waiting for
+	// the bounce to land in its narrow lobe
+	sunSampled = u_SunShadows && (!ifSpecular || closest.material.smoothness == 0);
+	float sunCos = dot(closest.normal, env.SunDirection);
+	if (sunSampled && sunCos > 0) {
+		// The budget of a primary ray, enough to leave the structure from anywhere in it, so that
+		// deep bounces are not shadowed by their short budgets
+		RayBudget shadowBudget = bounceBudget(0);
+		if (!sceneOccluded(closest.pos + 0.001 * closest.normal, env.SunDirection, 1e30, shadowBudget)) {
+			incomingLight += rayColor * sunIrradiance() * sunCos;
+		}
+	}
+}
+
+// Bright pixels of the last frame around uv, spread for the bloom
+vec3 gatherBloom(vec2 uv, inout uint rng) {
+	int bloomSamples = u_SPP * 2;
+
+	vec3 bloom = vec3(0.0);
+
+	for(int i = 0; i < bloomSamples; i++) {
+		// select offset based on gaussian distribution
+		float u = RandomFloat01(rng);
+		float v = RandomFloat01(rng);
+		float r = sqrt(-2.0 * log(u)) * 0.1;
+		float theta = 2.0 * 3.1415926535897932384626433832795 * v;
+		vec2 offset = vec2(r * cos(theta), r * sin(theta));
+
+		vec3 sampleColor = textureLod(u_LastColors, uv + offset * 0.5, 0.0).rgb;
+		if(compMax(sampleColor) > 1.5) bloom += sampleColor;
+	}
+
+	return bloom / float(bloomSamples);
+}
@@ -1,5 +1,7 @@
 #include "utils.h"
 
+#include <iostream>
+
 #include <glad/gl.h>
 #include <GLFW/glfw3.h>
 
@@ -25,4 +27,35 @@ void setUniformV2(const unsigned int shader, const char* name, glm::vec2 vector)
 void setUniformInt(const unsigned int shader, const char* name, int value) {
 	const unsigned int location = glGetUniformLocation(shader, name);
 	glUniform1i(location, value);
-}
\ No newline at end of file
+}
+
+unsigned int createComputeProgram(const std::string& source, const char* name) {
+	const char* sourceC = source.c_str();
+	GLuint shader = glCreateShader(GL_COMPUTE_SHADER);
+	glShaderSource(shader, 1, &sourceC, NULL);
+	glCompileShader(shader);
+
+	int success;
+	char infoLog[512];
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+	if (!success) {
+		glGetShaderInfoLog(shader, 512, NULL, infoLog);
+		std::cerr << "Failed to compile " << name << " compute shader: " << infoLog << std::endl;
+		glDeleteShader(shader);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+	glAttachShader(program, shader);
+	glLinkProgram(program);
+	glDeleteShader(shader);
+
+	glGetProgramiv(program, GL_LINK_STATUS, &success);
+	if (!success) {
+		glGetProgramInfoLog(program, 512, NULL, infoLog);
+		std::cerr << "Failed to link " << name << " compute program: " << infoLog << std::endl;
+		glDeleteProgram(program);
+		return 0;
+	}
+	return program;
+}
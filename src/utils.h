@@ -1,9 +1,14 @@
 #pragma once
 
+#include <string>
+
 #include <glm/glm.hpp>
 
 void setUniformM4(const unsigned int shader, const char* name, glm::mat4 matrix);
 void setUniformV3(const unsigned int shader, const char* name, glm::vec3 vector);
 void setUniformF(const unsigned int shader, const char* name, float value);
 void setUniformV2(const unsigned int shader, const char* name, glm::vec2 vector);
-void setUniformInt(const unsigned int shader, const char* name, int value);
\ No newline at end of file
+void setUniformInt(const unsigned int shader, const char* name, int value);
+
+// Compiles and links a compute shader, 0 on failure. name is only used in the error messages.
+unsigned int createComputeProgram(const std::string& source, const char* name);
@@ -0,0 +1,223 @@
+#version 430 core
+
+// Wavefront path tracer: the paths of fragment.glsl, advanced one bounce at a time by small
+// kernels instead of one fragment running each of them to the end. Every stage is its own program,
+// compiled with one of the STAGE_ defines of Wavefront.cpp added in front of this file, see
+// Wavefront.h for their order. Between bounces, the paths still going are compacted into a
+// queue so that the next dispatch only runs those, however many bounces the others stopped at.
+layout (local_size_x = 64) in;
+
+#include "tracing.glsl"
+
+// One per pixel, which carries the pixel's samples one after the other
+struct PathState {
+	vec4 origin;		// w: 1 when the last bounce sampled the sun
+	vec4 direction;
+	vec4 throughput;
+	vec4 radiance;		// of the sample being traced
+	vec4 color;			// finished samples, each over u_SPP
+	vec4 hit;			// found by STAGE_EXTEND: xyz normal, w distance, negative on a miss
+	uvec4 info;			// x: random state, y: material id of the hit, z: sort key
+};
+
+layout (std430, binding = 11) buffer path_data {
+	PathState paths[];
+};
+
+// The paths to extend and shade, and the queue the shade stage fills for the next bounce. The
+// group counts follow the count so that the queue is also the glDispatchComputeIndirect() command.
+layout (std430, binding = 12) buffer queue_in {
+	uint inCount;
+	uint inGroups[3];
+	uint inPaths[];
+};
+
+layout (std430, binding = 13) buffer queue_out {
+	uint outCount;
+	uint outGroups[3];
+	uint outPaths[];
+};
+
+// Coherence sort of the queue (see RaySort.h). Per bin: the number of rays after STAGE_SORT_COUNT,
+// its first slot after STAGE_SORT_SCAN, then its next free slot while STAGE_SORT_SCATTER runs.
+const int SORT_CELL_BITS = 4;
+const uint SORT_BINS = 8u << (3 * SORT_CELL_BITS);
+
+layout (std430, binding = 14) buffer sort_data {
+	uint binStart[];
+};
+
+layout (rgba32f, binding = 0) uniform writeonly image2D u_Color;
+layout (rgba32f, binding = 1) uniform writeonly image2D u_Bloom;
+
+const uint GROUP_SIZE = 64u;
+
+uniform int u_Sample;
+uniform int u_Bounce;
+
+uvec2 pathPixel(uint path) {
+	uint width = uint(u_Resolution.x);
+	return uvec2(path % width, path / width);
+}
+
+// Starts the path of the pixel from the camera, every path goes in the queue
+void generate(uint path) {
+	uvec2 pixel = pathPixel(path);
+	uint rng = u_Sample == 0 ? pixelSeed(pixel) : paths[path].info.x;
+
+	vec3 origin, direction;
+	cameraRay(vec2(pixel) + 0.5, rng, origin, direction);
+
+	paths[path].origin = vec4(origin, 0);
+	paths[path].direction = vec4(direction, 0);
+	paths[path].throughput = vec4(1);
+	paths[path].radiance = vec4(0);
+	if (u_Sample == 0) paths[path].color = vec4(0);
+	paths[path].info.x = rng;
+
+	inPaths[path] = path;
+}
+
+// Closest hit of the path's ray, nothing else
+void extend(uint path) {
+	intersection closest;
+	RayBudget budget = bounceBudget(u_Bounce);
+	sceneIntersect(paths[path].origin.xyz, paths[path].direction.xyz, closest, budget);
+	countBudget(u_Sample, u_Bounce, budget);
+
+	paths[path].hit = closest.hit ? vec4(closest.normal, closest.t) : vec4(-1);
+	paths[path].info.y = closest.materialId;
+}
+
+// Shades the hit, then either queues the path for the next bounce or adds its sample to the pixel
+void shade(uint path) {
+	vec3 rayOrigin = paths[path].origin.xyz;
+	vec3 rayDirection = paths[path].direction.xyz;
+	vec3 rayColor = paths[path].throughput.rgb;
+	vec3 incomingLight = paths[path].radiance.rgb;
+	bool sunSampled = paths[path].origin.w != 0;
+	vec4 hit = paths[path].hit;
+
+	bool going = hit.w > 0;
+	if (going) {
+		intersection closest;
+		closest.t = hit.w;
+		closest.pos = rayOrigin + rayDirection * hit.w;
+		closest.normal = hit.xyz;
+		closest.material = sceneMaterial(paths[path].info.y);
+		closest.hit = true;
+
+		uint rng = paths[path].info.x;
+		scatter(closest, u_Bounce, rayOrigin, rayDirection, rayColor, incomingLight, sunSampled, rng);
+		paths[path].info.x = rng;
+
+		going = u_Bounce + 1 < u_Bounces;
+	} else {
+		incomingLight += rayColor * skycolor(rayDirection, !sunSampled);
+	}
+
+	if (going) {
+		paths[path].origin = vec4(rayOrigin, sunSampled ? 1 : 0);
+		paths[path].direction = vec4(rayDirection, 0);
+		paths[path].throughput = vec4(rayColor, 0);
+		paths[path].radiance = vec4(incomingLight, 0);
+
+		uint slot = atomicAdd(outCount, 1u);
+		outPaths[slot] = path;
+		atomicMax(outGroups[0], slot / GROUP_SIZE + 1u);
+	} else {
+		paths[path].color.rgb += incomingLight / float(u_SPP);
+	}
+}
+
+uint spreadCellBits(uint v) {
+	uint spread = 0u;
+	for (int bit = 0; bit < SORT_CELL_BITS; bit++) spread |= ((v >> bit) & 1u) << (3 * bit);
+	return spread;
+}
+
+// raySortKey() of RaySort.cpp
+uint sortKey(vec3 origin, vec3 direction) {
+	ivec3 gridSize = ivec3(mapw, maph, mapd);
+	int largest = max(gridSize.x, max(gridSize.y, gridSize.z));
+	int shift = 0;
+	while (((largest - 1) >> shift) >= (1 << SORT_CELL_BITS)) shift++;
+
+	uvec3 cell = uvec3(clamp(ivec3(floor(origin)), ivec3(0), gridSize - 1) >> shift);
+	uint morton = spreadCellBits(cell.x) | (spreadCellBits(cell.y) << 1) | (spreadCellBits(cell.z) << 2);
+	uint octant = (direction.x < 0 ? 1u : 0u) | (direction.y < 0 ? 2u : 0u) | (direction.z < 0 ? 4u : 0u);
+	return (octant << (3 * SORT_CELL_BITS)) | morton;
+}
+
+void sortCount(uint path) {
+	uint key = sortKey(paths[path].origin.xyz, paths[path].direction.xyz);
+	paths[path].info.z = key;
+	atomicAdd(binStart[key], 1u);
+}
+
+// Exclusive prefix sum of the bin counts by a single group, each invocation over a run of bins
+shared uint runTotals[GROUP_SIZE];
+
+void sortScan(uint invocation) {
+	const uint binsPerInvocation = SORT_BINS / GROUP_SIZE;
+	uint first = invocation * binsPerInvocation;
+
+	uint total = 0u;
+	for (uint bin = first; bin < first + binsPerInvocation; bin++) total += binStart[bin];
+	runTotals[invocation] = total;
+	barrier();
+
+	uint start = 0u;
+	for (uint run = 0u; run < invocation; run++) start += runTotals[run];
+	for (uint bin = first; bin < first + binsPerInvocation; bin++) {
+		uint count = binStart[bin];
+		binStart[bin] = start;
+		start += count;
+	}
+}
+
+// Within a bin the order is whatever the atomics give, which only moves paths between invocations
+void sortScatter(uint path) {
+	uint slot = atomicAdd(binStart[paths[path].info.z], 1u);
+	outPaths[slot] = path;
+}
+
+// Same as the end of main() in fragment.glsl, into the images instead of the outputs
+void accumulate(uint path) {
+	ivec2 pixel = ivec2(pathPixel(path));
+	uint rng = paths[path].info.x;
+
+	vec4 color = vec4(paths[path].color.rgb, 1);
+	vec4 bloom = vec4(gatherBloom((vec2(pixel) + 0.5) / u_Resolution.xy, rng), 1);
+
+	if (u_FrameSinceLastReset > 0) {
+		color = (color + texelFetch(u_LastColors, pixel, 0) * u_FrameSinceLastReset) / (u_FrameSinceLastReset + 1);
+		bloom.rgb = (bloom.rgb + texelFetch(u_LastBloom, pixel, 0).rgb * u_FrameSinceLastReset) / (u_FrameSinceLastReset + 1);
+	}
+
+	imageStore(u_Color, pixel, color);
+	imageStore(u_Bloom, pixel, bloom);
+}
+
+void main() {
+	uint index = gl_GlobalInvocationID.x;
+	uint pathCount = uint(u_Resolution.x * u_Resolution.y);
+
+#if defined(STAGE_GENERATE)
+	if (index < pathCount) generate(index);
+#elif defined(STAGE_EXTEND)
+	if (index < inCount) extend(inPaths[index]);
+#elif defined(STAGE_SHADE)
+	if (index < inCount) shade(inPaths[index]);
+#elif defined(STAGE_ACCUMULATE)
+	if (index < pathCount) accumulate(index);
+#elif defined(STAGE_SORT_COUNT)
+	if (index < inCount) sortCount(inPaths[index]);
+#elif defined(STAGE_SORT_SCAN)
+	sortScan(gl_LocalInvocationID.x);
+#elif defined(STAGE_SORT_SCATTER)
+	if (index < inCount) sortScatter(inPaths[index]);
+#else
+#error wavefront_comp.glsl is compiled once per stage, with the STAGE_ define of the stage
+#endif
+}